@@ -1,6 +1,18 @@
 #include <benchmark/benchmark.h>
 #include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
 #include "../src/emb_rb.h"
+#include "../src/emb_rb_pool.h"
+#include "../src/emb_rb_seg.h"
+#include "../src/emb_rb_bcast.h"
+#include "../src/emb_rb_desc.h"
+#include "../src/emb_rb_uring.h"
+#include "../src/emb_rb_set.h"
+#include "../src/emb_rb_log.h"
+#include <fcntl.h>
+#include <unistd.h>
 
 // Pattern to be copied
 uint8_t pattern[] = {
@@ -172,6 +184,743 @@ static void BM_single_queue(benchmark::State& state)
 
 BENCHMARK(BM_single_queue)->Range(8, 512);
 
+// Benchmark connection churn, malloc a buffer and init a ring per connection
+static void BM_churn_malloc(benchmark::State& state)
+{
+   uint32_t len = state.range(0);
+   uint32_t n   = 0;
+
+   for (auto _ : state)
+   {
+      emb_rb_t *conn = (emb_rb_t *)malloc(sizeof(emb_rb_t));
+      uint8_t * bP   = (uint8_t *)malloc(len);
+      emb_rb_init(conn, bP, len);
+      n += emb_rb_queue_single(conn, pattern[0], NULL);
+      emb_rb_destroy(conn);
+      free(bP);
+      free(conn);
+   }
+   benchmark::DoNotOptimize(n);
+   state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_churn_malloc)->Range(64, 4096);
+
+// Benchmark connection churn, acquire and release rings from a pool
+static void BM_churn_pool(benchmark::State& state)
+{
+   uint32_t            len = state.range(0);
+   uint32_t            n   = 0;
+   emb_rb_pool_t       pool;
+   emb_rb_pool_class_t classes[1] = { { len, 1024 } };
+
+   emb_rb_pool_init(&pool, classes, 1);
+
+   for (auto _ : state)
+   {
+      emb_rb_t *conn = emb_rb_pool_acquire(&pool, len, NULL);
+      n += emb_rb_queue_single(conn, pattern[0], NULL);
+      emb_rb_pool_release(&pool, conn);
+   }
+   benchmark::DoNotOptimize(n);
+   state.SetItemsProcessed(state.iterations());
+   emb_rb_pool_destroy(&pool);
+}
+
+BENCHMARK(BM_churn_pool)->Range(64, 4096);
+
+// Benchmark a burst into an elastic ring that starts small, then drain it
+static void BM_burst_elastic(benchmark::State& state)
+{
+   uint32_t len = state.range(0);
+   uint32_t n   = 0;
+
+   for (auto _ : state)
+   {
+      emb_rb_t         erb;
+      emb_rb_elastic_t el;
+      emb_rb_elastic_init(&erb, &el, 64, NULL);
+      for (uint32_t i = 0; i < len; i += sizeof(dummy))
+      {
+         n += emb_rb_queue(&erb, dummy, sizeof(dummy), NULL);
+      }
+      emb_rb_destroy(&erb);
+   }
+   benchmark::DoNotOptimize(n);
+   state.SetBytesProcessed((int64_t)len * state.iterations());
+}
+
+BENCHMARK(BM_burst_elastic)->Range(1 << 14, 1 << 20);
+
+// Benchmark the same burst into a segmented queue, no existing data is copied
+static void BM_burst_seg(benchmark::State& state)
+{
+   uint32_t     len = state.range(0);
+   uint32_t     n   = 0;
+   emb_rb_seg_t seg;
+
+   emb_rb_seg_init(&seg, 4096, 1024);
+
+   for (auto _ : state)
+   {
+      for (uint32_t i = 0; i < len; i += sizeof(dummy))
+      {
+         n += emb_rb_seg_queue(&seg, dummy, sizeof(dummy), NULL);
+      }
+      emb_rb_seg_flush(&seg);
+   }
+   benchmark::DoNotOptimize(n);
+   state.SetBytesProcessed((int64_t)len * state.iterations());
+   emb_rb_seg_destroy(&seg);
+}
+
+BENCHMARK(BM_burst_seg)->Range(1 << 14, 1 << 20);
+
+// Benchmark fanning a stream out to N consumers by copying it into one ring per consumer
+static void BM_fanout_copy(benchmark::State& state)
+{
+   uint32_t consumers = state.range(0);
+   uint32_t n         = 0;
+   emb_rb_t rings[EMB_RB_BCAST_MAX_CONSUMERS];
+   uint8_t  bufs[EMB_RB_BCAST_MAX_CONSUMERS][1024];
+
+   for (uint32_t c = 0; c < consumers; c++)
+   {
+      emb_rb_init(&rings[c], bufs[c], sizeof(bufs[c]));
+   }
+   for (auto _ : state)
+   {
+      for (uint32_t c = 0; c < consumers; c++)
+      {
+         n += emb_rb_queue(&rings[c], dummy, 256, NULL);
+      }
+      for (uint32_t c = 0; c < consumers; c++)
+      {
+         n += emb_rb_dequeue(&rings[c], buffer, 256, NULL);
+      }
+   }
+   for (uint32_t c = 0; c < consumers; c++)
+   {
+      emb_rb_destroy(&rings[c]);
+   }
+   benchmark::DoNotOptimize(n);
+   state.SetBytesProcessed(256 * state.iterations());
+}
+
+BENCHMARK(BM_fanout_copy)->DenseRange(2, 6, 2);
+
+// Benchmark the same fan out through a broadcast ring, one copy in and one cursor per consumer
+static void BM_fanout_bcast(benchmark::State& state)
+{
+   uint32_t       consumers = state.range(0);
+   uint32_t       n         = 0;
+   int            ids[EMB_RB_BCAST_MAX_CONSUMERS];
+   uint8_t        buf[1024];
+   emb_rb_bcast_t bc;
+
+   emb_rb_bcast_init(&bc, buf, sizeof(buf), 0);
+   for (uint32_t c = 0; c < consumers; c++)
+   {
+      ids[c] = emb_rb_bcast_add_consumer(&bc);
+   }
+   for (auto _ : state)
+   {
+      n += emb_rb_bcast_queue(&bc, dummy, 256, NULL);
+      for (uint32_t c = 0; c < consumers; c++)
+      {
+         n += emb_rb_bcast_dequeue(&bc, ids[c], buffer, 256, NULL);
+      }
+   }
+   emb_rb_bcast_destroy(&bc);
+   benchmark::DoNotOptimize(n);
+   state.SetBytesProcessed(256 * state.iterations());
+}
+
+BENCHMARK(BM_fanout_bcast)->DenseRange(2, 6, 2);
+
+// Benchmark a producer / consumer pair, optionally with a monitor thread polling the occupancy
+static void BM_monitored_queue(benchmark::State& state)
+{
+   uint32_t          monitors = state.range(0);
+   uint32_t          n        = 0;
+   uint32_t          fails    = 0;
+   std::atomic<bool> done(false);
+   std::thread       threads[4];
+
+   empty();
+   for (uint32_t m = 0; m < monitors; m++)
+   {
+      threads[m] = std::thread([&done]() {
+                  uint64_t seen = 0;
+                  while (!done.load(std::memory_order_relaxed))
+                  {
+                     seen += emb_rb_used_space(&rb) + emb_rb_free_space(&rb) + emb_rb_size(&rb, NULL);
+                  }
+                  benchmark::DoNotOptimize(seen);
+         });
+   }
+   for (auto _ : state)
+   {
+      int err;
+      if (!emb_rb_queue(&rb, pattern, 16, &err) && err == EMB_RB_ERR_LOCK)
+      {
+         fails++;
+      }
+      n += emb_rb_dequeue(&rb, buffer, 16, NULL);
+   }
+   done = true;
+   for (uint32_t m = 0; m < monitors; m++)
+   {
+      threads[m].join();
+   }
+   benchmark::DoNotOptimize(n);
+   state.counters["lock_fails"] = fails;
+   state.SetBytesProcessed(16 * state.iterations());
+}
+
+BENCHMARK(BM_monitored_queue)->DenseRange(0, 4, 2)->UseRealTime();
+
+// Empty lock callbacks, stand in for an interrupt disable / enable pair
+static void bm_cb_lock(void *ctx)
+{
+   (void)ctx;
+   benchmark::ClobberMemory();
+}
+
+static void bm_cb_unlock(void *ctx)
+{
+   (void)ctx;
+   benchmark::ClobberMemory();
+}
+
+// Benchmark queue and dequeue across the lock policies, range(0) is the policy and range(1) the number of contending threads
+static void BM_lock_policy(benchmark::State& state)
+{
+   emb_rb_lock_cfg_t cfg     = { (emb_rb_lock_policy_t)state.range(0), 1, bm_cb_lock, NULL, bm_cb_unlock, NULL, 0, 0 };
+   uint32_t          threads = state.range(1);
+   uint32_t          n       = 0;
+   uint8_t           buf[1024];
+   emb_rb_t          prb;
+   std::atomic<bool> done(false);
+   std::thread       others[2];
+
+   emb_rb_init_ex(&prb, buf, sizeof(buf), &cfg);
+   for (uint32_t t = 0; t < threads; t++)
+   {
+      others[t] = std::thread([&prb, &done]() {
+                  uint8_t rd[16];
+                  while (!done.load(std::memory_order_relaxed))
+                  {
+                     emb_rb_queue(&prb, pattern, 16, NULL);
+                     emb_rb_dequeue(&prb, rd, 16, NULL);
+                  }
+         });
+   }
+   for (auto _ : state)
+   {
+      n += emb_rb_queue(&prb, pattern, 16, NULL);
+      n += emb_rb_dequeue(&prb, buffer, 16, NULL);
+   }
+   done = true;
+   for (uint32_t t = 0; t < threads; t++)
+   {
+      others[t].join();
+   }
+   emb_rb_destroy(&prb);
+   benchmark::DoNotOptimize(n);
+   state.SetBytesProcessed(16 * state.iterations());
+}
+
+BENCHMARK(BM_lock_policy)->ArgsProduct({ { EMB_RB_LOCK_MUTEX, EMB_RB_LOCK_NONE, EMB_RB_LOCK_SPIN,
+                                           EMB_RB_LOCK_ADAPTIVE, EMB_RB_LOCK_CALLBACK }, { 0 } });
+BENCHMARK(BM_lock_policy)->ArgsProduct({ { EMB_RB_LOCK_MUTEX, EMB_RB_LOCK_SPIN, EMB_RB_LOCK_ADAPTIVE }, { 1, 2 } })->UseRealTime();
+
+// Benchmark byte at a time production through a write combining producer handle
+static void BM_producer_put(benchmark::State& state)
+{
+   uint32_t          len = state.range(0);
+   uint32_t          n   = 0;
+   emb_rb_producer_t p;
+
+   empty();
+   emb_rb_producer_init(&p, &rb, len);
+
+   for (auto _ : state)
+   {
+      n += emb_rb_producer_put(&p, pattern[n % sizeof(pattern)]);
+      if (emb_rb_used_space(&rb) > sizeof(buffer) / 2)
+      {
+         empty();
+      }
+   }
+   benchmark::DoNotOptimize(n);
+   state.SetBytesProcessed(state.iterations());
+}
+
+BENCHMARK(BM_producer_put)->Range(8, EMB_RB_PRODUCER_BUF);
+
+// Benchmark decoding a big endian uint32 at the tail by peeking into a temp array
+static void BM_decode_peek(benchmark::State& state)
+{
+   uint8_t  tmp[4];
+   uint32_t v = 0;
+
+   empty();
+   emb_rb_queue(&rb, pattern, 8, NULL);
+
+   for (auto _ : state)
+   {
+      emb_rb_peek(&rb, 1, tmp, 4);
+      v += ((uint32_t)tmp[0] << 24) | ((uint32_t)tmp[1] << 16) | ((uint32_t)tmp[2] << 8) | tmp[3];
+   }
+   benchmark::DoNotOptimize(v);
+}
+
+BENCHMARK(BM_decode_peek);
+
+// Benchmark decoding the same value with the typed accessor
+static void BM_decode_typed(benchmark::State& state)
+{
+   uint32_t x = 0;
+   uint32_t v = 0;
+
+   empty();
+   emb_rb_queue(&rb, pattern, 8, NULL);
+
+   for (auto _ : state)
+   {
+      emb_rb_get_u32be(&rb, 1, &x);
+      v += x;
+   }
+   benchmark::DoNotOptimize(v);
+}
+
+BENCHMARK(BM_decode_typed);
+
+// Benchmark moving a chunk between two rings through a stack buffer
+static void BM_stage_copy(benchmark::State& state)
+{
+   uint32_t len = state.range(0);
+   uint8_t  tmp[512];
+   uint8_t  next_buf[1024];
+   emb_rb_t next;
+
+   empty();
+   emb_rb_init(&next, next_buf, sizeof(next_buf));
+
+   for (auto _ : state)
+   {
+      emb_rb_queue(&rb, dummy, len, NULL);
+      uint32_t n = emb_rb_dequeue(&rb, tmp, len, NULL);
+      emb_rb_queue(&next, tmp, n, NULL);
+      emb_rb_flush(&next);
+   }
+   state.SetBytesProcessed(state.iterations() * len);
+   emb_rb_destroy(&next);
+}
+
+BENCHMARK(BM_stage_copy)->Range(8, 512);
+
+// Benchmark moving the same chunk with emb_rb_transfer
+static void BM_stage_transfer(benchmark::State& state)
+{
+   uint32_t len = state.range(0);
+   uint8_t  next_buf[1024];
+   emb_rb_t next;
+
+   empty();
+   emb_rb_init(&next, next_buf, sizeof(next_buf));
+
+   for (auto _ : state)
+   {
+      emb_rb_queue(&rb, dummy, len, NULL);
+      emb_rb_transfer(&next, &rb, len, NULL);
+      emb_rb_flush(&next);
+   }
+   state.SetBytesProcessed(state.iterations() * len);
+   emb_rb_destroy(&next);
+}
+
+BENCHMARK(BM_stage_transfer)->Range(8, 512);
+
+// Benchmark handing a large payload to a consumer by copying it through ring storage
+static void BM_payload_copy(benchmark::State& state)
+{
+   uint64_t len  = state.range(0);
+   uint8_t *src  = (uint8_t *)malloc(len);
+   uint8_t *dst  = (uint8_t *)malloc(len);
+   uint8_t *stor = (uint8_t *)malloc(2 * len);
+   emb_rb_t big;
+
+   memset(src, 0xa5, len);
+   emb_rb_init64(&big, stor, 2 * len);
+
+   for (auto _ : state)
+   {
+      emb_rb_queue64(&big, src, len, NULL);
+      emb_rb_dequeue64(&big, dst, len, NULL);
+      benchmark::DoNotOptimize(dst[len - 1]);
+   }
+   state.SetBytesProcessed(state.iterations() * len);
+   emb_rb_destroy(&big);
+   free(stor);
+   free(dst);
+   free(src);
+}
+
+BENCHMARK(BM_payload_copy)->RangeMultiplier(4)->Range(4 << 10, 1 << 20);
+
+// Benchmark handing the same payload over by descriptor
+static void BM_payload_desc(benchmark::State& state)
+{
+   uint64_t           len = state.range(0);
+   uint8_t *          src = (uint8_t *)malloc(len);
+   uint64_t           released = 0;
+   emb_rb_desc_t      slots[16];
+   emb_rb_desc_t      out[16];
+   emb_rb_desc_ring_t dr;
+
+   memset(src, 0xa5, len);
+   emb_rb_desc_init(&dr, slots, 16);
+   auto release = [](void *ctx, const uint8_t *, uint64_t n) { *(uint64_t *)ctx += n; };
+
+   for (auto _ : state)
+   {
+      emb_rb_desc_push(&dr, src, len, release, &released);
+      uint32_t n = emb_rb_desc_pop_n(&dr, out, 16, NULL);
+      benchmark::DoNotOptimize(out[0].ptr[len - 1]);
+      emb_rb_desc_release(out, n);
+   }
+   state.SetBytesProcessed(state.iterations() * len);
+   emb_rb_desc_destroy(&dr);
+   free(src);
+}
+
+BENCHMARK(BM_payload_desc)->RangeMultiplier(4)->Range(4 << 10, 1 << 20);
+
+// Benchmark pointer handoff through the byte API
+static void BM_ptr_bytes(benchmark::State& state)
+{
+   void *p = &rb;
+   void *q = NULL;
+
+   empty();
+
+   for (auto _ : state)
+   {
+      emb_rb_queue(&rb, (const uint8_t *)&p, sizeof(p), NULL);
+      emb_rb_dequeue(&rb, (uint8_t *)&q, sizeof(q), NULL);
+      benchmark::DoNotOptimize(q);
+   }
+}
+
+BENCHMARK(BM_ptr_bytes);
+
+// Benchmark the same handoff through element mode
+static void BM_ptr_elem(benchmark::State& state)
+{
+   void *   p = &rb;
+   void *   q = NULL;
+   void *   slots[128];
+   emb_rb_t er;
+
+   emb_rb_init_elem(&er, (uint8_t *)slots, sizeof(void *), 128);
+
+   for (auto _ : state)
+   {
+      emb_rb_push_n(&er, &p, 1, NULL);
+      emb_rb_pop_n(&er, &q, 1, NULL);
+      benchmark::DoNotOptimize(q);
+   }
+   emb_rb_destroy(&er);
+}
+
+BENCHMARK(BM_ptr_elem);
+
+// Benchmark draining a 64 KiB ring to /dev/null with one writev per batch
+static void BM_capture_writev(benchmark::State& state)
+{
+   static uint8_t storage[1 << 16];
+   uint64_t       batch = state.range(0);
+   emb_rb_t       crb;
+   int            fd = open("/dev/null", O_WRONLY);
+
+   emb_rb_init(&crb, storage, sizeof(storage));
+   for (auto _ : state)
+   {
+      emb_rb_publish(&crb, emb_rb_free_space(&crb));
+      while (emb_rb_used_space(&crb))
+      {
+         emb_rb_write_fd(&crb, fd, batch, NULL);
+      }
+   }
+   state.SetBytesProcessed(state.iterations() * sizeof(storage));
+   emb_rb_destroy(&crb);
+   close(fd);
+}
+
+BENCHMARK(BM_capture_writev)->RangeMultiplier(4)->Range(1 << 10, 1 << 14);
+
+// Benchmark the same drain through the io_uring backend with several writes in flight
+static void BM_capture_uring(benchmark::State& state)
+{
+   static uint8_t storage[1 << 16];
+   emb_rb_t       crb;
+   emb_rb_uring_t u;
+   int            fd = open("/dev/null", O_WRONLY);
+
+   emb_rb_init(&crb, storage, sizeof(storage));
+   emb_rb_uring_init(&u, &crb, 16, (uint32_t)state.range(0), 0);
+   emb_rb_uring_set_drain(&u, fd, 0);
+   for (auto _ : state)
+   {
+      emb_rb_publish(&crb, emb_rb_free_space(&crb));
+      while (emb_rb_used_space(&crb))
+      {
+         emb_rb_uring_submit(&u);
+         emb_rb_uring_reap(&u, 1);
+      }
+   }
+   state.SetBytesProcessed(state.iterations() * sizeof(storage));
+   emb_rb_uring_destroy(&u);
+   emb_rb_destroy(&crb);
+   close(fd);
+}
+
+BENCHMARK(BM_capture_uring)->RangeMultiplier(4)->Range(1 << 10, 1 << 14);
+
+// Benchmark a diagnostics dump of a full 64 KiB ring through the locked peek
+static void BM_dump_peek(benchmark::State& state)
+{
+   static uint8_t storage[1 << 16];
+   static uint8_t out[1 << 16];
+   emb_rb_t       drb;
+
+   emb_rb_init(&drb, storage, sizeof(storage));
+   emb_rb_publish(&drb, sizeof(storage));
+   for (auto _ : state)
+   {
+      benchmark::DoNotOptimize(emb_rb_peek64(&drb, 0, out, sizeof(out)));
+   }
+   state.SetBytesProcessed(state.iterations() * sizeof(storage));
+   emb_rb_destroy(&drb);
+}
+
+BENCHMARK(BM_dump_peek);
+
+// Benchmark the same dump through the lock free snapshot
+static void BM_dump_snapshot(benchmark::State& state)
+{
+   static uint8_t storage[1 << 16];
+   static uint8_t out[1 << 16];
+   emb_rb_t       drb;
+
+   emb_rb_init(&drb, storage, sizeof(storage));
+   emb_rb_publish(&drb, sizeof(storage));
+   for (auto _ : state)
+   {
+      benchmark::DoNotOptimize(emb_rb_snapshot(&drb, out, sizeof(out), NULL, NULL));
+   }
+   state.SetBytesProcessed(state.iterations() * sizeof(storage));
+   emb_rb_destroy(&drb);
+}
+
+BENCHMARK(BM_dump_snapshot);
+
+// Benchmark monitoring threads peeking at the head of a ring that a producer keeps busy, arg 0 is
+// the locked peek and arg 1 the optimistic one
+static void BM_monitor_peek(benchmark::State& state)
+{
+   static uint8_t           storage[4096];
+   static emb_rb_t          mrb;
+   static std::atomic<bool> stop;
+   static std::thread       producer;
+   uint8_t                  out[64];
+
+   if (state.thread_index() == 0)
+   {
+      emb_rb_lock_cfg_t cfg = { EMB_RB_LOCK_MUTEX, 0, NULL, NULL, NULL, NULL, (uint8_t)state.range(0), 0 };
+      emb_rb_init_ex(&mrb, storage, sizeof(storage), &cfg);
+      stop     = false;
+      producer = std::thread([]() {
+         while (!stop)
+         {
+            emb_rb_queue(&mrb, buffer, 256, NULL);
+            emb_rb_flush_partial(&mrb, 256);
+         }
+      });
+      emb_rb_queue(&mrb, buffer, 1024, NULL);
+   }
+   for (auto _ : state)
+   {
+      benchmark::DoNotOptimize(emb_rb_peek(&mrb, 0, out, sizeof(out)));
+   }
+   if (state.thread_index() == 0)
+   {
+      stop = true;
+      producer.join();
+      emb_rb_destroy(&mrb);
+   }
+}
+
+BENCHMARK(BM_monitor_peek)->Arg(0)->Arg(1)->ThreadRange(1, 4)->UseRealTime();
+
+// Benchmark producers and consumers contending on one mutex ring, half the threads queue and half
+// dequeue messages of the given size. The second argument sets unlocked_copy, so copies of
+// EMB_RB_UNLOCKED_COPY_MIN bytes and up run outside the lock, 0 is the fully locked baseline.
+static void BM_contended_copy(benchmark::State& state)
+{
+   static uint8_t  storage[1 << 16];
+   static emb_rb_t crb;
+   uint64_t        len = state.range(0);
+   uint8_t *       msg = (uint8_t *)malloc(len);
+   uint64_t        moved = 0;
+
+   memset(msg, 0x5a, len);
+   if (state.thread_index() == 0)
+   {
+      emb_rb_lock_cfg_t cfg = { EMB_RB_LOCK_MUTEX, 0, NULL, NULL, NULL, NULL, 0, (uint8_t)state.range(1) };
+      emb_rb_init_ex(&crb, storage, sizeof(storage), &cfg);
+   }
+   for (auto _ : state)
+   {
+      if (state.thread_index() & 1)
+      {
+         moved += emb_rb_dequeue(&crb, msg, (uint32_t)len, NULL);
+      }
+      else
+      {
+         moved += emb_rb_queue(&crb, msg, (uint32_t)len, NULL);
+      }
+   }
+   state.SetBytesProcessed(moved);
+   free(msg);
+   if (state.thread_index() == 0)
+   {
+      emb_rb_destroy(&crb);
+   }
+}
+
+BENCHMARK(BM_contended_copy)->Args({64, 0})->Args({64, 1})->Args({4096, 0})->Args({4096, 1})->ThreadRange(2, 4)->UseRealTime();
+
+// Rings shared by the gateway benchmarks, 4 out of 512 get traffic per pass
+#define GW_RINGS    512
+static emb_rb_t gw_rings[GW_RINGS];
+static uint8_t  gw_bufs[GW_RINGS][64];
+
+// Benchmark a consumer pass that checks every ring with emb_rb_used_space
+static void BM_gateway_scan(benchmark::State& state)
+{
+   uint8_t out[64];
+
+   for (int i = 0; i < GW_RINGS; i++)
+   {
+      emb_rb_init(&gw_rings[i], gw_bufs[i], sizeof(gw_bufs[i]));
+   }
+   for (auto _ : state)
+   {
+      for (int i = 0; i < 4; i++)
+      {
+         emb_rb_queue(&gw_rings[i * 101], pattern, 8, NULL);
+      }
+      for (int i = 0; i < GW_RINGS; i++)
+      {
+         if (emb_rb_used_space(&gw_rings[i]))
+         {
+            emb_rb_dequeue(&gw_rings[i], out, sizeof(out), NULL);
+         }
+      }
+   }
+   for (int i = 0; i < GW_RINGS; i++)
+   {
+      emb_rb_destroy(&gw_rings[i]);
+   }
+}
+
+BENCHMARK(BM_gateway_scan);
+
+// Benchmark the same pass through a ready set
+static void BM_gateway_set(benchmark::State& state)
+{
+   static emb_rb_set_slot_t slots[GW_RINGS];
+   emb_rb_set_t             set;
+   emb_rb_t *               ready[16];
+   uint8_t                  out[64];
+
+   emb_rb_set_init(&set, slots, GW_RINGS);
+   for (int i = 0; i < GW_RINGS; i++)
+   {
+      emb_rb_init(&gw_rings[i], gw_bufs[i], sizeof(gw_bufs[i]));
+      emb_rb_set_add(&set, &gw_rings[i]);
+   }
+   for (auto _ : state)
+   {
+      for (int i = 0; i < 4; i++)
+      {
+         emb_rb_queue(&gw_rings[i * 101], pattern, 8, NULL);
+      }
+      uint32_t n = emb_rb_set_wait(&set, ready, 16, 0);
+      for (uint32_t i = 0; i < n; i++)
+      {
+         emb_rb_dequeue(ready[i], out, sizeof(out), NULL);
+      }
+   }
+   emb_rb_set_destroy(&set);
+   for (int i = 0; i < GW_RINGS; i++)
+   {
+      emb_rb_destroy(&gw_rings[i]);
+   }
+}
+
+BENCHMARK(BM_gateway_set);
+
+// Logging a typical line, formatted at the call site and queued as text
+static uint8_t log_buf[65536];
+
+static void BM_log_snprintf(benchmark::State& state)
+{
+   emb_rb_t log_rb;
+   char     line[EMB_RB_LOG_RECORD_MAX];
+   int      i = 0;
+
+   emb_rb_init(&log_rb, log_buf, sizeof(log_buf));
+   for (auto _ : state)
+   {
+      int n = snprintf(line, sizeof(line), "rx %s seq %d len %u rtt %.3f ms", "eth0", i++, 1500u, 0.125);
+      if (!emb_rb_queue(&log_rb, (uint8_t *)line, (uint32_t)n, NULL))
+      {
+         emb_rb_flush(&log_rb);
+      }
+   }
+   emb_rb_destroy(&log_rb);
+}
+
+BENCHMARK(BM_log_snprintf);
+
+// Same line through the deferred formatting logger, only the format id and arguments are queued
+static void BM_log_deferred(benchmark::State& state)
+{
+   emb_rb_t         log_rb;
+   emb_rb_log_fmt_t fmts[1];
+   emb_rb_log_t     log;
+   uint16_t         id;
+   int              i = 0;
+
+   emb_rb_init(&log_rb, log_buf, sizeof(log_buf));
+   emb_rb_log_init(&log, &log_rb, fmts, 1);
+   emb_rb_log_register(&log, "rx %s seq %d len %u rtt %.3f ms", &id);
+   for (auto _ : state)
+   {
+      if (emb_rb_log_write(&log, id, "eth0", i++, 1500u, 0.125) != EMB_RB_ERR_OK)
+      {
+         emb_rb_flush(&log_rb);
+      }
+   }
+   emb_rb_destroy(&log_rb);
+}
+
+BENCHMARK(BM_log_deferred);
+
 // Main function to initialize the ring buffer and run benchmarks
 int main(int argc, char **argv)
 {
@@ -19,57 +19,1620 @@
 //LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 //OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 //SOFTWARE.
+// The out of line definitions are what the inline fast paths fall back to, never remap them here
+#undef EMB_RB_INLINE
 #include "emb_rb.h"
+#include "emb_rb_copy.h"
 #include "rb_version.h"
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 // Internal helper methods, that are mutex safe
 
-// Get the number of used bytes in the ring buffer
-static uint32_t _internal_emb_rb_used_space(emb_rb_t *rb)
+// Get the number of used bytes in the ring buffer, head and tail are free running so unsigned
+// subtraction stays correct when head wraps around the 64 bit limit
+static inline uint64_t _internal_emb_rb_used_space(emb_rb_t *rb)
+{
+   return(rb->head - rb->tail);
+}
+
+// Get the number of free bytes in the ring buffer
+static inline uint64_t _internal_emb_rb_free_space(emb_rb_t *rb)
+{
+   return(rb->size - _internal_emb_rb_used_space(rb));
+}
+
+// head, tail and size are read without the lock by the occupancy getters, so every write to them
+// under the lock is published atomically
+static inline uint64_t _internal_emb_rb_load(const uint64_t *p)
+{
+   return(__atomic_load_n(p, __ATOMIC_ACQUIRE));
+}
+
+static inline void _internal_emb_rb_store(uint64_t *p, uint64_t v)
+{
+   __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+// Take the lock for the data path, only a try unless the ring was set up as blocking
+static inline int _internal_emb_rb_trylock_data(emb_rb_t *rb)
+{
+   if (rb->lock.blocking)
+   {
+      emb_rb_lock_acquire(&rb->lock);
+      return(1);
+   }
+   return(emb_rb_lock_try(&rb->lock));
+}
+
+// Take the lock once no queue / dequeue copy is running outside it. Only emb_rb_queue and
+// emb_rb_dequeue know about the reserved bytes past head and tail, everything else that moves them
+// waits those copies out. Rings that did not opt into unlocked_copy never have any.
+static inline void _internal_emb_rb_lock(emb_rb_t *rb)
+{
+   emb_rb_lock_acquire(&rb->lock);
+   while (rb->lock.unlocked_copy && rb->copying)
+   {
+      emb_rb_lock_release(&rb->lock);
+      sched_yield();
+      emb_rb_lock_acquire(&rb->lock);
+   }
+}
+
+// Same for the try path, a copy in flight counts as contention
+static inline int _internal_emb_rb_trylock(emb_rb_t *rb)
+{
+   if (rb->lock.blocking)
+   {
+      _internal_emb_rb_lock(rb);
+      return(1);
+   }
+   if (!emb_rb_lock_try(&rb->lock))
+   {
+      return(0);
+   }
+   if (rb->lock.unlocked_copy && rb->copying)
+   {
+      emb_rb_lock_release(&rb->lock);
+      return(0);
+   }
+   return(1);
+}
+
+// Get the number of used bytes without the lock. tail is read first so a concurrent dequeue can
+// only make the result smaller, and the result is clamped so it never goes negative or above size.
+static inline uint64_t _internal_emb_rb_used_space_unlocked(emb_rb_t *rb, uint64_t size)
+{
+   uint64_t tail = _internal_emb_rb_load(&rb->tail);
+   uint64_t head = _internal_emb_rb_load(&rb->head);
+   int64_t  used = (int64_t)(head - tail);
+
+   if (used < 0)
+   {
+      return(0);
+   }
+   return((uint64_t)used > size ? size : (uint64_t)used);
+}
+
+// Move the tail and its physical index together. Lock free readers (emb_rb_snapshot) take the pair
+// inside a tail_seq window, an odd count means it is half written.
+static inline void _internal_emb_rb_set_tail(emb_rb_t *rb, uint64_t idx, uint64_t tail)
+{
+   __atomic_store_n(&rb->tail_seq, rb->tail_seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   __atomic_store_n(&rb->tail_idx, idx, __ATOMIC_RELAXED);
+   _internal_emb_rb_store(&rb->tail, tail);
+   __atomic_store_n(&rb->tail_seq, rb->tail_seq + 1, __ATOMIC_RELEASE);
+}
+
+// Bracket an in place rewrite of queued bytes, lock free readers retry if seq moved under them
+static inline void _internal_emb_rb_edit_begin(emb_rb_t *rb)
+{
+   __atomic_store_n(&rb->seq, rb->seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void _internal_emb_rb_edit_end(emb_rb_t *rb)
+{
+   __atomic_store_n(&rb->seq, rb->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Read the sequence counters, the tail and its physical index without the lock. Returns 0 if a
+// writer was half way through, the caller yields and tries again.
+static inline int _internal_emb_rb_tail_pair(emb_rb_t *rb, uint64_t *seq, uint64_t *tail_seq, uint64_t *tail, uint64_t *idx)
+{
+   *seq      = __atomic_load_n(&rb->seq, __ATOMIC_ACQUIRE);
+   *tail_seq = __atomic_load_n(&rb->tail_seq, __ATOMIC_ACQUIRE);
+   *tail     = __atomic_load_n(&rb->tail, __ATOMIC_RELAXED);
+   *idx      = __atomic_load_n(&rb->tail_idx, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   return(!((*seq | *tail_seq) & 1) && __atomic_load_n(&rb->tail_seq, __ATOMIC_RELAXED) == *tail_seq);
+}
+
+// Move a physical index backward by n bytes, n <= size
+static inline uint64_t _internal_emb_rb_retreat(emb_rb_t *rb, uint64_t idx, uint64_t n)
+{
+   return(idx >= n ? idx - n : idx + rb->size - n);
+}
+
+// Move n bytes inside the ring from physical index src to dst, either region may wrap. When the
+// destination is ahead of the source we copy back to front so overlapping bytes are not clobbered.
+static void _internal_emb_rb_move(emb_rb_t *rb, uint64_t dst, uint64_t src, uint64_t n, uint8_t dst_ahead)
+{
+   if (!dst_ahead)
+   {
+      while (n)
+      {
+         uint64_t chunk = n;
+         if (chunk > rb->size - src)
+         {
+            chunk = rb->size - src;
+         }
+         if (chunk > rb->size - dst)
+         {
+            chunk = rb->size - dst;
+         }
+         memmove(rb->bP + dst, rb->bP + src, chunk);
+         src = _internal_emb_rb_advance(rb, src, chunk);
+         dst = _internal_emb_rb_advance(rb, dst, chunk);
+         n  -= chunk;
+      }
+   }
+   else
+   {
+      // Work from the end of both regions
+      src = _internal_emb_rb_advance(rb, src, n);
+      dst = _internal_emb_rb_advance(rb, dst, n);
+      while (n)
+      {
+         uint64_t src_end = src ? src : rb->size;
+         uint64_t dst_end = dst ? dst : rb->size;
+         uint64_t chunk   = n;
+         if (chunk > src_end)
+         {
+            chunk = src_end;
+         }
+         if (chunk > dst_end)
+         {
+            chunk = dst_end;
+         }
+         memmove(rb->bP + dst_end - chunk, rb->bP + src_end - chunk, chunk);
+         src = src_end - chunk;
+         dst = dst_end - chunk;
+         n  -= chunk;
+      }
+   }
+}
+
+// Clamp a 64 bit count to the 32 bit API
+static inline uint32_t _internal_emb_rb_clamp32(uint64_t n)
+{
+   return(n > UINT32_MAX ? UINT32_MAX : (uint32_t)n);
+}
+
+// Host byte order, typed accessors only swap when the wire order differs
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define EMB_RB_HOST_BE    1
+#else
+#define EMB_RB_HOST_BE    0
+#endif
+
+// Decode a width byte integer from p, the memcpy compiles to a single unaligned load
+static inline uint64_t _internal_emb_rb_decode(const uint8_t *p, uint8_t width, uint8_t big)
+{
+   uint8_t swap = big != EMB_RB_HOST_BE;
+
+   if (width == 2)
+   {
+      uint16_t v;
+      memcpy(&v, p, 2);
+      return(swap ? __builtin_bswap16(v) : v);
+   }
+   if (width == 4)
+   {
+      uint32_t v;
+      memcpy(&v, p, 4);
+      return(swap ? __builtin_bswap32(v) : v);
+   }
+   uint64_t v;
+   memcpy(&v, p, 8);
+   return(swap ? __builtin_bswap64(v) : v);
+}
+
+// Encode a width byte integer to p
+static inline void _internal_emb_rb_encode(uint8_t *p, uint64_t v, uint8_t width, uint8_t big)
+{
+   uint8_t swap = big != EMB_RB_HOST_BE;
+
+   if (width == 2)
+   {
+      uint16_t x = swap ? __builtin_bswap16((uint16_t)v) : (uint16_t)v;
+      memcpy(p, &x, 2);
+   }
+   else if (width == 4)
+   {
+      uint32_t x = swap ? __builtin_bswap32((uint32_t)v) : (uint32_t)v;
+      memcpy(p, &x, 4);
+   }
+   else
+   {
+      uint64_t x = swap ? __builtin_bswap64(v) : v;
+      memcpy(p, &x, 8);
+   }
+}
+
+// Monotonic time in nanoseconds, used for the elastic idle period and resize cost
+static uint64_t _internal_emb_rb_now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+// Default elastic allocator hooks
+static void *_internal_emb_rb_malloc(void *ctx, size_t size)
+{
+   (void)ctx;
+   return(malloc(size));
+}
+
+static void _internal_emb_rb_free(void *ctx, void *p)
+{
+   (void)ctx;
+   free(p);
+}
+
+// Move the ring into new storage of new_size bytes, relinearizing the used region to index 0
+static int _internal_emb_rb_resize(emb_rb_t *rb, uint64_t new_size)
+{
+   emb_rb_elastic_t *el    = rb->elastic;
+   uint64_t          start = _internal_emb_rb_now_ns();
+   uint8_t *         bP    = (uint8_t *)el->cfg.alloc(el->cfg.ctx, new_size);
+
+   if (!bP)
+   {
+      return(EMB_RB_ERR_NO_MEM);
+   }
+   // One pass over the used region, at most two copies if it wraps
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   _internal_emb_rb_read(rb, rb->tail_idx, bP, used);
+   el->cfg.free(el->cfg.ctx, rb->bP);
+   rb->bP       = bP;
+   _internal_emb_rb_store(&rb->size, new_size);
+   rb->tail_idx = 0;
+   rb->head_idx = _internal_emb_rb_advance(rb, 0, used);
+
+   el->stats.bytes_moved += used;
+   el->stats.resize_ns   += _internal_emb_rb_now_ns() - start;
+   return(EMB_RB_ERR_OK);
+}
+
+// Grow an elastic ring geometrically until it can hold len more bytes, or it hits the cap
+static void _internal_emb_rb_grow(emb_rb_t *rb, uint64_t len)
+{
+   emb_rb_elastic_t *el       = rb->elastic;
+   uint64_t          need     = _internal_emb_rb_used_space(rb) + len;
+   uint64_t          new_size = rb->size;
+
+   while (new_size < need && new_size < el->cfg.max_size)
+   {
+      new_size *= 2;
+   }
+   if (new_size > el->cfg.max_size)
+   {
+      new_size = el->cfg.max_size;
+   }
+   if (new_size > rb->size && _internal_emb_rb_resize(rb, new_size) == EMB_RB_ERR_OK)
+   {
+      el->stats.grows++;
+   }
+}
+
+// Shrink an elastic ring by half once it has been at or below a quarter full for the idle period
+static void _internal_emb_rb_shrink(emb_rb_t *rb)
+{
+   emb_rb_elastic_t *el = rb->elastic;
+
+   if (!el->cfg.idle_ns || rb->size <= el->min_size)
+   {
+      return;
+   }
+   uint64_t now = _internal_emb_rb_now_ns();
+   if (el->busy || _internal_emb_rb_used_space(rb) > rb->size / 4)
+   {
+      el->busy    = 0;
+      el->busy_ns = now;
+      return;
+   }
+   if (now - el->busy_ns < el->cfg.idle_ns)
+   {
+      return;
+   }
+   uint64_t new_size = rb->size / 2;
+   if (new_size < el->min_size)
+   {
+      new_size = el->min_size;
+   }
+   if (_internal_emb_rb_resize(rb, new_size) == EMB_RB_ERR_OK)
+   {
+      el->stats.shrinks++;
+   }
+   // Another full idle period before the next step down
+   el->busy_ns = now;
+}
+
+// Note that an elastic ring needed more than a quarter of its capacity
+static inline void _internal_emb_rb_mark_busy(emb_rb_t *rb)
+{
+   if (_internal_emb_rb_used_space(rb) > rb->size / 4)
+   {
+      rb->elastic->busy = 1;
+   }
+}
+
+// Watermark crossing and the callback to run for it, captured under the lock so a concurrent detach
+// cannot change the watermark under _internal_emb_rb_fire
+typedef struct
+{
+   int                   crossed;
+   emb_rb_watermark_cb_t cb;
+   void *                ctx;
+} emb_rb_wm_event_t;
+
+// Re-evaluate the watermark after used space changed, call with the lock held. crossed is 1 if the
+// high watermark was just reached, -1 if low was just reached, 0 otherwise.
+static inline emb_rb_wm_event_t _internal_emb_rb_wm_update(emb_rb_t *rb)
+{
+   emb_rb_watermark_t *wm = rb->wm;
+   emb_rb_wm_event_t   ev = { 0, NULL, NULL };
+
+   if (!wm)
+   {
+      return(ev);
+   }
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (!wm->above && used >= wm->high)
+   {
+      __atomic_store_n(&wm->above, 1, __ATOMIC_RELEASE);
+      ev.crossed = 1;
+   }
+   else if (wm->above && used <= wm->low)
+   {
+      __atomic_store_n(&wm->above, 0, __ATOMIC_RELEASE);
+      ev.crossed = -1;
+   }
+   if (ev.crossed)
+   {
+      ev.cb  = wm->cb;
+      ev.ctx = wm->ctx;
+   }
+   return(ev);
+}
+
+// Signal an eventfd, a full counter still leaves it readable so EAGAIN is fine
+static void _internal_emb_rb_signal(int fd)
+{
+   uint64_t one = 1;
+   ssize_t  res;
+
+   do
+   {
+      res = write(fd, &one, sizeof(one));
+   } while (res < 0 && errno == EINTR);
+}
+
+// Signal the event loop fds whose condition holds and that are not signaled yet. The fence orders
+// the head / tail store before the flag loads, pairing with the one in emb_rb_notify_ack.
+static void _internal_emb_rb_notify(emb_rb_t *rb, emb_rb_notify_t *n)
+{
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   uint64_t size = _internal_emb_rb_load(&rb->size);
+   uint64_t used = _internal_emb_rb_used_space_unlocked(rb, size);
+
+   if (n->data_fd >= 0 && used >= n->data_threshold && !__atomic_load_n(&n->data_signaled, __ATOMIC_RELAXED) &&
+       !__atomic_exchange_n(&n->data_signaled, 1, __ATOMIC_ACQ_REL))
+   {
+      _internal_emb_rb_signal(n->data_fd);
+   }
+   if (n->space_fd >= 0 && size - used >= n->space_threshold && !__atomic_load_n(&n->space_signaled, __ATOMIC_RELAXED) &&
+       !__atomic_exchange_n(&n->space_signaled, 1, __ATOMIC_ACQ_REL))
+   {
+      _internal_emb_rb_signal(n->space_fd);
+   }
+}
+
+// Flag the ring in its ready set while it holds data. The plain bit test keeps it to one load per call
+// until the consumer takes the flag, the fence pairs with the exchange in emb_rb_set_wait so data
+// queued right after the consumer cleared the bit always sets it again.
+static void _internal_emb_rb_mark_ready(emb_rb_t *rb, emb_rb_ready_t *r)
+{
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(r->word, __ATOMIC_RELAXED) & r->bit ||
+       !_internal_emb_rb_used_space_unlocked(rb, _internal_emb_rb_load(&rb->size)))
+   {
+      return;
+   }
+   uint64_t old = __atomic_fetch_or(r->word, r->bit, __ATOMIC_ACQ_REL);
+   if (old & r->bit)
+   {
+      return;
+   }
+   if (!old)
+   {
+      __atomic_fetch_or(r->summary, r->summary_bit, __ATOMIC_ACQ_REL);
+   }
+   if (r->wake)
+   {
+      r->wake(r->ctx);
+   }
+}
+
+// Run the occupancy hooks after the unlock, the watermark callback for a crossing found by
+// _internal_emb_rb_wm_update, the event loop notifications and the ready set
+static inline void _internal_emb_rb_fire(emb_rb_t *rb, emb_rb_wm_event_t crossed)
+{
+   if (crossed.crossed && crossed.cb)
+   {
+      crossed.cb(crossed.ctx, crossed.crossed > 0);
+   }
+   emb_rb_notify_t *n = __atomic_load_n(&rb->notify, __ATOMIC_ACQUIRE);
+   if (n)
+   {
+      _internal_emb_rb_notify(rb, n);
+   }
+   emb_rb_ready_t *r = __atomic_load_n(&rb->ready, __ATOMIC_ACQUIRE);
+   if (r)
+   {
+      _internal_emb_rb_mark_ready(rb, r);
+   }
+}
+
+// Wake batch consumers after bytes were published, call after the unlock. Waiters register under the
+// ring lock, so the unlock already orders the head store before their re-check and no wakeup is lost.
+// Rings without a lock have nothing to pair with and fence against the one in emb_rb_wait instead.
+static inline void _internal_emb_rb_wake(emb_rb_t *rb)
+{
+   if (rb->lock.policy == EMB_RB_LOCK_NONE)
+   {
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   }
+   if (__atomic_load_n(&rb->waiters, __ATOMIC_RELAXED))
+   {
+      emb_rb_wake_waiters(rb);
+   }
+}
+
+// Initialize the ring buffer
+int emb_rb_init(emb_rb_t *rb, uint8_t *bP, uint32_t size)
+{
+   return(emb_rb_init64(rb, bP, size));
+}
+
+// Initialize the ring buffer, 64 bit size
+int emb_rb_init64(emb_rb_t *rb, uint8_t *bP, uint64_t size)
+{
+   return(emb_rb_init_ex(rb, bP, size, NULL));
+}
+
+// Initialize the ring buffer with a synchronization policy
+int emb_rb_init_ex(emb_rb_t *rb, uint8_t *bP, uint64_t size, const emb_rb_lock_cfg_t *lock)
+{
+   // Null check
+   if (!rb || !bP || !size || size > EMB_RB_MAX_SIZE)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   rb->bP        = bP;
+   rb->size      = size;
+   rb->head      = 0;
+   rb->tail      = 0;
+   rb->head_idx  = 0;
+   rb->tail_idx  = 0;
+   rb->elastic   = NULL;
+   rb->wm        = NULL;
+   rb->notify    = NULL;
+   rb->ready     = NULL;
+   rb->elem_size = 0;
+   rb->waiters   = 0;
+   rb->seq       = 0;
+   rb->tail_seq  = 0;
+   rb->head_pend = 0;
+   rb->tail_pend = 0;
+   rb->copying   = 0;
+   rb->wait_state = EMB_RB_WAIT_NONE;
+   if (emb_rb_lock_init(&rb->lock, lock) != 0)
+   {
+      return(EMB_RB_ERR_LOCK);
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Initialize the ring buffer in fixed size element mode
+int emb_rb_init_elem(emb_rb_t *rb, uint8_t *bP, uint32_t elem_size, uint64_t count)
+{
+   // Null check
+   if (!rb || !elem_size || !count || count > EMB_RB_MAX_SIZE / elem_size)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   int ret = emb_rb_init64(rb, bP, (uint64_t)elem_size * count);
+   if (ret == EMB_RB_ERR_OK)
+   {
+      rb->elem_size = elem_size;
+   }
+   return(ret);
+}
+
+// Initialize the ring buffer in elastic mode
+int emb_rb_elastic_init(emb_rb_t *rb, emb_rb_elastic_t *el, uint64_t size, const emb_rb_elastic_cfg_t *cfg)
+{
+   // Null check
+   if (!rb || !el || !size || size > EMB_RB_MAX_SIZE || (cfg && cfg->max_size && cfg->max_size < size) ||
+       (cfg && !cfg->alloc != !cfg->free))
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   memset(el, 0, sizeof(*el));
+   if (cfg)
+   {
+      el->cfg = *cfg;
+   }
+   if (!el->cfg.alloc)
+   {
+      el->cfg.alloc = _internal_emb_rb_malloc;
+      el->cfg.free  = _internal_emb_rb_free;
+   }
+   if (!el->cfg.max_size || el->cfg.max_size > EMB_RB_MAX_SIZE)
+   {
+      el->cfg.max_size = EMB_RB_MAX_SIZE;
+   }
+   el->min_size = size;
+   el->busy_ns  = _internal_emb_rb_now_ns();
+
+   uint8_t *bP = (uint8_t *)el->cfg.alloc(el->cfg.ctx, size);
+   if (!bP)
+   {
+      return(EMB_RB_ERR_NO_MEM);
+   }
+   int rtn = emb_rb_init64(rb, bP, size);
+   if (rtn != EMB_RB_ERR_OK)
+   {
+      el->cfg.free(el->cfg.ctx, bP);
+      return(rtn);
+   }
+   rb->elastic = el;
+   return(EMB_RB_ERR_OK);
+}
+
+// Shrink an idle elastic ring
+int emb_rb_elastic_tick(emb_rb_t *rb)
+{
+   // Null check
+   if (!rb || !rb->elastic)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   _internal_emb_rb_lock(rb);
+   _internal_emb_rb_shrink(rb);
+   emb_rb_lock_release(&rb->lock);
+   return(EMB_RB_ERR_OK);
+}
+
+// Get the elastic resize statistics
+int emb_rb_elastic_stats(emb_rb_t *rb, emb_rb_elastic_stats_t *stats)
+{
+   // Null check
+   if (!rb || !rb->elastic || !stats)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   _internal_emb_rb_lock(rb);
+   *stats = rb->elastic->stats;
+   emb_rb_lock_release(&rb->lock);
+   return(EMB_RB_ERR_OK);
+}
+
+// Wake every consumer blocked in emb_rb_dequeue_batch
+void emb_rb_wake_waiters(emb_rb_t *rb)
+{
+   // Null check
+   if (!rb)
+   {
+      return;
+   }
+   // Nobody can be sleeping before the first wait set the primitives up. The fence orders the
+   // caller's stop flag store before this load and pairs with the one in _internal_emb_rb_wait_until,
+   // which sits between publishing the primitives and reading the flag, so a wait being set up
+   // right now either gets the broadcast or sees the flag.
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&rb->wait_state, __ATOMIC_ACQUIRE) != EMB_RB_WAIT_READY)
+   {
+      return;
+   }
+   pthread_mutex_lock(&rb->wait_mtx);
+   pthread_cond_broadcast(&rb->wait_cv);
+   pthread_mutex_unlock(&rb->wait_mtx);
+}
+
+// Attach watermarks to the ring
+int emb_rb_watermark_init(emb_rb_t *rb, emb_rb_watermark_t *wm, uint64_t high, uint64_t low, emb_rb_watermark_cb_t cb, void *ctx)
+{
+   // Null check
+   if (!rb || (wm && (!high || low >= high)))
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   if (wm)
+   {
+      wm->high  = high;
+      wm->low   = low;
+      wm->cb    = cb;
+      wm->ctx   = ctx;
+      wm->above = 0;
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   rb->wm = wm;
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   if (wm)
+   {
+      _internal_emb_rb_fire(rb, crossed);
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Get the watermark flag without taking the lock
+uint8_t emb_rb_watermark_high(emb_rb_t *rb)
+{
+   // Null check
+   if (!rb || !rb->wm)
+   {
+      return(0);
+   }
+   return(__atomic_load_n(&rb->wm->above, __ATOMIC_ACQUIRE));
+}
+
+// Attach event loop notifications to the ring
+int emb_rb_notify_init(emb_rb_t *rb, emb_rb_notify_t *n, uint64_t data_threshold, uint64_t space_threshold)
+{
+   // Null check
+   if (!rb || !n || (!data_threshold && !space_threshold) || rb->notify)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   n->data_fd         = -1;
+   n->space_fd        = -1;
+   n->data_threshold  = data_threshold;
+   n->space_threshold = space_threshold;
+   n->data_signaled   = 0;
+   n->space_signaled  = 0;
+#ifdef __linux__
+   if (data_threshold)
+   {
+      n->data_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   }
+   if (space_threshold)
+   {
+      n->space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   }
+#endif
+   if ((data_threshold && n->data_fd < 0) || (space_threshold && n->space_fd < 0))
+   {
+      if (n->data_fd >= 0)
+      {
+         close(n->data_fd);
+      }
+      if (n->space_fd >= 0)
+      {
+         close(n->space_fd);
+      }
+      return(EMB_RB_ERR_IO);
+   }
+   __atomic_store_n(&rb->notify, n, __ATOMIC_RELEASE);
+   // The ring may already be ready
+   _internal_emb_rb_notify(rb, n);
+   return(EMB_RB_ERR_OK);
+}
+
+// Drain a notification fd and re-arm it
+int emb_rb_notify_ack(emb_rb_t *rb, int fd)
+{
+   // Null check
+   if (!rb || !rb->notify || fd < 0 || (fd != rb->notify->data_fd && fd != rb->notify->space_fd))
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   emb_rb_notify_t *n = rb->notify;
+   uint64_t         v;
+   ssize_t          res;
+   do
+   {
+      res = read(fd, &v, sizeof(v));
+   } while (res < 0 && errno == EINTR);
+   // A producer that saw the flag still set did not signal, so look again once it is cleared
+   __atomic_store_n(fd == n->data_fd ? &n->data_signaled : &n->space_signaled, 0, __ATOMIC_RELEASE);
+   _internal_emb_rb_notify(rb, n);
+   return(EMB_RB_ERR_OK);
+}
+
+// Detach the notifications and close their fds
+void emb_rb_notify_destroy(emb_rb_t *rb)
+{
+   // Null check
+   if (!rb || !rb->notify)
+   {
+      return;
+   }
+   emb_rb_notify_t *n = rb->notify;
+   __atomic_store_n(&rb->notify, NULL, __ATOMIC_RELEASE);
+   if (n->data_fd >= 0)
+   {
+      close(n->data_fd);
+   }
+   if (n->space_fd >= 0)
+   {
+      close(n->space_fd);
+   }
+   n->data_fd  = -1;
+   n->space_fd = -1;
+}
+
+// Attach the ring to a ready set
+int emb_rb_ready_attach(emb_rb_t *rb, emb_rb_ready_t *ready)
+{
+   // Null check
+   if (!rb || (ready && (!ready->word || !ready->summary || !ready->bit || !ready->summary_bit)))
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   __atomic_store_n(&rb->ready, ready, __ATOMIC_RELEASE);
+   if (ready)
+   {
+      _internal_emb_rb_mark_ready(rb, ready);
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Get the total size of the ring buffer
+uint32_t emb_rb_size(emb_rb_t *rb, int *err)
+{
+   return(_internal_emb_rb_clamp32(emb_rb_size64(rb, err)));
+}
+
+// Get the total size of the ring buffer, 64 bit size, without taking the lock
+uint64_t emb_rb_size64(emb_rb_t *rb, int *err)
+{
+   // Null check
+   if (!rb)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   uint64_t size = _internal_emb_rb_load(&rb->size);
+
+   // Set the error code
+   if (err)
+   {
+      *err = EMB_RB_ERR_OK;
+   }
+
+   return(size);
+}
+
+// Queue a large copy outside the lock, called with the lock held. The bytes are reserved past any
+// earlier reservation, copied unlocked and published once every earlier reservation is.
+static uint64_t _internal_emb_rb_queue_unlocked(emb_rb_t *rb, const uint8_t *bytes, uint64_t len, int *err)
+{
+   uint64_t space = _internal_emb_rb_free_space(rb) - rb->head_pend;
+   if (len > space)
+   {
+      len = space;
+   }
+   if (!len)
+   {
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      if (err)
+      {
+         *err = EMB_RB_ERR_BUFFER_FULL;
+      }
+      return(0);
+   }
+   uint64_t start = rb->head + rb->head_pend;
+   uint64_t idx   = _internal_emb_rb_advance(rb, rb->head_idx, rb->head_pend);
+   rb->head_pend += len;
+   rb->copying++;
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+
+   _internal_emb_rb_write(rb, idx, bytes, len);
+
+   // Publish in reservation order, an earlier producer may still be copying
+   emb_rb_lock_acquire(&rb->lock);
+   while (rb->head != start)
+   {
+      emb_rb_lock_release(&rb->lock);
+      sched_yield();
+      emb_rb_lock_acquire(&rb->lock);
+   }
+   rb->head_idx = _internal_emb_rb_advance(rb, rb->head_idx, len);
+   _internal_emb_rb_store(&rb->head, rb->head + len);
+   rb->head_pend -= len;
+   rb->copying--;
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   _internal_emb_rb_wake(rb);
+   if (err)
+   {
+      *err = EMB_RB_ERR_OK;
+   }
+   return(len);
+}
+
+// Dequeue a large copy outside the lock, called with the lock held. Same scheme as the queue side,
+// the bytes stay unavailable to producers until the tail is published past them.
+static uint64_t _internal_emb_rb_dequeue_unlocked(emb_rb_t *rb, uint8_t *bytes, uint64_t len, int *err)
+{
+   uint64_t used = _internal_emb_rb_used_space(rb) - rb->tail_pend;
+   if (len > used)
+   {
+      len = used;
+   }
+   if (!len)
+   {
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      if (err)
+      {
+         *err = EMB_RB_ERR_BUFFER_EMPTY;
+      }
+      return(0);
+   }
+   uint64_t start = rb->tail + rb->tail_pend;
+   uint64_t idx   = _internal_emb_rb_advance(rb, rb->tail_idx, rb->tail_pend);
+   rb->tail_pend += len;
+   rb->copying++;
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+
+   _internal_emb_rb_read(rb, idx, bytes, len);
+
+   // Publish in reservation order, an earlier consumer may still be copying
+   emb_rb_lock_acquire(&rb->lock);
+   while (rb->tail != start)
+   {
+      emb_rb_lock_release(&rb->lock);
+      sched_yield();
+      emb_rb_lock_acquire(&rb->lock);
+   }
+   _internal_emb_rb_set_tail(rb, _internal_emb_rb_advance(rb, rb->tail_idx, len), rb->tail + len);
+   rb->tail_pend -= len;
+   rb->copying--;
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   if (err)
+   {
+      *err = EMB_RB_ERR_OK;
+   }
+   return(len);
+}
+
+// Queue a single byte into the ring buffer, making a deep copy
+uint8_t emb_rb_queue_single(emb_rb_t *rb, uint8_t byte, int *err)
+{
+   // Null check
+   if (!rb)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   // Lock the buffer
+   if (!_internal_emb_rb_trylock(rb))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   uint8_t ret = 0;
+   // Elastic rings grow instead of reporting full
+   if (rb->elastic && !_internal_emb_rb_free_space(rb))
+   {
+      _internal_emb_rb_grow(rb, 1);
+   }
+   // Check if there is enough free space
+   if (_internal_emb_rb_free_space(rb))
+   {
+      // Queue the byte
+      rb->bP[rb->head_idx] = byte;
+      rb->head_idx         = _internal_emb_rb_advance(rb, rb->head_idx, 1);
+      _internal_emb_rb_store(&rb->head, rb->head + 1);
+      ret = 1;
+      if (rb->elastic)
+      {
+         _internal_emb_rb_mark_busy(rb);
+      }
+
+      // Set the error code
+      if (err)
+      {
+         *err = EMB_RB_ERR_OK;
+      }
+   }
+   else if (err)
+   {
+      *err = EMB_RB_ERR_BUFFER_FULL;
+   }
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   if (ret)
+   {
+      _internal_emb_rb_wake(rb);
+   }
+   return(ret);
+}
+
+// Queue len nubmer of bytes into the ring buffer, making a deep copy
+uint32_t emb_rb_queue(emb_rb_t *rb, const uint8_t *bytes, uint32_t len, int *err)
+{
+   return((uint32_t)emb_rb_queue64(rb, bytes, len, err));
+}
+
+// Queue len nubmer of bytes into the ring buffer, 64 bit length
+uint64_t emb_rb_queue64(emb_rb_t *rb, const uint8_t *bytes, uint64_t len, int *err)
+{
+   // Null check
+   if (!rb || !bytes || !len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   // Lock the buffer
+   if (!_internal_emb_rb_trylock_data(rb))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   // Large copies keep the lock only for the reservation and the publish, anything queued while
+   // one is in flight has to go behind it. Elastic rings may move the storage, they always copy locked.
+   if (rb->lock.unlocked_copy && !rb->elastic && (len >= EMB_RB_UNLOCKED_COPY_MIN || rb->head_pend))
+   {
+      return(_internal_emb_rb_queue_unlocked(rb, bytes, len, err));
+   }
+   // Check if there is enough free space, elastic rings grow instead of truncating
+   uint64_t space = _internal_emb_rb_free_space(rb);
+   if (len > space && rb->elastic)
+   {
+      _internal_emb_rb_grow(rb, len);
+      space = _internal_emb_rb_free_space(rb);
+   }
+   if (len > space)
+   {
+      len = space;
+   }
+   // 1. If len is 1, just copy the byte
+   // 2. if len is greater than 1, handle the wrap around
+   // 3. otherwise len is 0 and don't do anything
+   if (len == 1)
+   {
+      rb->bP[rb->head_idx] = *bytes;
+   }
+   else if (len > 1)
+   {
+      _internal_emb_rb_write(rb, rb->head_idx, bytes, len);
+   }
+   rb->head_idx = _internal_emb_rb_advance(rb, rb->head_idx, len);
+   _internal_emb_rb_store(&rb->head, rb->head + len);
+   if (rb->elastic)
+   {
+      _internal_emb_rb_mark_busy(rb);
+   }
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   if (len)
+   {
+      _internal_emb_rb_wake(rb);
+   }
+
+   if (err)
+   {
+      if (len > 0)
+      {
+         *err = EMB_RB_ERR_OK;
+      }
+      else
+      {
+         *err = EMB_RB_ERR_BUFFER_FULL;
+      }
+   }
+   return(len);
+}
+
+// Queue len number of bytes as one record, all or nothing
+uint64_t emb_rb_queue_record(emb_rb_t *rb, const uint8_t *bytes, uint64_t len, int *err)
+{
+   // Null check
+   if (!rb || !bytes || !len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   // Lock the buffer, records are short so they always copy locked
+   if (!_internal_emb_rb_trylock(rb))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   uint64_t space = _internal_emb_rb_free_space(rb);
+   if (len > space && rb->elastic)
+   {
+      _internal_emb_rb_grow(rb, len);
+      space = _internal_emb_rb_free_space(rb);
+   }
+   if (len > space)
+   {
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      if (err)
+      {
+         *err = EMB_RB_ERR_BUFFER_FULL;
+      }
+      return(0);
+   }
+   _internal_emb_rb_write(rb, rb->head_idx, bytes, len);
+   rb->head_idx = _internal_emb_rb_advance(rb, rb->head_idx, len);
+   _internal_emb_rb_store(&rb->head, rb->head + len);
+   if (rb->elastic)
+   {
+      _internal_emb_rb_mark_busy(rb);
+   }
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   _internal_emb_rb_wake(rb);
+   if (err)
+   {
+      *err = EMB_RB_ERR_OK;
+   }
+   return(len);
+}
+
+// Dequeue len number of bytes from the ring buffer
+uint32_t emb_rb_dequeue(emb_rb_t *rb, uint8_t *bytes, uint32_t len, int *err)
+{
+   return((uint32_t)emb_rb_dequeue64(rb, bytes, len, err));
+}
+
+// Dequeue len number of bytes from the ring buffer, 64 bit length
+uint64_t emb_rb_dequeue64(emb_rb_t *rb, uint8_t *bytes, uint64_t len, int *err)
+{
+   // Null check
+   if (!rb || !bytes || !len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   // Lock the buffer
+   if (!_internal_emb_rb_trylock_data(rb))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   if (rb->lock.unlocked_copy && !rb->elastic && (len >= EMB_RB_UNLOCKED_COPY_MIN || rb->tail_pend))
+   {
+      return(_internal_emb_rb_dequeue_unlocked(rb, bytes, len, err));
+   }
+   // Check if there is enough used space
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (len > used)
+   {
+      len = used;
+   }
+   // 1. If len is 1, just copy the byte
+   // 2. if len is greater than 1, handle the wrap around
+   // 3. otherwise len is 0 and don't do anything
+   if (len == 1)
+   {
+      *bytes = rb->bP[rb->tail_idx];
+   }
+   else if (len > 1)
+   {
+      _internal_emb_rb_read(rb, rb->tail_idx, bytes, len);
+   }
+   _internal_emb_rb_set_tail(rb, _internal_emb_rb_advance(rb, rb->tail_idx, len), rb->tail + len);
+   if (rb->elastic)
+   {
+      _internal_emb_rb_shrink(rb);
+   }
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+
+   if (err)
+   {
+      if (len > 0)
+      {
+         *err = EMB_RB_ERR_OK;
+      }
+      else
+      {
+         *err = EMB_RB_ERR_BUFFER_EMPTY;
+      }
+   }
+   return(len);
+}
+
+// Set up the wait primitives on the first wait, rings nobody waits on never pay for them. Batch
+// consumers wait on a monotonic clock so wall clock jumps do not stretch the deadline.
+static int _internal_emb_rb_wait_setup(emb_rb_t *rb)
+{
+   uint8_t state = EMB_RB_WAIT_NONE;
+   if (__atomic_compare_exchange_n(&rb->wait_state, &state, EMB_RB_WAIT_INIT, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+   {
+      pthread_condattr_t attr;
+      pthread_condattr_init(&attr);
+      pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+      int rtn = pthread_mutex_init(&rb->wait_mtx, NULL);
+      if (!rtn && pthread_cond_init(&rb->wait_cv, &attr) != 0)
+      {
+         pthread_mutex_destroy(&rb->wait_mtx);
+         rtn = 1;
+      }
+      pthread_condattr_destroy(&attr);
+      __atomic_store_n(&rb->wait_state, rtn ? EMB_RB_WAIT_NONE : EMB_RB_WAIT_READY, __ATOMIC_RELEASE);
+      return(!rtn);
+   }
+   // Someone else is setting them up
+   while ((state = __atomic_load_n(&rb->wait_state, __ATOMIC_ACQUIRE)) == EMB_RB_WAIT_INIT)
+   {
+      sched_yield();
+   }
+   return(state == EMB_RB_WAIT_READY);
+}
+
+// Absolute monotonic deadline max_wait_ns from now, saturated so a huge wait does not wrap into the past
+static inline uint64_t _internal_emb_rb_deadline(uint64_t max_wait_ns)
+{
+   uint64_t now = _internal_emb_rb_now_ns();
+   return(max_wait_ns > UINT64_MAX - now ? UINT64_MAX : now + max_wait_ns);
+}
+
+// Sleep until min_bytes are queued, the absolute deadline passes or *stop is set
+static uint64_t _internal_emb_rb_wait_until(emb_rb_t *rb, uint64_t min_bytes, uint64_t deadline, const uint8_t *stop)
+{
+   uint64_t used = emb_rb_used_space64(rb);
+   if (used >= min_bytes || !_internal_emb_rb_wait_setup(rb))
+   {
+      return(used);
+   }
+   struct timespec ts;
+   ts.tv_sec  = (time_t)(deadline / 1000000000ull);
+   ts.tv_nsec = (long)(deadline % 1000000000ull);
+
+   pthread_mutex_lock(&rb->wait_mtx);
+   // Producers publish under the ring lock and check waiters after the unlock, registering under it
+   // means either they see us or we see their bytes. The fence covers rings without a lock.
+   emb_rb_lock_acquire(&rb->lock);
+   __atomic_add_fetch(&rb->waiters, 1, __ATOMIC_RELAXED);
+   emb_rb_lock_release(&rb->lock);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   // The ring size is re-read every round so an elastic ring that shrank can still satisfy the wait
+   while ((used = emb_rb_used_space64(rb)) < min_bytes && used < emb_rb_size64(rb, NULL))
+   {
+      if (stop && __atomic_load_n(stop, __ATOMIC_ACQUIRE))
+      {
+         break;
+      }
+      if (pthread_cond_timedwait(&rb->wait_cv, &rb->wait_mtx, &ts) != 0)
+      {
+         used = emb_rb_used_space64(rb);
+         break;
+      }
+   }
+   __atomic_sub_fetch(&rb->waiters, 1, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&rb->wait_mtx);
+   return(used);
+}
+
+// Sleep until min_bytes are queued, the deadline passes or *stop is set
+uint64_t emb_rb_wait(emb_rb_t *rb, uint64_t min_bytes, uint64_t max_wait_ns, const uint8_t *stop)
+{
+   // Null check
+   if (!rb)
+   {
+      return(0);
+   }
+   if (!max_wait_ns)
+   {
+      return(emb_rb_used_space64(rb));
+   }
+   return(_internal_emb_rb_wait_until(rb, min_bytes, _internal_emb_rb_deadline(max_wait_ns), stop));
+}
+
+// Dequeue a batch once min_bytes are queued or the deadline passes, sleeping in between
+uint64_t emb_rb_dequeue_batch(emb_rb_t *rb, uint8_t *bytes, uint64_t min_bytes, uint64_t max_bytes, uint64_t max_wait_ns, int *err)
+{
+   // Null check
+   if (!rb || !bytes || !max_bytes)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   uint64_t deadline = _internal_emb_rb_deadline(max_wait_ns);
+   if (min_bytes > max_bytes)
+   {
+      min_bytes = max_bytes;
+   }
+   // The dequeue only tries the lock, keep retrying contention until the deadline so bytes that
+   // arrived are not reported as EMB_RB_ERR_LOCK
+   for (;;)
+   {
+      if (max_wait_ns)
+      {
+         _internal_emb_rb_wait_until(rb, min_bytes, deadline, NULL);
+      }
+      int      rtn = EMB_RB_ERR_OK;
+      uint64_t len = emb_rb_dequeue64(rb, bytes, max_bytes, &rtn);
+      if (rtn != EMB_RB_ERR_LOCK || !max_wait_ns || _internal_emb_rb_now_ns() >= deadline)
+      {
+         if (err)
+         {
+            *err = rtn;
+         }
+         return(len);
+      }
+      sched_yield();
+   }
+}
+
+// Split len bytes from physical index idx into at most two spans at the wrap
+static inline void _internal_emb_rb_spans(emb_rb_t *rb, uint64_t idx, uint64_t len, emb_rb_span_t spans[2])
+{
+   uint64_t till_wrap = rb->size - idx;
+
+   spans[0].ptr = rb->bP + idx;
+   spans[0].len = len < till_wrap ? len : till_wrap;
+   spans[1].ptr = rb->bP;
+   spans[1].len = len - spans[0].len;
+}
+
+// Describe queued bytes in place
+uint64_t emb_rb_read_spans(emb_rb_t *rb, uint64_t position, emb_rb_span_t spans[2], uint64_t max_len)
+{
+   // Null check
+   if (!rb || !spans)
+   {
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   uint64_t len  = position < used ? used - position : 0;
+   if (len > max_len)
+   {
+      len = max_len;
+   }
+   _internal_emb_rb_spans(rb, _internal_emb_rb_advance(rb, rb->tail_idx, len ? position : 0), len, spans);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   return(len);
+}
+
+// Describe free space in place
+uint64_t emb_rb_write_spans(emb_rb_t *rb, uint64_t position, emb_rb_span_t spans[2], uint64_t max_len)
+{
+   // Null check
+   if (!rb || !spans)
+   {
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   uint64_t space = _internal_emb_rb_free_space(rb);
+   uint64_t len   = position < space ? space - position : 0;
+   if (len > max_len)
+   {
+      len = max_len;
+   }
+   _internal_emb_rb_spans(rb, _internal_emb_rb_advance(rb, rb->head_idx, len ? position : 0), len, spans);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   return(len);
+}
+
+// Publish bytes that were written in place
+uint64_t emb_rb_publish(emb_rb_t *rb, uint64_t len)
+{
+   // Null check
+   if (!rb)
+   {
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   uint64_t space = _internal_emb_rb_free_space(rb);
+   if (len > space)
+   {
+      len = space;
+   }
+   rb->head_idx = _internal_emb_rb_advance(rb, rb->head_idx, len);
+   _internal_emb_rb_store(&rb->head, rb->head + len);
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   if (len)
+   {
+      _internal_emb_rb_wake(rb);
+   }
+   return(len);
+}
+
+// Write up to max_len queued bytes to fd straight from ring storage, then consume what was written
+uint64_t emb_rb_write_fd(emb_rb_t *rb, int fd, uint64_t max_len, int *err)
+{
+   struct iovec iov[2];
+   int          cnt = 0;
+
+   // Null check
+   if (!rb || fd < 0 || !max_len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   uint64_t len = _internal_emb_rb_used_space(rb) - rb->tail_pend;
+   if (len > max_len)
+   {
+      len = max_len;
+   }
+   if (len > SSIZE_MAX)
+   {
+      len = SSIZE_MAX;
+   }
+   uint64_t start     = rb->tail + rb->tail_pend;
+   uint64_t idx       = _internal_emb_rb_advance(rb, rb->tail_idx, rb->tail_pend);
+   uint64_t till_wrap = rb->size - idx;
+   iov[cnt].iov_base = rb->bP + idx;
+   iov[cnt].iov_len  = (size_t)(len < till_wrap ? len : till_wrap);
+   cnt++;
+   if (len > till_wrap)
+   {
+      iov[cnt].iov_base = rb->bP;
+      iov[cnt].iov_len  = (size_t)(len - till_wrap);
+      cnt++;
+   }
+   // On rings set up with unlocked_copy the write runs outside the lock like a large emb_rb_dequeue,
+   // the bytes stay reserved past the tail so whatever moves it waits for the write. Every other ring
+   // keeps the lock for the duration, so do elastic rings since a grow may move their storage.
+   ssize_t written;
+   int     wr_errno = 0;
+   if (rb->lock.unlocked_copy && !rb->elastic && len)
+   {
+      rb->tail_pend += len;
+      rb->copying++;
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+
+      written  = writev(fd, iov, cnt);
+      wr_errno = errno;
+
+      // Publish in reservation order, then consume what was written
+      emb_rb_lock_acquire(&rb->lock);
+      while (rb->tail != start)
+      {
+         emb_rb_lock_release(&rb->lock);
+         sched_yield();
+         emb_rb_lock_acquire(&rb->lock);
+      }
+      rb->tail_pend -= len;
+      rb->copying--;
+      if (written > 0)
+      {
+         _internal_emb_rb_set_tail(rb, _internal_emb_rb_advance(rb, rb->tail_idx, (uint64_t)written), rb->tail + (uint64_t)written);
+      }
+      emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      _internal_emb_rb_fire(rb, crossed);
+   }
+   else
+   {
+      written  = len ? writev(fd, iov, cnt) : 0;
+      wr_errno = errno;
+      if (written > 0)
+      {
+         _internal_emb_rb_set_tail(rb, _internal_emb_rb_advance(rb, rb->tail_idx, (uint64_t)written), rb->tail + (uint64_t)written);
+         if (rb->elastic)
+         {
+            _internal_emb_rb_shrink(rb);
+         }
+      }
+      emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      _internal_emb_rb_fire(rb, crossed);
+   }
+   if (written < 0)
+   {
+      // The unlock and the watermark callback may have clobbered it
+      errno = wr_errno;
+      if (err)
+      {
+         *err = EMB_RB_ERR_IO;
+      }
+      return(0);
+   }
+   if (err)
+   {
+      *err = len ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_EMPTY;
+   }
+   return((uint64_t)written);
+}
+
+// Peek under the lock
+static uint64_t _internal_emb_rb_peek_locked(emb_rb_t *rb, uint64_t position, uint8_t *bytes, uint64_t len)
 {
-   // Handle the integer wrap around
-   if (rb->head < rb->tail)
+   // Lock the buffer, copies in flight never write the published bytes between tail and head so
+   // there is no need to wait for them
+   emb_rb_lock_acquire(&rb->lock);
+   // Illegal position check
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (position > used)
    {
-      return(rb->size - (rb->tail - rb->head));
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      return(0);
    }
-   else
+   // Illegal length + position check
+   if (len > used - position)
+   {
+      len = used - position;
+   }
+   // 1. If len is 1, just copy the byte
+   // 2. if len is greater than 1, handle the wrap around
+   // 3. otherwise len is 0 and don't do anything
+   uint64_t cur_index = _internal_emb_rb_advance(rb, rb->tail_idx, position);
+   if (len == 1)
    {
-      return(rb->head - rb->tail);
+      *bytes = rb->bP[cur_index];
    }
+   else if (len > 1)
+   {
+      _internal_emb_rb_read(rb, cur_index, bytes, len);
+   }
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   return(len);
 }
 
-// Get the number of free bytes in the ring buffer
-static uint32_t _internal_emb_rb_free_space(emb_rb_t *rb)
+// Peek len number of bytes at position, from the ring buffer without dequeuing
+uint32_t emb_rb_peek(emb_rb_t *rb, uint32_t position, uint8_t *bytes, uint32_t len)
 {
-   return(rb->size - _internal_emb_rb_used_space(rb));
+   return((uint32_t)emb_rb_peek64(rb, position, bytes, len));
 }
 
-// Initialize the ring buffer
-int emb_rb_init(emb_rb_t *rb, uint8_t *bP, uint32_t size)
+// Peek len number of bytes at position without dequeuing, 64 bit position and length
+uint64_t emb_rb_peek64(emb_rb_t *rb, uint64_t position, uint8_t *bytes, uint64_t len)
 {
    // Null check
-   if (!rb || !bP || !size)
+   if (!rb || !bytes || !len)
    {
-      return(EMB_RB_ERR_ILLEGAL_ARGS);
+      return(0);
    }
-   rb->bP   = bP;
-   rb->size = size;
-   rb->head = 0;
-   rb->tail = 0;
-   if (pthread_mutex_init(&rb->lock, NULL) != 0)
+   if (rb->lock.optimistic_peek)
    {
-      return(EMB_RB_ERR_LOCK);
+      return(emb_rb_peek_optimistic(rb, position, bytes, len));
    }
-   return(EMB_RB_ERR_OK);
+   return(_internal_emb_rb_peek_locked(rb, position, bytes, len));
 }
 
-// Get the total size of the ring buffer
-uint32_t emb_rb_size(emb_rb_t *rb, int *err)
+// Peek without the lock, validating against the sequence counters afterwards
+uint64_t emb_rb_peek_optimistic(emb_rb_t *rb, uint64_t position, uint8_t *bytes, uint64_t len)
 {
    // Null check
-   if (!rb)
+   if (!rb || !bytes || !len)
+   {
+      return(0);
+   }
+   // Elastic rings can free the storage under us
+   for (uint32_t attempt = 0; !rb->elastic && attempt < EMB_RB_SNAPSHOT_RETRIES; attempt++)
+   {
+      uint64_t seq, tail_seq, tail, idx;
+      if (!_internal_emb_rb_tail_pair(rb, &seq, &tail_seq, &tail, &idx))
+      {
+         sched_yield();
+         continue;
+      }
+      uint64_t used = _internal_emb_rb_load(&rb->head) - tail;
+      uint64_t n    = 0;
+      if (used > rb->size)
+      {
+         used = rb->size;
+      }
+      if (position <= used)
+      {
+         n = len < used - position ? len : used - position;
+         if (n == 1)
+         {
+            *bytes = rb->bP[_internal_emb_rb_advance(rb, idx, position)];
+         }
+         else if (n > 1)
+         {
+            _internal_emb_rb_read(rb, _internal_emb_rb_advance(rb, idx, position), bytes, n);
+         }
+      }
+      // Any consumer or rewrite since the pair was taken may have touched what we copied
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&rb->tail_seq, __ATOMIC_RELAXED) == tail_seq &&
+          __atomic_load_n(&rb->seq, __ATOMIC_RELAXED) == seq)
+      {
+         return(n);
+      }
+   }
+   return(_internal_emb_rb_peek_locked(rb, position, bytes, len));
+}
+
+// Copy the oldest queued bytes without the lock
+uint64_t emb_rb_snapshot(emb_rb_t *rb, uint8_t *bytes, uint64_t len, uint64_t *start, int *err)
+{
+   // Null check
+   if (!rb || !bytes || !len || rb->elastic)
    {
       if (err)
       {
@@ -77,32 +1640,239 @@ uint32_t emb_rb_size(emb_rb_t *rb, int *err)
       }
       return(0);
    }
-   // Lock the buffer, get the size, and unlock
-   if (pthread_mutex_trylock(&rb->lock) != 0)
+   for (uint32_t attempt = 0; attempt < EMB_RB_SNAPSHOT_RETRIES; attempt++)
    {
+      // Take the tail and its physical index as a consistent pair
+      uint64_t seq, tail_seq, tail, idx;
+      if (!_internal_emb_rb_tail_pair(rb, &seq, &tail_seq, &tail, &idx))
+      {
+         sched_yield();
+         continue;
+      }
+      // head is read after the tail, so head - tail may exceed the size if consumers and producers
+      // both moved on in between, the stale front is trimmed below either way
+      uint64_t n = _internal_emb_rb_load(&rb->head) - tail;
+      if (n > rb->size)
+      {
+         n = rb->size;
+      }
+      if (n > len)
+      {
+         n = len;
+      }
+      _internal_emb_rb_read(rb, idx, bytes, n);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      uint64_t now = __atomic_load_n(&rb->tail, __ATOMIC_RELAXED);
+      if (__atomic_load_n(&rb->seq, __ATOMIC_RELAXED) != seq)
+      {
+         sched_yield();
+         continue;
+      }
+      // A producer can only reuse storage behind the tail, so everything from the current tail on is
+      // intact. Drop what was consumed meanwhile, retry if that was all of it.
+      uint64_t stale = now - tail;
+      if (n && stale >= n)
+      {
+         continue;
+      }
+      if (stale)
+      {
+         memmove(bytes, bytes + stale, n - stale);
+         n -= stale;
+      }
+      if (start)
+      {
+         *start = tail + stale;
+      }
       if (err)
       {
-         *err = EMB_RB_ERR_LOCK;
+         *err = n ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_EMPTY;
       }
+      return(n);
+   }
+   if (err)
+   {
+      *err = EMB_RB_ERR_STALE;
+   }
+   return(0);
+}
+
+// Insert len number of bytes into the ring buffer at position
+uint32_t emb_rb_insert(emb_rb_t *rb, uint32_t position, const uint8_t *bytes, uint32_t len, uint8_t all_or_nothing)
+{
+   return((uint32_t)emb_rb_insert64(rb, position, bytes, len, all_or_nothing));
+}
+
+// Insert len number of bytes into the ring buffer at position, 64 bit position and length
+uint64_t emb_rb_insert64(emb_rb_t *rb, uint64_t position, const uint8_t *bytes, uint64_t len, uint8_t all_or_nothing)
+{
+   // Null check
+   if (!rb || !bytes || !len)
+   {
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   // Illegal position check
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (position > used)
+   {
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
       return(0);
    }
-   uint32_t size = rb->size;
-   pthread_mutex_unlock(&rb->lock);
+   // Check if there is enough free space
+   uint64_t space = rb->size - used;
+   if (len > space)
+   {
+      if (all_or_nothing)
+      {
+         // Unlock the buffer
+         emb_rb_lock_release(&rb->lock);
+         return(0);
+      }
+      else
+      {
+         len = space;
+      }
+   }
+   // Shift the data from position to head to the right by len bytes, then back fill at position
+   uint64_t pos_index = _internal_emb_rb_advance(rb, rb->tail_idx, position);
+   _internal_emb_rb_edit_begin(rb);
+   _internal_emb_rb_move(rb, _internal_emb_rb_advance(rb, pos_index, len), pos_index, used - position, 1);
+   _internal_emb_rb_write(rb, pos_index, bytes, len);
+   rb->head_idx = _internal_emb_rb_advance(rb, rb->head_idx, len);
+   _internal_emb_rb_store(&rb->head, rb->head + len);
+   _internal_emb_rb_edit_end(rb);
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   if (len)
+   {
+      _internal_emb_rb_wake(rb);
+   }
+   return(len);
+}
 
-   // Set the error code
-   if (err)
+// Remove len number of bytes from the ring buffer at position
+uint32_t emb_rb_remove(emb_rb_t *rb, uint32_t position, uint8_t *bytes, uint32_t len, uint8_t all_or_nothing)
+{
+   return((uint32_t)emb_rb_remove64(rb, position, bytes, len, all_or_nothing));
+}
+
+// Remove len number of bytes from the ring buffer at position, 64 bit position and length
+uint64_t emb_rb_remove64(emb_rb_t *rb, uint64_t position, uint8_t *bytes, uint64_t len, uint8_t all_or_nothing)
+{
+   // Null check
+   if (!rb || !len)
    {
-      *err = EMB_RB_ERR_OK;
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   // Illegal position check, there has to be something after position to remove
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (position >= used)
+   {
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      return(0);
+   }
+   // Respect all or nothing
+   uint64_t avail = used - position;
+   if (len > avail)
+   {
+      if (all_or_nothing)
+      {
+         // Unlock the buffer
+         emb_rb_lock_release(&rb->lock);
+         return(0);
+      }
+      else
+      {
+         len = avail;
+      }
+   }
+   // Copy the bytes to be removed, if requested.
+   uint64_t pos_index = _internal_emb_rb_advance(rb, rb->tail_idx, position);
+   if (bytes != NULL)
+   {
+      _internal_emb_rb_read(rb, pos_index, bytes, len);
    }
+   // Remove the data by shifting the rest of the data left.
+   _internal_emb_rb_edit_begin(rb);
+   _internal_emb_rb_move(rb, pos_index, _internal_emb_rb_advance(rb, pos_index, len), avail - len, 0);
 
-   return(size);
+   // Adjust the head of the buffer.
+   rb->head_idx = _internal_emb_rb_retreat(rb, rb->head_idx, len);
+   _internal_emb_rb_store(&rb->head, rb->head - len);
+   _internal_emb_rb_edit_end(rb);
+
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   return(len);
 }
 
-// Queue a single byte into the ring buffer, making a deep copy
-uint8_t emb_rb_queue_single(emb_rb_t *rb, uint8_t byte, int *err)
+// Effectively empty the buffer by setting the tail vaule to the head value
+int emb_rb_flush(emb_rb_t *rb)
+{
+   // Null check
+   if (!rb)
+   {
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   _internal_emb_rb_set_tail(rb, rb->head_idx, rb->head);
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   return(-1);
+}
+
+// Do a partial flush of len bytes from the tail
+uint32_t emb_rb_flush_partial(emb_rb_t *rb, uint32_t len)
+{
+   return((uint32_t)emb_rb_flush_partial64(rb, len));
+}
+
+// Do a partial flush of len bytes from the tail, 64 bit length
+uint64_t emb_rb_flush_partial64(emb_rb_t *rb, uint64_t len)
 {
    // Null check
    if (!rb)
+   {
+      return(0);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   // Check if there is enough used space
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (len > used)
+   {
+      len = used;
+   }
+   _internal_emb_rb_set_tail(rb, _internal_emb_rb_advance(rb, rb->tail_idx, len), rb->tail + len);
+   if (rb->elastic)
+   {
+      _internal_emb_rb_shrink(rb);
+   }
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   return(len);
+}
+
+// Move bytes from the tail of src to the head of dst without an intermediate copy
+uint64_t emb_rb_transfer(emb_rb_t *dst, emb_rb_t *src, uint64_t max_len, int *err)
+{
+   // Null check
+   if (!dst || !src || dst == src || !max_len)
    {
       if (err)
       {
@@ -110,8 +1880,10 @@ uint8_t emb_rb_queue_single(emb_rb_t *rb, uint8_t byte, int *err)
       }
       return(0);
    }
-   // Lock the buffer
-   if (pthread_mutex_trylock(&rb->lock) != 0)
+   // Lock both buffers, lower address first
+   emb_rb_t *first  = dst < src ? dst : src;
+   emb_rb_t *second = dst < src ? src : dst;
+   if (!_internal_emb_rb_trylock(first))
    {
       if (err)
       {
@@ -119,35 +1891,118 @@ uint8_t emb_rb_queue_single(emb_rb_t *rb, uint8_t byte, int *err)
       }
       return(0);
    }
-   uint8_t ret = 0;
-   // Check if there is enough free space
-   if (_internal_emb_rb_free_space(rb))
+   if (!_internal_emb_rb_trylock(second))
    {
-      // Queue the byte
-      rb->bP[rb->head % rb->size] = byte;
-      rb->head++;
-      ret = 1;
-
-      // Set the error code
+      emb_rb_lock_release(&first->lock);
       if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   // Limit the batch to what src holds and dst can take, elastic destinations grow first
+   uint64_t used  = _internal_emb_rb_used_space(src);
+   uint64_t len   = max_len < used ? max_len : used;
+   uint64_t space = _internal_emb_rb_free_space(dst);
+   if (len > space && dst->elastic)
+   {
+      _internal_emb_rb_grow(dst, len);
+      space = _internal_emb_rb_free_space(dst);
+   }
+   if (len > space)
+   {
+      len = space;
+   }
+   // Copy in up to four segments, each one ends at the wrap of either ring
+   uint64_t s_idx = src->tail_idx;
+   uint64_t d_idx = dst->head_idx;
+   uint64_t n     = len;
+   while (n)
+   {
+      uint64_t chunk = n;
+      if (chunk > src->size - s_idx)
+      {
+         chunk = src->size - s_idx;
+      }
+      if (chunk > dst->size - d_idx)
+      {
+         chunk = dst->size - d_idx;
+      }
+      memcpy(dst->bP + d_idx, src->bP + s_idx, chunk);
+      s_idx = _internal_emb_rb_advance(src, s_idx, chunk);
+      d_idx = _internal_emb_rb_advance(dst, d_idx, chunk);
+      n    -= chunk;
+   }
+   dst->head_idx = d_idx;
+   _internal_emb_rb_store(&dst->head, dst->head + len);
+   _internal_emb_rb_set_tail(src, s_idx, src->tail + len);
+   if (dst->elastic)
+   {
+      _internal_emb_rb_mark_busy(dst);
+   }
+   if (src->elastic)
+   {
+      _internal_emb_rb_shrink(src);
+   }
+   emb_rb_wm_event_t dst_crossed = _internal_emb_rb_wm_update(dst);
+   emb_rb_wm_event_t src_crossed = _internal_emb_rb_wm_update(src);
+   // Unlock the buffers
+   emb_rb_lock_release(&second->lock);
+   emb_rb_lock_release(&first->lock);
+   _internal_emb_rb_fire(dst, dst_crossed);
+   _internal_emb_rb_fire(src, src_crossed);
+   if (len)
+   {
+      _internal_emb_rb_wake(dst);
+   }
+
+   if (err)
+   {
+      if (len > 0)
       {
          *err = EMB_RB_ERR_OK;
       }
+      else
+      {
+         *err = used ? EMB_RB_ERR_BUFFER_FULL : EMB_RB_ERR_BUFFER_EMPTY;
+      }
    }
-   else if (err)
+   return(len);
+}
+
+// Copy one element, the common sizes get a constant size memcpy the compiler turns into plain moves
+static inline void _internal_emb_rb_copy_elem(uint8_t *dst, const uint8_t *src, uint32_t elem_size)
+{
+   switch (elem_size)
    {
-      *err = EMB_RB_ERR_BUFFER_FULL;
+   case 4:
+      memcpy(dst, src, 4);
+      break;
+
+   case 8:
+      memcpy(dst, src, 8);
+      break;
+
+   case 16:
+      memcpy(dst, src, 16);
+      break;
+
+   case 32:
+      memcpy(dst, src, 32);
+      break;
+
+   default:
+      memcpy(dst, src, elem_size);
+      break;
    }
-   // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
-   return(ret);
 }
 
-// Queue len nubmer of bytes into the ring buffer, making a deep copy
-uint32_t emb_rb_queue(emb_rb_t *rb, const uint8_t *bytes, uint32_t len, int *err)
+// Queue up to n whole elements. size is a multiple of elem_size and indexes only move by whole
+// elements, so no element ever straddles the wrap.
+uint32_t emb_rb_push_n(emb_rb_t *rb, const void *elems, uint32_t n, int *err)
 {
    // Null check
-   if (!rb || !bytes || !len)
+   if (!rb || !rb->elem_size || !elems || !n)
    {
       if (err)
       {
@@ -156,7 +2011,7 @@ uint32_t emb_rb_queue(emb_rb_t *rb, const uint8_t *bytes, uint32_t len, int *err
       return(0);
    }
    // Lock the buffer
-   if (pthread_mutex_trylock(&rb->lock) != 0)
+   if (!_internal_emb_rb_trylock(rb))
    {
       if (err)
       {
@@ -164,58 +2019,43 @@ uint32_t emb_rb_queue(emb_rb_t *rb, const uint8_t *bytes, uint32_t len, int *err
       }
       return(0);
    }
-   // Check if there is enough free space
-   uint32_t space = _internal_emb_rb_free_space(rb);
-   if (len > space)
+   uint64_t space = _internal_emb_rb_free_space(rb) / rb->elem_size;
+   if (n > space)
    {
-      len = space;
+      n = (uint32_t)space;
    }
-   // 1. If len is 1, just copy the byte and index since we will have a modulo anyway
-   // 2. if len is greater than 1, handle the wrap around
-   // 3. otherwise len is 0 and don't do anything
-   if (len == 1)
+   uint64_t len = (uint64_t)n * rb->elem_size;
+   if (n == 1)
    {
-      rb->bP[rb->head % rb->size] = *bytes;
-      rb->head++;
+      _internal_emb_rb_copy_elem(rb->bP + rb->head_idx, (const uint8_t *)elems, rb->elem_size);
    }
-   else if (len > 1)
+   else if (n > 1)
    {
-      // Optimize for speed, handle an index wrap around
-      uint32_t cur_index     = rb->head % rb->size;
-      uint32_t len_till_wrap = rb->size - cur_index;
-      uint32_t n             = len;
-      if (n > len_till_wrap)
-      {
-         memcpy(rb->bP + cur_index, bytes, len_till_wrap);
-         bytes    += len_till_wrap;
-         n        -= len_till_wrap;
-         cur_index = 0;
-      }
-      memcpy(rb->bP + cur_index, bytes, n);
-      rb->head += len;
+      _internal_emb_rb_write(rb, rb->head_idx, (const uint8_t *)elems, len);
    }
+   rb->head_idx = _internal_emb_rb_advance(rb, rb->head_idx, len);
+   _internal_emb_rb_store(&rb->head, rb->head + len);
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
    // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   if (n)
+   {
+      _internal_emb_rb_wake(rb);
+   }
 
    if (err)
    {
-      if (len > 0)
-      {
-         *err = EMB_RB_ERR_OK;
-      }
-      else
-      {
-         *err = EMB_RB_ERR_BUFFER_FULL;
-      }
+      *err = n ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_FULL;
    }
-   return(len);
+   return(n);
 }
 
-// Dequeue len number of bytes from the ring buffer
-uint32_t emb_rb_dequeue(emb_rb_t *rb, uint8_t *bytes, uint32_t len, int *err)
+// Dequeue up to n whole elements
+uint32_t emb_rb_pop_n(emb_rb_t *rb, void *elems, uint32_t n, int *err)
 {
    // Null check
-   if (!rb || !bytes || !len)
+   if (!rb || !rb->elem_size || !elems || !n)
    {
       if (err)
       {
@@ -224,7 +2064,7 @@ uint32_t emb_rb_dequeue(emb_rb_t *rb, uint8_t *bytes, uint32_t len, int *err)
       return(0);
    }
    // Lock the buffer
-   if (pthread_mutex_trylock(&rb->lock) != 0)
+   if (!_internal_emb_rb_trylock(rb))
    {
       if (err)
       {
@@ -232,321 +2072,491 @@ uint32_t emb_rb_dequeue(emb_rb_t *rb, uint8_t *bytes, uint32_t len, int *err)
       }
       return(0);
    }
-   // Check if there is enough used space
-   uint32_t used = _internal_emb_rb_used_space(rb);
-   if (len > used)
+   uint64_t avail = _internal_emb_rb_used_space(rb) / rb->elem_size;
+   if (n > avail)
    {
-      len = used;
+      n = (uint32_t)avail;
    }
-   // 1. If len is 1, just copy the byte and index since we will have a modulo anyway
-   // 2. if len is greater than 1, handle the wrap around
-   // 3. otherwise len is 0 and don't do anything
-   if (len == 1)
+   uint64_t len = (uint64_t)n * rb->elem_size;
+   if (n == 1)
    {
-      *bytes = rb->bP[rb->tail % rb->size];
-      rb->tail++;
+      _internal_emb_rb_copy_elem((uint8_t *)elems, rb->bP + rb->tail_idx, rb->elem_size);
    }
-   else if (len > 1)
+   else if (n > 1)
    {
-      // Optimize for speed, handle an index wrap around
-      uint32_t cur_index     = rb->tail % rb->size;
-      uint32_t len_till_wrap = rb->size - cur_index;
-      uint32_t n             = len;
-      if (n > len_till_wrap)
-      {
-         memcpy(bytes, rb->bP + cur_index, len_till_wrap);
-         bytes    += len_till_wrap;
-         n        -= len_till_wrap;
-         cur_index = 0;
-      }
-      memcpy(bytes, rb->bP + cur_index, n);
-      rb->tail += len;
+      _internal_emb_rb_read(rb, rb->tail_idx, (uint8_t *)elems, len);
    }
+   _internal_emb_rb_set_tail(rb, _internal_emb_rb_advance(rb, rb->tail_idx, len), rb->tail + len);
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
    // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
 
    if (err)
    {
-      if (len > 0)
-      {
-         *err = EMB_RB_ERR_OK;
-      }
-      else
-      {
-         *err = EMB_RB_ERR_BUFFER_EMPTY;
-      }
+      *err = n ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_EMPTY;
    }
-   return(len);
+   return(n);
 }
 
-// Peek len number of bytes at position, from the ring buffer without dequeuing
-uint32_t emb_rb_peek(emb_rb_t *rb, uint32_t position, uint8_t *bytes, uint32_t len)
+// Get the number of free bytes in the ring buffer
+uint32_t emb_rb_free_space(emb_rb_t *rb)
+{
+   return(_internal_emb_rb_clamp32(emb_rb_free_space64(rb)));
+}
+
+// Get the number of free bytes in the ring buffer, 64 bit size, without taking the lock
+uint64_t emb_rb_free_space64(emb_rb_t *rb)
 {
    // Null check
-   if (!rb || !bytes || !len)
+   if (!rb)
    {
       return(0);
    }
-   // Lock the buffer
-   pthread_mutex_lock(&rb->lock);
-   // Illegal position check
-   if (position > rb->size || (position > _internal_emb_rb_used_space(rb)))
+   uint64_t size = _internal_emb_rb_load(&rb->size);
+   return(size - _internal_emb_rb_used_space_unlocked(rb, size));
+}
+
+// Get the number of used bytes in the ring buffer
+uint32_t emb_rb_used_space(emb_rb_t *rb)
+{
+   return(_internal_emb_rb_clamp32(emb_rb_used_space64(rb)));
+}
+
+// Get the number of used bytes in the ring buffer, 64 bit size, without taking the lock
+uint64_t emb_rb_used_space64(emb_rb_t *rb)
+{
+   // Null check
+   if (!rb)
    {
-      // Unlock the buffer
-      pthread_mutex_unlock(&rb->lock);
       return(0);
    }
-   // Illegal length + position check
-   if (position + len > _internal_emb_rb_used_space(rb))
+   return(_internal_emb_rb_used_space_unlocked(rb, _internal_emb_rb_load(&rb->size)));
+}
+
+// Initialize a write combining producer handle
+int emb_rb_producer_init(emb_rb_producer_t *p, emb_rb_t *rb, uint32_t threshold)
+{
+   // Null check
+   if (!p || !rb || threshold > EMB_RB_PRODUCER_BUF)
    {
-      len = _internal_emb_rb_used_space(rb) - position;
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
    }
-   // 1. If len is 1, just copy the byte and index since we will have a modulo anyway
-   // 2. if len is greater than 1, handle the wrap around
-   // 3. otherwise len is 0 and don't do anything
-   uint32_t local_tail = rb->tail + position;
-   if (len == 1)
+   p->rb        = rb;
+   p->n         = 0;
+   p->threshold = threshold ? threshold : EMB_RB_PRODUCER_BUF;
+   p->trigger   = p->threshold;
+   return(EMB_RB_ERR_OK);
+}
+
+// Publish the staged bytes as one run, keep whatever did not fit
+int emb_rb_producer_flush(emb_rb_producer_t *p)
+{
+   // Null check
+   if (!p)
    {
-      *bytes = rb->bP[local_tail % rb->size];
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
    }
-   else if (len > 1)
+   if (!p->n)
    {
-      // Optimize for speed, handle an index wrap around
-      uint32_t cur_index     = local_tail % rb->size;
-      uint32_t len_till_wrap = rb->size - cur_index;
-      uint32_t n             = len;
-      if (n > len_till_wrap)
-      {
-         memcpy(bytes, rb->bP + cur_index, len_till_wrap);
-         bytes    += len_till_wrap;
-         n        -= len_till_wrap;
-         cur_index = 0;
-      }
-      memcpy(bytes, rb->bP + cur_index, n);
+      return(EMB_RB_ERR_OK);
    }
-   // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
-   return(len);
+   int      err;
+   uint32_t sent = emb_rb_queue(p->rb, p->buf, p->n, &err);
+   if (sent && sent < p->n)
+   {
+      memmove(p->buf, p->buf + sent, p->n - sent);
+   }
+   p->n -= sent;
+   // Keep staging until the buffer is full before trying again
+   if (p->n)
+   {
+      p->trigger = EMB_RB_PRODUCER_BUF + 1;
+      return(err == EMB_RB_ERR_LOCK ? EMB_RB_ERR_LOCK : EMB_RB_ERR_BUFFER_FULL);
+   }
+   p->trigger = p->threshold;
+   return(EMB_RB_ERR_OK);
 }
 
-// Insert len number of bytes into the ring buffer at position
-uint32_t emb_rb_insert(emb_rb_t *rb, uint32_t position, const uint8_t *bytes, uint32_t len, uint8_t all_or_nothing)
+// Publish once the threshold is hit, the spare byte is only ever used here
+uint8_t emb_rb_producer_put_slow(emb_rb_producer_t *p)
 {
-   // Null check
-   if (!rb || !bytes || !len)
+   emb_rb_producer_flush(p);
+   if (p->n > EMB_RB_PRODUCER_BUF)
    {
+      p->n--;
       return(0);
    }
+   return(1);
+}
+
+// Read a width byte integer at position, straight from storage unless it straddles the wrap
+static int _internal_emb_rb_get_uint(emb_rb_t *rb, uint64_t position, uint64_t *v, uint8_t width, uint8_t big)
+{
+   // Null check
+   if (!rb || !v)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
    // Lock the buffer
-   pthread_mutex_lock(&rb->lock);
-   // Illegal position check
-   if (position > rb->size || (position > _internal_emb_rb_used_space(rb)))
+   _internal_emb_rb_lock(rb);
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (position > used || width > used - position)
    {
       // Unlock the buffer
-      pthread_mutex_unlock(&rb->lock);
-      return(0);
+      emb_rb_lock_release(&rb->lock);
+      return(EMB_RB_ERR_BUFFER_EMPTY);
    }
-   // Check if there is enough free space
-   uint32_t space = _internal_emb_rb_free_space(rb);
-   if (len > space)
+   uint64_t idx = _internal_emb_rb_advance(rb, rb->tail_idx, position);
+   if (idx + width <= rb->size)
    {
-      if (all_or_nothing)
-      {
-         // Unlock the buffer
-         pthread_mutex_unlock(&rb->lock);
-         return(0);
-      }
-      else
-      {
-         len = space;
-      }
+      *v = _internal_emb_rb_decode(rb->bP + idx, width, big);
    }
-   // Calculate the real position in the buffer
-   uint32_t pos_index = (rb->tail + position) % rb->size;
-   uint32_t end_index = (rb->tail + _internal_emb_rb_used_space(rb)) % rb->size;
-
-   // Calculate the displacement considering the circular buffer.
-   uint32_t displacement = (pos_index > end_index) ? (rb->size - pos_index + end_index) : (end_index - pos_index);
-
-   // Copy the data from position to head to the right by len bytes.
-   memmove(rb->bP + (pos_index + len) % rb->size, rb->bP + pos_index, displacement);
-
-   // Back fill the original data at position
-   uint32_t len_till_wrap = rb->size - pos_index;
-   uint32_t n             = len;
-   if (n > len_till_wrap)
+   else
    {
-      memcpy(rb->bP + pos_index, bytes, len_till_wrap);
-      bytes    += len_till_wrap;
-      n        -= len_till_wrap;
-      pos_index = 0;
+      uint8_t tmp[8];
+      _internal_emb_rb_read(rb, idx, tmp, width);
+      *v = _internal_emb_rb_decode(tmp, width, big);
    }
-   memcpy(rb->bP + pos_index, bytes, n);
-   rb->head += len;
    // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
-   return(len);
+   emb_rb_lock_release(&rb->lock);
+   return(EMB_RB_ERR_OK);
 }
 
-// Remove len number of bytes from the ring buffer at position
-uint32_t emb_rb_remove(emb_rb_t *rb, uint32_t position, uint8_t *bytes, uint32_t len, uint8_t all_or_nothing)
+// Overwrite a width byte integer at position, straight to storage unless it straddles the wrap
+static int _internal_emb_rb_put_uint(emb_rb_t *rb, uint64_t position, uint64_t v, uint8_t width, uint8_t big)
 {
    // Null check
-   if (!rb || !len)
+   if (!rb)
    {
-      return(0);
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
    }
    // Lock the buffer
-   pthread_mutex_lock(&rb->lock);
-   // Illegal position check
-   if (position > rb->size || position > _internal_emb_rb_used_space(rb))
+   _internal_emb_rb_lock(rb);
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (position > used || width > used - position)
    {
       // Unlock the buffer
-      pthread_mutex_unlock(&rb->lock);
-      return(0);
+      emb_rb_lock_release(&rb->lock);
+      return(EMB_RB_ERR_BUFFER_EMPTY);
+   }
+   uint64_t idx = _internal_emb_rb_advance(rb, rb->tail_idx, position);
+   _internal_emb_rb_edit_begin(rb);
+   if (idx + width <= rb->size)
+   {
+      _internal_emb_rb_encode(rb->bP + idx, v, width, big);
+   }
+   else
+   {
+      uint8_t tmp[8];
+      _internal_emb_rb_encode(tmp, v, width, big);
+      _internal_emb_rb_write(rb, idx, tmp, width);
+   }
+   _internal_emb_rb_edit_end(rb);
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   return(EMB_RB_ERR_OK);
+}
+
+// Typed little / big endian getters
+int emb_rb_get_u16le(emb_rb_t *rb, uint64_t position, uint16_t *v)
+{
+   uint64_t x   = 0;
+   int      err = _internal_emb_rb_get_uint(rb, position, v ? &x : NULL, 2, 0);
+
+   if (err == EMB_RB_ERR_OK)
+   {
+      *v = (uint16_t)x;
    }
+   return(err);
+}
 
-   // Calculate the real position in the buffer
-   uint32_t pos_index = (rb->tail + position) % rb->size;
-   uint32_t end_index = rb->head % rb->size;
+int emb_rb_get_u16be(emb_rb_t *rb, uint64_t position, uint16_t *v)
+{
+   uint64_t x   = 0;
+   int      err = _internal_emb_rb_get_uint(rb, position, v ? &x : NULL, 2, 1);
 
-   // Calculate the displacement considering the circular buffer.
-   uint32_t displacement = (end_index > pos_index) ? (end_index - pos_index) : (rb->size + end_index - pos_index);
+   if (err == EMB_RB_ERR_OK)
+   {
+      *v = (uint16_t)x;
+   }
+   return(err);
+}
 
-   // Respect all or nothing
-   if (_internal_emb_rb_used_space(rb) == 0)
+int emb_rb_get_u32le(emb_rb_t *rb, uint64_t position, uint32_t *v)
+{
+   uint64_t x   = 0;
+   int      err = _internal_emb_rb_get_uint(rb, position, v ? &x : NULL, 4, 0);
+
+   if (err == EMB_RB_ERR_OK)
+   {
+      *v = (uint32_t)x;
+   }
+   return(err);
+}
+
+int emb_rb_get_u32be(emb_rb_t *rb, uint64_t position, uint32_t *v)
+{
+   uint64_t x   = 0;
+   int      err = _internal_emb_rb_get_uint(rb, position, v ? &x : NULL, 4, 1);
+
+   if (err == EMB_RB_ERR_OK)
+   {
+      *v = (uint32_t)x;
+   }
+   return(err);
+}
+
+int emb_rb_get_u64le(emb_rb_t *rb, uint64_t position, uint64_t *v)
+{
+   return(_internal_emb_rb_get_uint(rb, position, v, 8, 0));
+}
+
+int emb_rb_get_u64be(emb_rb_t *rb, uint64_t position, uint64_t *v)
+{
+   return(_internal_emb_rb_get_uint(rb, position, v, 8, 1));
+}
+
+// Typed little / big endian setters
+int emb_rb_put_u16le(emb_rb_t *rb, uint64_t position, uint16_t v)
+{
+   return(_internal_emb_rb_put_uint(rb, position, v, 2, 0));
+}
+
+int emb_rb_put_u16be(emb_rb_t *rb, uint64_t position, uint16_t v)
+{
+   return(_internal_emb_rb_put_uint(rb, position, v, 2, 1));
+}
+
+int emb_rb_put_u32le(emb_rb_t *rb, uint64_t position, uint32_t v)
+{
+   return(_internal_emb_rb_put_uint(rb, position, v, 4, 0));
+}
+
+int emb_rb_put_u32be(emb_rb_t *rb, uint64_t position, uint32_t v)
+{
+   return(_internal_emb_rb_put_uint(rb, position, v, 4, 1));
+}
+
+int emb_rb_put_u64le(emb_rb_t *rb, uint64_t position, uint64_t v)
+{
+   return(_internal_emb_rb_put_uint(rb, position, v, 8, 0));
+}
+
+int emb_rb_put_u64be(emb_rb_t *rb, uint64_t position, uint64_t v)
+{
+   return(_internal_emb_rb_put_uint(rb, position, v, 8, 1));
+}
+
+// Decode an unsigned LEB128 varint at position
+int emb_rb_get_varint(emb_rb_t *rb, uint64_t position, uint64_t *v, uint32_t *len)
+{
+   // Null check
+   if (!rb || !v)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (position >= used)
    {
       // Unlock the buffer
-      pthread_mutex_unlock(&rb->lock);
-      return(0);
+      emb_rb_lock_release(&rb->lock);
+      return(EMB_RB_ERR_BUFFER_EMPTY);
    }
-   if (displacement < len)
+   uint64_t avail = used - position;
+   uint64_t idx   = _internal_emb_rb_advance(rb, rb->tail_idx, position);
+   uint64_t x     = 0;
+   uint32_t n     = 0;
+   int      ret   = EMB_RB_ERR_BUFFER_EMPTY;
+   while (n < avail && n < EMB_RB_VARINT_MAX)
    {
-      if (all_or_nothing)
+      uint8_t byte = rb->bP[idx];
+      if (++idx == rb->size)
       {
-         // Unlock the buffer
-         pthread_mutex_unlock(&rb->lock);
-         return(0);
+         idx = 0;
       }
-      else
+      // The last byte only has room for bit 63, anything more does not fit in 64 bits
+      if (n == EMB_RB_VARINT_MAX - 1 && byte > 1)
+      {
+         ret = EMB_RB_ERR_ILLEGAL_ARGS;
+         break;
+      }
+      x |= (uint64_t)(byte & 0x7F) << (7 * n);
+      n++;
+      if (!(byte & 0x80))
       {
-         len = displacement;
+         ret = EMB_RB_ERR_OK;
+         break;
       }
    }
-
-   // Copy the bytes to be removed, if requested.
-   uint32_t len_till_wrap = rb->size - pos_index;
-   uint32_t n             = len;
-   if (bytes != NULL)
+   // Ran out of the 10 byte budget without a terminator, the varint is malformed
+   if (ret == EMB_RB_ERR_BUFFER_EMPTY && n == EMB_RB_VARINT_MAX)
    {
-      if (n > len_till_wrap)
+      ret = EMB_RB_ERR_ILLEGAL_ARGS;
+   }
+   // Unlock the buffer
+   emb_rb_lock_release(&rb->lock);
+   if (ret == EMB_RB_ERR_OK)
+   {
+      *v = x;
+      if (len)
       {
-         memcpy(bytes, rb->bP + pos_index, len_till_wrap);
-         bytes    += len_till_wrap;
-         n        -= len_till_wrap;
-         pos_index = 0;
+         *len = n;
       }
-      memcpy(bytes, rb->bP + pos_index, n);
    }
+   return(ret);
+}
 
-   // Remove the data by shifting the rest of the data left.
-   n         = len;
-   pos_index = (rb->tail + position) % rb->size;
-   if (n > len_till_wrap)
+// Encode an unsigned LEB128 varint over the bytes at position
+int emb_rb_put_varint(emb_rb_t *rb, uint64_t position, uint64_t v, uint32_t *len)
+{
+   uint8_t  tmp[EMB_RB_VARINT_MAX];
+   uint32_t n = 0;
+
+   // Null check
+   if (!rb)
    {
-      memmove(rb->bP + pos_index, rb->bP + pos_index + len_till_wrap, len_till_wrap);
-      n        -= len_till_wrap;
-      pos_index = 0;
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
    }
-   memmove(rb->bP, rb->bP + n, n);
-
-   // Adjust the head of the buffer.
-   rb->head -= len;
-
+   do
+   {
+      tmp[n] = (uint8_t)(v & 0x7F);
+      v    >>= 7;
+      if (v)
+      {
+         tmp[n] |= 0x80;
+      }
+      n++;
+   } while (v);
+   // Lock the buffer
+   _internal_emb_rb_lock(rb);
+   uint64_t used = _internal_emb_rb_used_space(rb);
+   if (position > used || n > used - position)
+   {
+      // Unlock the buffer
+      emb_rb_lock_release(&rb->lock);
+      return(EMB_RB_ERR_BUFFER_EMPTY);
+   }
+   _internal_emb_rb_edit_begin(rb);
+   _internal_emb_rb_write(rb, _internal_emb_rb_advance(rb, rb->tail_idx, position), tmp, n);
+   _internal_emb_rb_edit_end(rb);
    // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
-   return(len);
+   emb_rb_lock_release(&rb->lock);
+   if (len)
+   {
+      *len = n;
+   }
+   return(EMB_RB_ERR_OK);
 }
 
-// Effectively empty the buffer by setting the tail vaule to the head value
-int emb_rb_flush(emb_rb_t *rb)
+// Pin the readable region for incremental parsing
+int emb_rb_cursor_begin(emb_rb_cursor_t *c, emb_rb_t *rb)
 {
    // Null check
-   if (!rb)
+   if (!c || !rb || rb->elastic)
    {
-      return(0);
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
    }
    // Lock the buffer
-   pthread_mutex_lock(&rb->lock);
-   rb->tail = rb->head;
+   _internal_emb_rb_lock(rb);
+   c->rb    = rb;
+   c->bP    = rb->bP;
+   c->size  = rb->size;
+   c->tail  = rb->tail;
+   c->seq   = rb->seq;
+   c->idx   = rb->tail_idx;
+   c->avail = _internal_emb_rb_used_space(rb);
+   c->pos   = 0;
    // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
-   return(-1);
+   emb_rb_lock_release(&rb->lock);
+   return(EMB_RB_ERR_OK);
 }
 
-// Do a partial flush of len bytes from the tail
-uint32_t emb_rb_flush_partial(emb_rb_t *rb, uint32_t len)
+// Read up to len pinned bytes without locking
+uint64_t emb_rb_cursor_read_bytes(emb_rb_cursor_t *c, uint8_t *bytes, uint64_t len)
 {
    // Null check
-   if (!rb)
+   if (!c || !c->rb || !bytes)
    {
       return(0);
    }
-   // Lock the buffer
-   pthread_mutex_lock(&rb->lock);
-   // Check if there is enough used space
-   uint32_t used = _internal_emb_rb_used_space(rb);
-   if (len > used)
+   if (len > c->avail - c->pos)
    {
-      len = used;
+      len = c->avail - c->pos;
    }
-   rb->tail += len;
-   // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
+   _internal_emb_rb_read(c->rb, c->idx, bytes, len);
+   c->idx  = _internal_emb_rb_advance(c->rb, c->idx, len);
+   c->pos += len;
    return(len);
 }
 
-// Get the number of free bytes in the ring buffer
-uint32_t emb_rb_free_space(emb_rb_t *rb)
+// Skip up to len pinned bytes
+uint64_t emb_rb_cursor_skip(emb_rb_cursor_t *c, uint64_t len)
 {
    // Null check
-   if (!rb)
+   if (!c || !c->rb)
    {
       return(0);
    }
-   // Lock the buffer
-   pthread_mutex_lock(&rb->lock);
-   uint32_t ret = (rb->size - _internal_emb_rb_used_space(rb));
-   // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
-   return(ret);
+   if (len > c->avail - c->pos)
+   {
+      len = c->avail - c->pos;
+   }
+   c->idx  = _internal_emb_rb_advance(c->rb, c->idx, len);
+   c->pos += len;
+   return(len);
 }
 
-// Get the number of used bytes in the ring buffer
-uint32_t emb_rb_used_space(emb_rb_t *rb)
+// Get the number of pinned bytes not read yet
+uint64_t emb_rb_cursor_remaining(const emb_rb_cursor_t *c)
 {
    // Null check
-   if (!rb)
+   if (!c || !c->rb)
    {
       return(0);
    }
+   return(c->avail - c->pos);
+}
+
+// Commit the consumed bytes in one step, only if nobody else consumed or rewrote them in the meantime
+int emb_rb_cursor_commit(emb_rb_cursor_t *c)
+{
+   // Null check
+   if (!c || !c->rb)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   emb_rb_t *rb  = c->rb;
+   int       ret = EMB_RB_ERR_OK;
    // Lock the buffer
-   pthread_mutex_lock(&rb->lock);
-   // Handle the integer wrap around
-   uint32_t ret = 0;
-   if (rb->head < rb->tail)
+   _internal_emb_rb_lock(rb);
+   if (rb->tail != c->tail || rb->seq != c->seq)
    {
-      ret = (rb->size - (rb->tail - rb->head));
+      ret = EMB_RB_ERR_STALE;
    }
    else
    {
-      ret = (rb->head - rb->tail);
+      _internal_emb_rb_set_tail(rb, c->idx, rb->tail + c->pos);
    }
+   emb_rb_wm_event_t crossed = _internal_emb_rb_wm_update(rb);
    // Unlock the buffer
-   pthread_mutex_unlock(&rb->lock);
+   emb_rb_lock_release(&rb->lock);
+   _internal_emb_rb_fire(rb, crossed);
+   c->rb = NULL;
    return(ret);
 }
 
+// Abort the cursor, nothing in the ring changes
+void emb_rb_cursor_abort(emb_rb_cursor_t *c)
+{
+   if (c)
+   {
+      c->rb = NULL;
+   }
+}
+
 // Get the version of the library
 const char *emb_rb_get_ver()
 {
@@ -583,6 +2593,19 @@ void emb_rb_destroy(emb_rb_t *rb)
    {
       return;
    }
-   // Destroy the mutex
-   pthread_mutex_destroy(&rb->lock);
+   // Elastic rings own their storage
+   if (rb->elastic)
+   {
+      rb->elastic->cfg.free(rb->elastic->cfg.ctx, rb->bP);
+      rb->elastic = NULL;
+      rb->bP      = NULL;
+   }
+   // Destroy the locks
+   emb_rb_lock_destroy(&rb->lock);
+   if (rb->wait_state == EMB_RB_WAIT_READY)
+   {
+      pthread_cond_destroy(&rb->wait_cv);
+      pthread_mutex_destroy(&rb->wait_mtx);
+      rb->wait_state = EMB_RB_WAIT_NONE;
+   }
 }
@@ -30,21 +30,161 @@ extern "C"
 #include <stdint.h>
 #include <stddef.h>
 #include <pthread.h>
+#include "emb_rb_lock.h"
 
 #define EMB_RB_ERR_OK              0
 #define EMB_RB_ERR_ILLEGAL_ARGS    -1
 #define EMB_RB_ERR_LOCK            -2
 #define EMB_RB_ERR_BUFFER_FULL     -3
 #define EMB_RB_ERR_BUFFER_EMPTY    -4
+#define EMB_RB_ERR_NO_MEM          -5
+#define EMB_RB_ERR_DROPPED         -6
+#define EMB_RB_ERR_STALE           -7
+#define EMB_RB_ERR_IO              -8
 
+// Largest ring the 64 bit API accepts, keeps index + length from overflowing
+#define EMB_RB_MAX_SIZE            (UINT64_MAX >> 1)
+
+// Longest LEB128 encoding of a 64 bit value
+#define EMB_RB_VARINT_MAX          10
+
+// emb_rb_queue / emb_rb_dequeue copies of at least this many bytes run outside the lock, on rings set
+// up with emb_rb_lock_cfg_t.unlocked_copy
+#ifndef EMB_RB_UNLOCKED_COPY_MIN
+#define EMB_RB_UNLOCKED_COPY_MIN    256
+#endif
+
+// Attempts emb_rb_snapshot makes before giving up with EMB_RB_ERR_STALE
+#ifndef EMB_RB_SNAPSHOT_RETRIES
+#define EMB_RB_SNAPSHOT_RETRIES    16
+#endif
+
+// Setup state of the batch consumer wait primitives
+#define EMB_RB_WAIT_NONE           0
+#define EMB_RB_WAIT_INIT           1
+#define EMB_RB_WAIT_READY          2
+
+// Elastic mode configuration, NULL hooks fall back to malloc / free
+typedef struct
+{
+   void *   (*alloc)(void *ctx, size_t size);
+   void     (*free)(void *ctx, void *p);
+   void *   ctx;
+   uint64_t max_size;
+   uint64_t idle_ns;
+} emb_rb_elastic_cfg_t;
+
+// Elastic mode resize statistics
 typedef struct
 {
-   uint8_t *       bP;
-   uint32_t        size;
-   size_t          head, tail;
-   pthread_mutex_t lock;
+   uint32_t grows, shrinks;
+   uint64_t bytes_moved;
+   uint64_t resize_ns;
+} emb_rb_elastic_stats_t;
+
+// Elastic mode state, owned by the caller and attached to the ring
+typedef struct
+{
+   emb_rb_elastic_cfg_t   cfg;
+   emb_rb_elastic_stats_t stats;
+   uint64_t               min_size;
+   uint8_t                busy;
+   uint64_t               busy_ns;
+} emb_rb_elastic_t;
+
+// Called when occupancy crosses a watermark, high is 1 on the way up and 0 on the way back down
+typedef void (*emb_rb_watermark_cb_t)(void *ctx, uint8_t high);
+
+// Watermark state, owned by the caller and attached to the ring. above flips to 1 when used space
+// reaches high and back to 0 only once it drops to low.
+typedef struct
+{
+   uint64_t              high, low;
+   emb_rb_watermark_cb_t cb;
+   void *                ctx;
+   uint8_t               above;
+} emb_rb_watermark_t;
+
+// Event loop readiness, owned by the caller and attached to the ring. data_fd becomes readable once
+// used space reaches data_threshold and space_fd once free space reaches space_threshold, each is
+// signaled once until emb_rb_notify_ack so a burst of calls costs one wakeup.
+typedef struct
+{
+   int      data_fd, space_fd;
+   uint64_t data_threshold, space_threshold;
+   uint8_t  data_signaled, space_signaled;
+} emb_rb_notify_t;
+
+// Ready set membership, filled in by emb_rb_set_add. While the ring holds data bit is set in word,
+// summary_bit in summary whenever word goes from empty to non empty, and wake runs for every new bit.
+typedef struct
+{
+   uint64_t *word, *summary;
+   uint64_t  bit, summary_bit;
+   void      (*wake)(void *ctx);
+   void *    ctx;
+} emb_rb_ready_t;
+
+// head and tail count every byte ever queued and dequeued, head_idx and tail_idx are where they sit in bP
+typedef struct
+{
+   uint8_t *           bP;
+   uint64_t            size;
+   uint64_t            head, tail;
+   uint64_t            head_idx, tail_idx;
+   emb_rb_lock_t       lock;
+   emb_rb_elastic_t *  elastic;
+   emb_rb_watermark_t *wm;
+   emb_rb_notify_t *   notify;
+   emb_rb_ready_t *    ready;
+   uint32_t            elem_size;  // 0 for byte rings, see emb_rb_init_elem
+   uint32_t            waiters;    // consumers blocked in emb_rb_dequeue_batch
+   uint64_t            seq;        // odd while queued bytes are rewritten in place, see emb_rb_snapshot
+   uint64_t            tail_seq;   // odd while tail and tail_idx are moved together
+   uint64_t            head_pend;  // bytes reserved past head by queue copies running outside the lock
+   uint64_t            tail_pend;  // bytes reserved past tail by dequeue copies running outside the lock
+   uint32_t            copying;    // number of those copies
+   uint8_t             wait_state; // EMB_RB_WAIT_*, wait_mtx and wait_cv are only set up by the first wait
+   pthread_mutex_t     wait_mtx;
+   pthread_cond_t      wait_cv;
 } emb_rb_t;
 
+// Staging size of a write combining producer handle
+#ifndef EMB_RB_PRODUCER_BUF
+#define EMB_RB_PRODUCER_BUF    64
+#endif
+
+// Write combining producer handle, owned by a single thread. buf has one spare byte so the inline put
+// can store before it compares. trigger is the staged count the inline put publishes at, threshold
+// normally, and the whole staging buffer after a publish came up short so a full ring is not retried
+// on every byte.
+typedef struct
+{
+   emb_rb_t *rb;
+   uint32_t  n, threshold, trigger;
+   uint8_t   buf[EMB_RB_PRODUCER_BUF + 1];
+} emb_rb_producer_t;
+
+// Incremental parse cursor, a pinned view of the readable region between begin and commit / abort
+typedef struct
+{
+   emb_rb_t *rb;
+   uint8_t * bP;
+   uint64_t  size;
+   uint64_t  tail;   // tail counter when the cursor was pinned
+   uint64_t  seq;    // rewrite sequence when the cursor was pinned
+   uint64_t  idx;    // physical index of the next byte to read
+   uint64_t  avail;  // bytes readable when the cursor was pinned
+   uint64_t  pos;    // bytes consumed so far
+} emb_rb_cursor_t;
+
+// A contiguous piece of ring storage, a region that wraps is described by two spans
+typedef struct
+{
+   uint8_t *ptr;
+   uint64_t len;
+} emb_rb_span_t;
+
 /**
  * @brief Initialize the ring buffer
  *
@@ -56,14 +196,151 @@ typedef struct
 int emb_rb_init(emb_rb_t *rb, uint8_t *bP, uint32_t size);
 
 /**
- * @brief Get the total size of the ring buffer
+ * @brief Initialize the ring buffer, 64 bit size
+ *
+ * @param rb pointer to the ring buffer we want to initialize
+ * @param bP pointer to the buffer we want to use
+ * @param size size of the buffer we want to use, at most EMB_RB_MAX_SIZE
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_init64(emb_rb_t *rb, uint8_t *bP, uint64_t size);
+
+/**
+ * @brief Initialize the ring buffer with a synchronization policy, see emb_rb_lock_cfg_t
+ *
+ * @param rb pointer to the ring buffer we want to initialize
+ * @param bP pointer to the buffer we want to use
+ * @param size size of the buffer we want to use, at most EMB_RB_MAX_SIZE
+ * @param lock pointer to the lock configuration, can be NULL for the default non blocking mutex
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_init_ex(emb_rb_t *rb, uint8_t *bP, uint64_t size, const emb_rb_lock_cfg_t *lock);
+
+/**
+ * @brief Initialize the ring buffer in fixed size element mode, use emb_rb_push_n / emb_rb_pop_n
+ * which only ever move whole elements. Mixing in the byte API breaks the element alignment.
+ *
+ * @param rb pointer to the ring buffer we want to initialize
+ * @param bP pointer to the buffer we want to use, at least elem_size * count bytes
+ * @param elem_size size of one element in bytes
+ * @param count number of elements the ring holds
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_init_elem(emb_rb_t *rb, uint8_t *bP, uint32_t elem_size, uint64_t count);
+
+/**
+ * @brief Initialize the ring buffer in elastic mode, the storage is allocated through the cfg hooks.
+ * When full, queueing grows the capacity geometrically up to cfg->max_size. Once the ring has used no
+ * more than a quarter of its capacity for cfg->idle_ns, it shrinks back by half down to size.
+ *
+ * @param rb pointer to the ring buffer we want to initialize
+ * @param el pointer to the elastic state, must stay valid until emb_rb_destroy
+ * @param size initial and minimum size of the buffer
+ * @param cfg pointer to the elastic configuration, can be NULL for malloc / free, no cap, and no shrinking
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_elastic_init(emb_rb_t *rb, emb_rb_elastic_t *el, uint64_t size, const emb_rb_elastic_cfg_t *cfg);
+
+/**
+ * @brief Shrink an elastic ring buffer that has been idle, for rings nobody is dequeuing from
+ *
+ * @param rb pointer to the ring buffer we want to maintain
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_elastic_tick(emb_rb_t *rb);
+
+/**
+ * @brief Get the resize statistics of an elastic ring buffer
+ *
+ * @param rb pointer to the ring buffer we want the statistics of
+ * @param stats pointer to where the statistics are copied
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_elastic_stats(emb_rb_t *rb, emb_rb_elastic_stats_t *stats);
+
+/**
+ * @brief Attach high / low watermarks to the ring. The callback fires once each time used space
+ * reaches high, and once when it later drops to low, from inside whichever queue, dequeue or flush
+ * call caused the crossing, after the lock is released.
+ *
+ * @param rb pointer to the ring buffer
+ * @param wm pointer to the watermark state, owned by the caller, NULL to detach
+ * @param high used space in bytes that raises the watermark
+ * @param low used space in bytes that clears it again, must be below high
+ * @param cb callback run on every crossing, can be NULL to only use emb_rb_watermark_high
+ * @param ctx context passed to cb
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_watermark_init(emb_rb_t *rb, emb_rb_watermark_t *wm, uint64_t high, uint64_t low, emb_rb_watermark_cb_t cb, void *ctx);
+
+/**
+ * @brief Get the watermark flag, wait-free, does not take the lock
+ *
+ * @param rb pointer to the ring buffer
+ * @return uint8_t 1 if the high watermark was reached and low has not been reached since, 0 otherwise
+ */
+uint8_t emb_rb_watermark_high(emb_rb_t *rb);
+
+/**
+ * @brief Attach eventfd readiness notifications to the ring so it can sit in an epoll / poll set. Watch
+ * both fds for readability: data_fd fires when used space reaches data_threshold, space_fd when free
+ * space reaches space_threshold. Each fd is signaled once and stays readable until emb_rb_notify_ack,
+ * which re-arms it and signals again right away if the condition still holds.
+ *
+ * @param rb pointer to the ring buffer
+ * @param n pointer to the notification state, owned by the caller
+ * @param data_threshold used space in bytes that makes data_fd readable, 0 for no data_fd
+ * @param space_threshold free space in bytes that makes space_fd readable, 0 for no space_fd
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_IO if an eventfd could not be created
+ */
+int emb_rb_notify_init(emb_rb_t *rb, emb_rb_notify_t *n, uint64_t data_threshold, uint64_t space_threshold);
+
+/**
+ * @brief Acknowledge a notification from the event loop, drains the fd and re-arms it
+ *
+ * @param rb pointer to the ring buffer
+ * @param fd the data_fd or space_fd that became readable
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_notify_ack(emb_rb_t *rb, int fd);
+
+/**
+ * @brief Detach the notifications from the ring and close their fds, call once no other thread is
+ * using the ring
+ *
+ * @param rb pointer to the ring buffer
+ */
+void emb_rb_notify_destroy(emb_rb_t *rb);
+
+/**
+ * @brief Attach the ring to a ready set, or detach it with NULL. Every operation that leaves data in the
+ * ring sets its ready bit if it is clear, a ring already holding data is flagged right away. Used by
+ * emb_rb_set_add / emb_rb_set_remove, call once no other thread is using the ring.
+ *
+ * @param rb pointer to the ring buffer
+ * @param ready pointer to the membership, owned by the set, NULL to detach
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_ready_attach(emb_rb_t *rb, emb_rb_ready_t *ready);
+
+/**
+ * @brief Get the total size of the ring buffer, wait-free, does not take the lock
  *
  * @param rb pointer to the ring buffer we want to get the size of
  * @param err pointer to the error code, can be NULL
- * @return uint32_t the size of the ring buffer in bytes
+ * @return uint32_t the size of the ring buffer in bytes, clamped to UINT32_MAX
  */
 uint32_t emb_rb_size(emb_rb_t *rb, int *err);
 
+/**
+ * @brief Get the total size of the ring buffer, 64 bit size, wait-free, does not take the lock
+ *
+ * @param rb pointer to the ring buffer we want to get the size of
+ * @param err pointer to the error code, can be NULL
+ * @return uint64_t the size of the ring buffer in bytes
+ */
+uint64_t emb_rb_size64(emb_rb_t *rb, int *err);
+
 /**
  * @brief Queue a single byte into the ring buffer, making a deep copy
  *
@@ -85,6 +362,29 @@ uint8_t emb_rb_queue_single(emb_rb_t *rb, uint8_t byte, int *err);
  */
 uint32_t emb_rb_queue(emb_rb_t *rb, const uint8_t *bytes, uint32_t len, int *err);
 
+/**
+ * @brief Queue len nubmer of bytes into the ring buffer, 64 bit length
+ *
+ * @param rb pointer to the ring buffer we want to queue bytes into
+ * @param bytes pointer to the bytes we want to queue
+ * @param len number of bytes we want to queue
+ * @param err pointer to the error code, can be NULL
+ * @return uint64_t number of bytes queued
+ */
+uint64_t emb_rb_queue64(emb_rb_t *rb, const uint8_t *bytes, uint64_t len, int *err);
+
+/**
+ * @brief Queue len number of bytes as one record, all or nothing, so a full ring never leaves half a
+ * variable length record behind for the consumer to trip over
+ *
+ * @param rb pointer to the ring buffer we want to queue the record into
+ * @param bytes pointer to the record
+ * @param len length of the record
+ * @param err pointer to the error code, EMB_RB_ERR_BUFFER_FULL if the record does not fit, can be NULL
+ * @return uint64_t len if the record was queued, 0 otherwise
+ */
+uint64_t emb_rb_queue_record(emb_rb_t *rb, const uint8_t *bytes, uint64_t len, int *err);
+
 /**
  * @brief Dequeue len number of bytes from the ring buffer
  *
@@ -96,6 +396,102 @@ uint32_t emb_rb_queue(emb_rb_t *rb, const uint8_t *bytes, uint32_t len, int *err
  */
 uint32_t emb_rb_dequeue(emb_rb_t *rb, uint8_t *bytes, uint32_t len, int *err);
 
+/**
+ * @brief Dequeue len number of bytes from the ring buffer, 64 bit length
+ *
+ * @param rb pointer to the ring buffer we want to dequeue bytes from
+ * @param bytes pointer to the bytes we want to dequeue
+ * @param len number of bytes we want to dequeue
+ * @param err pointer to the error code, can be NULL
+ * @return uint64_t number of bytes dequeued
+ */
+uint64_t emb_rb_dequeue64(emb_rb_t *rb, uint8_t *bytes, uint64_t len, int *err);
+
+/**
+ * @brief Dequeue a batch, blocking until at least min_bytes are queued or max_wait_ns has passed,
+ * whichever comes first. The caller sleeps on a condition variable that producers only signal while
+ * someone is waiting. Waiters register under the ring lock, so on locked rings the data path pays a
+ * single load when nobody is, rings set up with EMB_RB_LOCK_NONE also pay a full fence. Contention
+ * on the ring lock is retried until the deadline.
+ *
+ * @param rb pointer to the ring buffer we want to dequeue bytes from
+ * @param bytes pointer to the destination buffer
+ * @param min_bytes number of queued bytes that ends the wait early, clamped to max_bytes and the ring size
+ * @param max_bytes maximum number of bytes to dequeue
+ * @param max_wait_ns longest time to wait in nanoseconds, 0 to not wait at all
+ * @param err pointer to an error variable, will be set to EMB_RB_ERR_OK on success, negative error code on failure
+ * @return uint64_t number of bytes dequeued, can be below min_bytes if the deadline expired
+ */
+uint64_t emb_rb_dequeue_batch(emb_rb_t *rb, uint8_t *bytes, uint64_t min_bytes, uint64_t max_bytes, uint64_t max_wait_ns, int *err);
+
+/**
+ * @brief Sleep until at least min_bytes are queued, max_wait_ns has passed or *stop is set. Whoever
+ * sets *stop calls emb_rb_wake_waiters afterwards to end the wait early.
+ *
+ * @param rb pointer to the ring buffer
+ * @param min_bytes number of queued bytes that ends the wait
+ * @param max_wait_ns longest time to wait in nanoseconds, 0 to not wait at all
+ * @param stop pointer to a flag that ends the wait when set, can be NULL
+ * @return uint64_t number of bytes queued when the wait ended
+ */
+uint64_t emb_rb_wait(emb_rb_t *rb, uint64_t min_bytes, uint64_t max_wait_ns, const uint8_t *stop);
+
+/**
+ * @brief Write up to max_len queued bytes to fd with a single writev straight from ring storage and
+ * consume what was written. The caller must be the only consumer of the ring. On a ring set up with
+ * emb_rb_lock_cfg_t.unlocked_copy the writev runs outside the lock, otherwise the lock is held for it.
+ *
+ * @param rb pointer to the ring buffer we want to drain
+ * @param fd file descriptor we want to write to
+ * @param max_len maximum number of bytes to write
+ * @param err pointer to an error variable, EMB_RB_ERR_IO if writev failed with errno set, can be NULL
+ * @return uint64_t number of bytes written
+ */
+uint64_t emb_rb_write_fd(emb_rb_t *rb, int fd, uint64_t max_len, int *err);
+
+/**
+ * @brief Describe queued bytes in place, starting position bytes after the tail. The spans stay valid
+ * until those bytes are consumed, so only the ring's single consumer should use them. Not for elastic
+ * rings, a grow can move the storage.
+ *
+ * @param rb pointer to the ring buffer
+ * @param position offset from the tail of the first byte to describe
+ * @param spans pointer to two spans, the second one has len 0 unless the region wraps
+ * @param max_len maximum number of bytes to describe
+ * @return uint64_t number of bytes described
+ */
+uint64_t emb_rb_read_spans(emb_rb_t *rb, uint64_t position, emb_rb_span_t spans[2], uint64_t max_len);
+
+/**
+ * @brief Describe free space in place, starting position bytes after the head, so the ring's single
+ * producer can fill it directly (e.g. with read) and then make it visible with emb_rb_publish.
+ * Not for elastic rings, a grow can move the storage.
+ *
+ * @param rb pointer to the ring buffer
+ * @param position offset from the head of the first free byte to describe
+ * @param spans pointer to two spans, the second one has len 0 unless the region wraps
+ * @param max_len maximum number of bytes to describe
+ * @return uint64_t number of bytes described
+ */
+uint64_t emb_rb_write_spans(emb_rb_t *rb, uint64_t position, emb_rb_span_t spans[2], uint64_t max_len);
+
+/**
+ * @brief Publish len bytes that were written in place through emb_rb_write_spans, advancing the head
+ *
+ * @param rb pointer to the ring buffer
+ * @param len number of bytes to publish
+ * @return uint64_t number of bytes published, clamped to the free space
+ */
+uint64_t emb_rb_publish(emb_rb_t *rb, uint64_t len);
+
+/**
+ * @brief Wake consumers blocked in emb_rb_dequeue_batch or emb_rb_wait, producers call this for you.
+ * Exposed for the EMB_RB_INLINE hot paths and for stopping a wait.
+ *
+ * @param rb pointer to the ring buffer
+ */
+void emb_rb_wake_waiters(emb_rb_t *rb);
+
 /**
  * @brief Peek len number of bytes from the ring buffer without dequeuing
  *
@@ -107,6 +503,47 @@ uint32_t emb_rb_dequeue(emb_rb_t *rb, uint8_t *bytes, uint32_t len, int *err);
  */
 uint32_t emb_rb_peek(emb_rb_t *rb, uint32_t position, uint8_t *bytes, uint32_t len);
 
+/**
+ * @brief Peek len number of bytes from the ring buffer without dequeuing, 64 bit position and length
+ *
+ * @param rb pointer to the ring buffer we want to peek bytes from
+ * @param position the position offset from the tail we want to peek bytes
+ * @param bytes pointer to the bytes we want to peek
+ * @param len number of bytes we want to peek
+ * @return uint64_t number of bytes peeked
+ */
+uint64_t emb_rb_peek64(emb_rb_t *rb, uint64_t position, uint8_t *bytes, uint64_t len);
+
+/**
+ * @brief Peek without taking the lock. The indices are read and the bytes copied optimistically, then
+ * validated against the tail and rewrite sequence counters and retried on conflict, so concurrent
+ * peekers never serialize with each other or with producers. Falls back to the locked peek after
+ * EMB_RB_SNAPSHOT_RETRIES conflicts and for elastic rings. emb_rb_peek uses this when the ring was
+ * set up with emb_rb_lock_cfg_t.optimistic_peek.
+ *
+ * @param rb pointer to the ring buffer we want to peek bytes from
+ * @param position the position offset from the tail we want to peek bytes
+ * @param bytes pointer to the bytes we want to peek
+ * @param len number of bytes we want to peek
+ * @return uint64_t number of bytes peeked
+ */
+uint64_t emb_rb_peek_optimistic(emb_rb_t *rb, uint64_t position, uint8_t *bytes, uint64_t len);
+
+/**
+ * @brief Copy the oldest queued bytes without taking the lock, for diagnostics dumps. Bytes a consumer
+ * takes during the copy may already be overwritten, they are trimmed from the front and start tells
+ * where the copy begins. An in place rewrite (insert, remove, put) during the copy retries it. Producers
+ * and consumers never wait on a snapshot. Not for elastic rings.
+ *
+ * @param rb pointer to the ring buffer
+ * @param bytes pointer to the destination
+ * @param len maximum number of bytes to copy
+ * @param start if not NULL, the tail counter of bytes[0]
+ * @param err pointer to the error code, EMB_RB_ERR_STALE if every attempt raced with a rewrite
+ * @return uint64_t number of bytes copied
+ */
+uint64_t emb_rb_snapshot(emb_rb_t *rb, uint8_t *bytes, uint64_t len, uint64_t *start, int *err);
+
 /**
  * @brief Insert len number of bytes into the ring buffer at position
  *
@@ -119,6 +556,18 @@ uint32_t emb_rb_peek(emb_rb_t *rb, uint32_t position, uint8_t *bytes, uint32_t l
  */
 uint32_t emb_rb_insert(emb_rb_t *rb, uint32_t position, const uint8_t *bytes, uint32_t len, uint8_t all_or_nothing);
 
+/**
+ * @brief Insert len number of bytes into the ring buffer at position, 64 bit position and length
+ *
+ * @param rb pointer to the ring buffer we want to insert bytes into
+ * @param position the position offset from the tail we want to insert bytes
+ * @param bytes pointer to the bytes we want to insert
+ * @param len the number of bytes we want to insert
+ * @param all_or_nothing flag to indicate if we want to insert all or nothing, 1 for all or nothing, 0 for do as much as you can
+ * @return uint64_t number of bytes inserted
+ */
+uint64_t emb_rb_insert64(emb_rb_t *rb, uint64_t position, const uint8_t *bytes, uint64_t len, uint8_t all_or_nothing);
+
 /**
  * @brief Remove len number of bytes from the ring buffer at position
  *
@@ -131,6 +580,18 @@ uint32_t emb_rb_insert(emb_rb_t *rb, uint32_t position, const uint8_t *bytes, ui
  */
 uint32_t emb_rb_remove(emb_rb_t *rb, uint32_t position, uint8_t *bytes, uint32_t len, uint8_t all_or_nothing);
 
+/**
+ * @brief Remove len number of bytes from the ring buffer at position, 64 bit position and length
+ *
+ * @param rb pointer to the ring buffer we want to remove bytes from
+ * @param position the position offset from the tail we want to remove bytes
+ * @param bytes pointer to the bytes we want to remove, can be NULL
+ * @param len the number of bytes we want to remove
+ * @param all_or_nothing flag to indicate if we want to remove all or nothing, 1 for all or nothing, 0 for do as much as you can
+ * @return uint64_t number of bytes removed
+ */
+uint64_t emb_rb_remove64(emb_rb_t *rb, uint64_t position, uint8_t *bytes, uint64_t len, uint8_t all_or_nothing);
+
 /**
  * @brief Flush the ring buffer
  *
@@ -149,21 +610,267 @@ int emb_rb_flush(emb_rb_t *rb);
 uint32_t emb_rb_flush_partial(emb_rb_t *rb, uint32_t len);
 
 /**
- * @brief Get the free space in the ring buffer
+ * @brief Flush len number of bytes from the ring buffer, 64 bit length
+ *
+ * @param rb pointer to the ring buffer we want to flush bytes from
+ * @param len number of bytes we want to flush
+ * @return uint64_t number of bytes flushed
+ */
+uint64_t emb_rb_flush_partial64(emb_rb_t *rb, uint64_t len);
+
+/**
+ * @brief Move up to max_len bytes from the tail of src to the head of dst, copying straight between
+ * the two storages without an intermediate buffer. Both rings are locked for the duration, always in
+ * address order so two opposite transfers can not deadlock.
+ *
+ * @param dst pointer to the ring buffer we want to queue into
+ * @param src pointer to the ring buffer we want to dequeue from
+ * @param max_len maximum number of bytes to move, the batch is otherwise limited by src used and dst free space
+ * @param err pointer to an error variable, will be set to EMB_RB_ERR_OK on success, negative error code on failure
+ * @return uint64_t number of bytes moved
+ */
+uint64_t emb_rb_transfer(emb_rb_t *dst, emb_rb_t *src, uint64_t max_len, int *err);
+
+/**
+ * @brief Queue up to n whole elements into an element mode ring
+ *
+ * @param rb pointer to the ring buffer we want to queue elements into
+ * @param elems pointer to the elements, n * elem_size bytes
+ * @param n number of elements we want to queue
+ * @param err pointer to an error variable, will be set to EMB_RB_ERR_OK on success, negative error code on failure
+ * @return uint32_t number of elements queued
+ */
+uint32_t emb_rb_push_n(emb_rb_t *rb, const void *elems, uint32_t n, int *err);
+
+/**
+ * @brief Dequeue up to n whole elements from an element mode ring
+ *
+ * @param rb pointer to the ring buffer we want to dequeue elements from
+ * @param elems pointer to where the elements are stored, n * elem_size bytes
+ * @param n number of elements we want to dequeue
+ * @param err pointer to an error variable, will be set to EMB_RB_ERR_OK on success, negative error code on failure
+ * @return uint32_t number of elements dequeued
+ */
+uint32_t emb_rb_pop_n(emb_rb_t *rb, void *elems, uint32_t n, int *err);
+
+/**
+ * @brief Get the free space in the ring buffer, wait-free, does not take the lock
  *
  * @param rb pointer to the ring buffer we want to get the free space of
- * @return uint32_t free space in the ring buffer in bytes
+ * @return uint32_t free space in the ring buffer in bytes, clamped to UINT32_MAX
  */
 uint32_t emb_rb_free_space(emb_rb_t *rb);
 
 /**
- * @brief Get the used space in the ring buffer
+ * @brief Get the free space in the ring buffer, 64 bit size, wait-free, does not take the lock
+ *
+ * @param rb pointer to the ring buffer we want to get the free space of
+ * @return uint64_t free space in the ring buffer in bytes
+ */
+uint64_t emb_rb_free_space64(emb_rb_t *rb);
+
+/**
+ * @brief Get the used space in the ring buffer, wait-free, does not take the lock. The result is a
+ * snapshot that may be stale by the time it is returned, but it never exceeds the size.
  *
  * @param rb pointer to the ring buffer we want to get the used space of
- * @return uint32_t used space in the ring buffer in bytes
+ * @return uint32_t used space in the ring buffer in bytes, clamped to UINT32_MAX
  */
 uint32_t emb_rb_used_space(emb_rb_t *rb);
 
+/**
+ * @brief Get the used space in the ring buffer, 64 bit size, wait-free, does not take the lock
+ *
+ * @param rb pointer to the ring buffer we want to get the used space of
+ * @return uint64_t used space in the ring buffer in bytes
+ */
+uint64_t emb_rb_used_space64(emb_rb_t *rb);
+
+/**
+ * @brief Initialize a write combining producer handle. Bytes put through the handle are staged
+ * locally and published to the ring with a single emb_rb_queue once threshold bytes are staged, or on
+ * emb_rb_producer_flush. Bytes from one handle always reach the ring in order, and each publish is one
+ * contiguous run, so runs from different handles never interleave. A run is only split when the ring
+ * is short on space, the rest stays staged for the next publish.
+ *
+ * @param p pointer to the producer handle we want to initialize
+ * @param rb pointer to the ring buffer the handle publishes to
+ * @param threshold number of staged bytes that triggers a publish, 0 for EMB_RB_PRODUCER_BUF
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_producer_init(emb_rb_producer_t *p, emb_rb_t *rb, uint32_t threshold);
+
+/**
+ * @brief Publish the staged bytes of a producer handle to its ring
+ *
+ * @param p pointer to the producer handle
+ * @return EMB_RB_ERR_OK if everything was published, EMB_RB_ERR_LOCK or EMB_RB_ERR_BUFFER_FULL if bytes are still staged
+ */
+int emb_rb_producer_flush(emb_rb_producer_t *p);
+
+/**
+ * @brief Slow path of emb_rb_producer_put, publishes and drops the byte that was just stored if the
+ * staging buffer is still over full. After a short publish the next attempt waits until the staging
+ * buffer is full, or for an explicit emb_rb_producer_flush.
+ *
+ * @param p pointer to the producer handle
+ * @return uint8_t 1 if the byte was kept, 0 if not
+ */
+uint8_t emb_rb_producer_put_slow(emb_rb_producer_t *p);
+
+/**
+ * @brief Put a single byte through a producer handle, the common case is a store and a compare
+ *
+ * @param p pointer to the producer handle
+ * @param byte the byte we want to queue
+ * @return uint8_t 1 if the byte was staged, 0 if the staging buffer is full and could not be published
+ */
+static inline uint8_t emb_rb_producer_put(emb_rb_producer_t *p, uint8_t byte)
+{
+   p->buf[p->n] = byte;
+   if (++p->n < p->trigger)
+   {
+      return(1);
+   }
+   return(emb_rb_producer_put_slow(p));
+}
+
+/**
+ * @brief Typed integer getters, read a little (le) or big (be) endian integer at position without
+ * dequeuing. Values that do not straddle the wrap are loaded straight from ring storage.
+ *
+ * @param rb pointer to the ring buffer
+ * @param position offset from the tail of the first byte of the value
+ * @param v pointer to where the value is stored
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_BUFFER_EMPTY if fewer bytes are queued, negative error code on failure
+ */
+int emb_rb_get_u16le(emb_rb_t *rb, uint64_t position, uint16_t *v);
+int emb_rb_get_u16be(emb_rb_t *rb, uint64_t position, uint16_t *v);
+int emb_rb_get_u32le(emb_rb_t *rb, uint64_t position, uint32_t *v);
+int emb_rb_get_u32be(emb_rb_t *rb, uint64_t position, uint32_t *v);
+int emb_rb_get_u64le(emb_rb_t *rb, uint64_t position, uint64_t *v);
+int emb_rb_get_u64be(emb_rb_t *rb, uint64_t position, uint64_t *v);
+
+/**
+ * @brief Typed integer setters, overwrite queued bytes at position with a little (le) or big (be)
+ * endian integer, e.g. to patch a length field after the payload was queued
+ *
+ * @param rb pointer to the ring buffer
+ * @param position offset from the tail of the first byte of the value
+ * @param v the value we want to write
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_BUFFER_EMPTY if fewer bytes are queued, negative error code on failure
+ */
+int emb_rb_put_u16le(emb_rb_t *rb, uint64_t position, uint16_t v);
+int emb_rb_put_u16be(emb_rb_t *rb, uint64_t position, uint16_t v);
+int emb_rb_put_u32le(emb_rb_t *rb, uint64_t position, uint32_t v);
+int emb_rb_put_u32be(emb_rb_t *rb, uint64_t position, uint32_t v);
+int emb_rb_put_u64le(emb_rb_t *rb, uint64_t position, uint64_t v);
+int emb_rb_put_u64be(emb_rb_t *rb, uint64_t position, uint64_t v);
+
+/**
+ * @brief Decode an unsigned LEB128 varint at position without dequeuing
+ *
+ * @param rb pointer to the ring buffer
+ * @param position offset from the tail of the first byte of the varint
+ * @param v pointer to where the value is stored
+ * @param len pointer to where the encoded length is stored, can be NULL
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_BUFFER_EMPTY if the varint is incomplete,
+ * EMB_RB_ERR_ILLEGAL_ARGS if it is longer than EMB_RB_VARINT_MAX bytes or does not fit in 64 bits
+ */
+int emb_rb_get_varint(emb_rb_t *rb, uint64_t position, uint64_t *v, uint32_t *len);
+
+/**
+ * @brief Encode an unsigned LEB128 varint over the queued bytes at position
+ *
+ * @param rb pointer to the ring buffer
+ * @param position offset from the tail of the first byte of the varint
+ * @param v the value we want to write
+ * @param len pointer to where the encoded length is stored, can be NULL
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_BUFFER_EMPTY if fewer bytes are queued, negative error code on failure
+ */
+int emb_rb_put_varint(emb_rb_t *rb, uint64_t position, uint64_t v, uint32_t *len);
+
+/**
+ * @brief Pin the readable region of the ring for incremental parsing. The lock is taken once here and
+ * once on commit, reads in between do not lock. Producers never touch pinned bytes, if another
+ * consumer moves the tail or the bytes are rewritten in place (insert, remove, put) in the meantime
+ * the commit fails with EMB_RB_ERR_STALE and the parse must be redone. Elastic rings are not supported since a grow can move the storage under the cursor.
+ *
+ * @param c pointer to the cursor
+ * @param rb pointer to the ring buffer
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_cursor_begin(emb_rb_cursor_t *c, emb_rb_t *rb);
+
+/**
+ * @brief Read a single byte through the cursor
+ *
+ * @param c pointer to the cursor
+ * @param byte pointer to where the byte is stored
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_BUFFER_EMPTY if the pinned region is used up,
+ * EMB_RB_ERR_ILLEGAL_ARGS once the cursor was committed or aborted
+ */
+static inline int emb_rb_cursor_read_u8(emb_rb_cursor_t *c, uint8_t *byte)
+{
+   if (!c->rb)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   if (c->pos == c->avail)
+   {
+      return(EMB_RB_ERR_BUFFER_EMPTY);
+   }
+   *byte = c->bP[c->idx];
+   if (++c->idx == c->size)
+   {
+      c->idx = 0;
+   }
+   c->pos++;
+   return(EMB_RB_ERR_OK);
+}
+
+/**
+ * @brief Read up to len bytes through the cursor
+ *
+ * @param c pointer to the cursor
+ * @param bytes pointer to the destination buffer
+ * @param len number of bytes we want to read
+ * @return uint64_t number of bytes read
+ */
+uint64_t emb_rb_cursor_read_bytes(emb_rb_cursor_t *c, uint8_t *bytes, uint64_t len);
+
+/**
+ * @brief Skip up to len bytes through the cursor
+ *
+ * @param c pointer to the cursor
+ * @param len number of bytes we want to skip
+ * @return uint64_t number of bytes skipped
+ */
+uint64_t emb_rb_cursor_skip(emb_rb_cursor_t *c, uint64_t len);
+
+/**
+ * @brief Get the number of pinned bytes the cursor has not read yet
+ *
+ * @param c pointer to the cursor
+ * @return uint64_t number of bytes left
+ */
+uint64_t emb_rb_cursor_remaining(const emb_rb_cursor_t *c);
+
+/**
+ * @brief Commit the cursor, advancing the tail by the bytes consumed
+ *
+ * @param c pointer to the cursor
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_STALE if the tail moved or the bytes were rewritten since begin
+ */
+int emb_rb_cursor_commit(emb_rb_cursor_t *c);
+
+/**
+ * @brief Abort the cursor, the data is left in place
+ *
+ * @param c pointer to the cursor
+ */
+void emb_rb_cursor_abort(emb_rb_cursor_t *c);
+
 /**
  * @brief Get the version of the library
  *
@@ -181,4 +888,9 @@ void emb_rb_destroy(emb_rb_t *rb);
 }
 #endif
 
+// Optional header only build of the hot paths
+#ifdef EMB_RB_INLINE
+#include "emb_rb_inline.h"
+#endif
+
 #endif /* EMB_RB_H_ */
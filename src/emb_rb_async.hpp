@@ -0,0 +1,267 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_ASYNC_HPP_
+#define EMB_RB_ASYNC_HPP_
+
+// C++20 coroutine adapter, co_await ring.read(buf, n) and co_await ring.write(span) suspend while the
+// ring is empty / full and are resumed by the other side. Waiters live in the awaiting coroutine's
+// frame and are linked into a lock free intrusive list, so an await never allocates.
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include "emb_rb.h"
+
+// Where resumed coroutines run, by default inline on the thread that made them runnable. Inline
+// resumes nest: the resumed coroutine runs on top of the read / write that woke it, and if it wakes
+// the other side in turn the stack keeps growing for as long as the two hand off without suspending
+// on their own. Set post to a run queue for coroutines that ping-pong like that.
+struct emb_rb_executor
+{
+   void (*post)(void *ctx, std::coroutine_handle<> h) = nullptr;
+   void *ctx                                          = nullptr;
+};
+
+class emb_rb_async
+{
+public:
+   // Intrusive waiter, embedded in every awaitable
+   struct waiter
+   {
+      waiter *                next = nullptr;
+      std::coroutine_handle<> h;
+   };
+
+   // Suspends while the ring is empty, resumes with the number of bytes read. 0 means the ring was
+   // closed, or another reader took the data first, so loop until you get what you need.
+   class read_awaitable : waiter
+   {
+   public:
+      read_awaitable(emb_rb_async &ring, uint8_t *buf, uint64_t len) : ring_(ring), buf_(buf), len_(len)
+      {
+      }
+
+      bool await_ready()
+      {
+         n_ = ring_.try_read(buf_, len_);
+         return(n_ || ring_.closed());
+      }
+
+      void await_suspend(std::coroutine_handle<> h)
+      {
+         this->h = h;
+         ring_.park(ring_.readers_, this, &emb_rb_async::readable);
+      }
+
+      uint64_t await_resume()
+      {
+         return(n_ ? n_ : ring_.try_read(buf_, len_));
+      }
+
+   private:
+      emb_rb_async &ring_;
+      uint8_t *     buf_;
+      uint64_t      len_;
+      uint64_t      n_ = 0;
+   };
+
+   // Suspends while the ring is full, resumes with the number of bytes written, same rules as reads
+   class write_awaitable : waiter
+   {
+   public:
+      write_awaitable(emb_rb_async &ring, std::span<const uint8_t> data) : ring_(ring), data_(data)
+      {
+      }
+
+      bool await_ready()
+      {
+         n_ = ring_.closed() ? 0 : ring_.try_write(data_);
+         return(n_ || data_.empty() || ring_.closed());
+      }
+
+      void await_suspend(std::coroutine_handle<> h)
+      {
+         this->h = h;
+         ring_.park(ring_.writers_, this, &emb_rb_async::writable);
+      }
+
+      uint64_t await_resume()
+      {
+         return(n_ || ring_.closed() ? n_ : ring_.try_write(data_));
+      }
+
+   private:
+      emb_rb_async &           ring_;
+      std::span<const uint8_t> data_;
+      uint64_t                 n_ = 0;
+   };
+
+   explicit emb_rb_async(emb_rb_t *rb, emb_rb_executor ex = {}) : rb_(rb), ex_(ex)
+   {
+   }
+
+   emb_rb_async(const emb_rb_async &) = delete;
+   emb_rb_async &operator=(const emb_rb_async &) = delete;
+
+   read_awaitable read(uint8_t *buf, uint64_t len)
+   {
+      return(read_awaitable(*this, buf, len));
+   }
+
+   write_awaitable write(std::span<const uint8_t> data)
+   {
+      return(write_awaitable(*this, data));
+   }
+
+   // Resume waiting readers, for producers that queue with the C API
+   void wake_readers()
+   {
+      wake(readers_);
+   }
+
+   // Resume waiting writers, for consumers that dequeue with the C API
+   void wake_writers()
+   {
+      wake(writers_);
+   }
+
+   // Resume everyone, reads then complete with 0 once the ring is drained and writes with 0 right away
+   void close()
+   {
+      closed_.store(true, std::memory_order_seq_cst);
+      wake(readers_);
+      wake(writers_);
+   }
+
+   bool closed() const
+   {
+      return(closed_.load(std::memory_order_acquire));
+   }
+
+   emb_rb_t *ring() const
+   {
+      return(rb_);
+   }
+
+private:
+   // emb_rb_queue / emb_rb_dequeue only try the lock once, contention is not an empty or full ring
+   uint64_t try_read(uint8_t *buf, uint64_t len)
+   {
+      int      err;
+      uint64_t n;
+      while (!(n = emb_rb_dequeue64(rb_, buf, len, &err)) && err == EMB_RB_ERR_LOCK)
+      {
+         std::this_thread::yield();
+      }
+      if (n)
+      {
+         wake(writers_);
+      }
+      return(n);
+   }
+
+   uint64_t try_write(std::span<const uint8_t> data)
+   {
+      int      err;
+      uint64_t n;
+      if (data.empty())
+      {
+         return(0);
+      }
+      while (!(n = emb_rb_queue64(rb_, data.data(), data.size(), &err)) && err == EMB_RB_ERR_LOCK)
+      {
+         std::this_thread::yield();
+      }
+      if (n)
+      {
+         wake(readers_);
+      }
+      return(n);
+   }
+
+   static bool readable(emb_rb_async &ring)
+   {
+      return(emb_rb_used_space64(ring.rb_) || ring.closed());
+   }
+
+   static bool writable(emb_rb_async &ring)
+   {
+      return(emb_rb_free_space64(ring.rb_) || ring.closed());
+   }
+
+   // Push w onto the list, then check again in case the other side made progress before it could see
+   // us. Once w is published another thread may resume its coroutine and free the frame, so past the
+   // push only the ring is touched, and a late wake goes to the whole list, us included.
+   void park(std::atomic<waiter *> &list, waiter *w, bool (*ready)(emb_rb_async &))
+   {
+      w->next = list.load(std::memory_order_relaxed);
+      while (!list.compare_exchange_weak(w->next, w, std::memory_order_acq_rel, std::memory_order_relaxed))
+      {
+      }
+      // Pairs with the fence in wake, the push has to be visible before the ring is read again or
+      // both sides can miss each other. The ring lock does not help, EMB_RB_LOCK_NONE has none.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready(*this))
+      {
+         wake(list);
+      }
+   }
+
+   void wake(std::atomic<waiter *> &list)
+   {
+      // Orders the caller's queue / dequeue before the list load, pairing with the fence in park.
+      // After it the common no waiter case is a single load.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (list.load(std::memory_order_acquire))
+      {
+         resume_all(list.exchange(nullptr, std::memory_order_acq_rel));
+      }
+   }
+
+   // Resume every waiter, next is read first since a resumed frame may be gone right after
+   void resume_all(waiter *w)
+   {
+      while (w)
+      {
+         waiter *next = w->next;
+         if (ex_.post)
+         {
+            ex_.post(ex_.ctx, w->h);
+         }
+         else
+         {
+            w->h.resume();
+         }
+         w = next;
+      }
+   }
+
+   emb_rb_t *            rb_;
+   emb_rb_executor       ex_;
+   std::atomic<waiter *> readers_{ nullptr };
+   std::atomic<waiter *> writers_{ nullptr };
+   std::atomic<bool>     closed_{ false };
+};
+
+#endif /* EMB_RB_ASYNC_HPP_ */
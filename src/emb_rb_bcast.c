@@ -0,0 +1,309 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_bcast.h"
+#include "emb_rb_copy.h"
+#include <stdint.h>
+#include <string.h>
+
+// Internal helper methods, the producer side ones are called with bc->lock held
+
+// Position of the slowest active consumer, the head if there is none
+static uint64_t _internal_emb_rb_bcast_min(emb_rb_bcast_t *bc)
+{
+   uint64_t lag = 0;
+
+   for (int i = 0; i < EMB_RB_BCAST_MAX_CONSUMERS; i++)
+   {
+      emb_rb_bcast_cursor_t *cur = &bc->cursors[i];
+      if (__atomic_load_n(&cur->state, __ATOMIC_ACQUIRE) == EMB_RB_BCAST_ACTIVE)
+      {
+         uint64_t pos = __atomic_load_n(&cur->pos, __ATOMIC_ACQUIRE);
+         if (bc->rb.head - pos > lag)
+         {
+            lag = bc->rb.head - pos;
+         }
+      }
+   }
+   return(bc->rb.head - lag);
+}
+
+// Drop every consumer sitting at min, returns the new minimum
+static uint64_t _internal_emb_rb_bcast_drop(emb_rb_bcast_t *bc, uint64_t min)
+{
+   for (int i = 0; i < EMB_RB_BCAST_MAX_CONSUMERS; i++)
+   {
+      emb_rb_bcast_cursor_t *cur    = &bc->cursors[i];
+      uint8_t                active = EMB_RB_BCAST_ACTIVE;
+      if (__atomic_load_n(&cur->state, __ATOMIC_ACQUIRE) == EMB_RB_BCAST_ACTIVE &&
+          __atomic_load_n(&cur->pos, __ATOMIC_ACQUIRE) == min &&
+          __atomic_compare_exchange_n(&cur->state, &active, EMB_RB_BCAST_DROPPED, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+      {
+         bc->drops++;
+      }
+   }
+   // Pairs with the fence in _internal_emb_rb_bcast_valid, a consumer that copied bytes we are about
+   // to overwrite sees that it was dropped
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   return(_internal_emb_rb_bcast_min(bc));
+}
+
+// Check the consumer id, returns the cursor or NULL
+static inline emb_rb_bcast_cursor_t *_internal_emb_rb_bcast_cursor(emb_rb_bcast_t *bc, int id)
+{
+   if (id < 0 || id >= EMB_RB_BCAST_MAX_CONSUMERS)
+   {
+      return(NULL);
+   }
+   return(&bc->cursors[id]);
+}
+
+// After a consumer copy, make sure the producer did not drop the cursor and reuse the bytes meanwhile
+static inline int _internal_emb_rb_bcast_valid(emb_rb_bcast_cursor_t *cur)
+{
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   return(__atomic_load_n(&cur->state, __ATOMIC_RELAXED) == EMB_RB_BCAST_ACTIVE);
+}
+
+// Initialize the broadcast ring
+int emb_rb_bcast_init(emb_rb_bcast_t *bc, uint8_t *bP, uint64_t size, uint8_t drop_slow)
+{
+   // Null check
+   if (!bc || !bP || !size || size > EMB_RB_MAX_SIZE)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   memset(bc, 0, sizeof(*bc));
+   // The broadcast lock already covers the producer
+   emb_rb_lock_cfg_t none = { EMB_RB_LOCK_NONE, 0, NULL, NULL, NULL, NULL, 0, 0 };
+   int               rtn  = emb_rb_init_ex(&bc->rb, bP, size, &none);
+   if (rtn != EMB_RB_ERR_OK)
+   {
+      return(rtn);
+   }
+   bc->drop_slow = drop_slow;
+   if (pthread_mutex_init(&bc->lock, NULL) != 0)
+   {
+      emb_rb_destroy(&bc->rb);
+      return(EMB_RB_ERR_LOCK);
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Register a consumer at the current head
+int emb_rb_bcast_add_consumer(emb_rb_bcast_t *bc)
+{
+   // Null check
+   if (!bc)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   int id = EMB_RB_ERR_NO_MEM;
+   pthread_mutex_lock(&bc->lock);
+   for (int i = 0; i < EMB_RB_BCAST_MAX_CONSUMERS; i++)
+   {
+      emb_rb_bcast_cursor_t *cur = &bc->cursors[i];
+      if (cur->state == EMB_RB_BCAST_FREE)
+      {
+         cur->pos = bc->rb.head;
+         cur->idx = bc->rb.head_idx;
+         __atomic_store_n(&cur->state, EMB_RB_BCAST_ACTIVE, __ATOMIC_RELEASE);
+         id = i;
+         break;
+      }
+   }
+   pthread_mutex_unlock(&bc->lock);
+   return(id);
+}
+
+// Unregister a consumer
+int emb_rb_bcast_remove_consumer(emb_rb_bcast_t *bc, int id)
+{
+   // Null check
+   if (!bc || !_internal_emb_rb_bcast_cursor(bc, id))
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   pthread_mutex_lock(&bc->lock);
+   __atomic_store_n(&bc->cursors[id].state, EMB_RB_BCAST_FREE, __ATOMIC_RELEASE);
+   pthread_mutex_unlock(&bc->lock);
+   return(EMB_RB_ERR_OK);
+}
+
+// Queue len number of bytes for all consumers
+uint32_t emb_rb_bcast_queue(emb_rb_bcast_t *bc, const uint8_t *bytes, uint32_t len, int *err)
+{
+   // Null check
+   if (!bc || !bytes || !len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   // Lock the producer side
+   if (pthread_mutex_trylock(&bc->lock) != 0)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   if (len > bc->rb.size)
+   {
+      len = (uint32_t)bc->rb.size;
+   }
+   // Drop whoever is holding the oldest bytes until the write fits
+   uint64_t min = _internal_emb_rb_bcast_min(bc);
+   while (bc->drop_slow && len > bc->rb.size - (bc->rb.head - min))
+   {
+      min = _internal_emb_rb_bcast_drop(bc, min);
+   }
+   uint64_t space = bc->rb.size - (bc->rb.head - min);
+   if (len > space)
+   {
+      len = (uint32_t)space;
+   }
+   // Single copy, then publish the head to the consumers
+   _internal_emb_rb_write(&bc->rb, bc->rb.head_idx, bytes, len);
+   bc->rb.head_idx = _internal_emb_rb_advance(&bc->rb, bc->rb.head_idx, len);
+   __atomic_store_n(&bc->rb.head, bc->rb.head + len, __ATOMIC_RELEASE);
+   // Unlock the producer side
+   pthread_mutex_unlock(&bc->lock);
+
+   if (err)
+   {
+      *err = len ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_FULL;
+   }
+   return(len);
+}
+
+// Dequeue len number of bytes through a consumer cursor, no lock, only the cursor is published
+uint32_t emb_rb_bcast_dequeue(emb_rb_bcast_t *bc, int id, uint8_t *bytes, uint32_t len, int *err)
+{
+   emb_rb_bcast_cursor_t *cur = bc ? _internal_emb_rb_bcast_cursor(bc, id) : NULL;
+
+   // Null check
+   if (!cur || !bytes || !len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   uint8_t state = __atomic_load_n(&cur->state, __ATOMIC_ACQUIRE);
+   if (state != EMB_RB_BCAST_ACTIVE)
+   {
+      if (err)
+      {
+         *err = state == EMB_RB_BCAST_DROPPED ? EMB_RB_ERR_DROPPED : EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   uint64_t pos  = __atomic_load_n(&cur->pos, __ATOMIC_RELAXED);
+   uint64_t used = __atomic_load_n(&bc->rb.head, __ATOMIC_ACQUIRE) - pos;
+   if (len > used)
+   {
+      len = (uint32_t)used;
+   }
+   _internal_emb_rb_read(&bc->rb, cur->idx, bytes, len);
+   if (!_internal_emb_rb_bcast_valid(cur))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_DROPPED;
+      }
+      return(0);
+   }
+   cur->idx = _internal_emb_rb_advance(&bc->rb, cur->idx, len);
+   __atomic_store_n(&cur->pos, pos + len, __ATOMIC_RELEASE);
+
+   if (err)
+   {
+      *err = len ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_EMPTY;
+   }
+   return(len);
+}
+
+// Peek through a consumer cursor
+uint32_t emb_rb_bcast_peek(emb_rb_bcast_t *bc, int id, uint32_t position, uint8_t *bytes, uint32_t len)
+{
+   emb_rb_bcast_cursor_t *cur = bc ? _internal_emb_rb_bcast_cursor(bc, id) : NULL;
+
+   // Null check
+   if (!cur || !bytes || !len || __atomic_load_n(&cur->state, __ATOMIC_ACQUIRE) != EMB_RB_BCAST_ACTIVE)
+   {
+      return(0);
+   }
+   uint64_t used = __atomic_load_n(&bc->rb.head, __ATOMIC_ACQUIRE) - __atomic_load_n(&cur->pos, __ATOMIC_RELAXED);
+   if (position > used)
+   {
+      return(0);
+   }
+   if (len > used - position)
+   {
+      len = (uint32_t)(used - position);
+   }
+   _internal_emb_rb_read(&bc->rb, _internal_emb_rb_advance(&bc->rb, cur->idx, position), bytes, len);
+   return(_internal_emb_rb_bcast_valid(cur) ? len : 0);
+}
+
+// Get the number of bytes a consumer has left to read
+uint64_t emb_rb_bcast_used_space(emb_rb_bcast_t *bc, int id)
+{
+   emb_rb_bcast_cursor_t *cur = bc ? _internal_emb_rb_bcast_cursor(bc, id) : NULL;
+
+   // Null check
+   if (!cur || __atomic_load_n(&cur->state, __ATOMIC_ACQUIRE) != EMB_RB_BCAST_ACTIVE)
+   {
+      return(0);
+   }
+   return(__atomic_load_n(&bc->rb.head, __ATOMIC_ACQUIRE) - __atomic_load_n(&cur->pos, __ATOMIC_ACQUIRE));
+}
+
+// Get the free space for the producer
+uint64_t emb_rb_bcast_free_space(emb_rb_bcast_t *bc)
+{
+   // Null check
+   if (!bc)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&bc->lock);
+   uint64_t ret = bc->rb.size - (bc->rb.head - _internal_emb_rb_bcast_min(bc));
+   pthread_mutex_unlock(&bc->lock);
+   return(ret);
+}
+
+// Destroy the broadcast ring
+void emb_rb_bcast_destroy(emb_rb_bcast_t *bc)
+{
+   // Null check
+   if (!bc)
+   {
+      return;
+   }
+   pthread_mutex_destroy(&bc->lock);
+   emb_rb_destroy(&bc->rb);
+}
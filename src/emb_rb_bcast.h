@@ -0,0 +1,160 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_BCAST_H_
+#define EMB_RB_BCAST_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "emb_rb.h"
+
+#define EMB_RB_BCAST_MAX_CONSUMERS    8
+// Cursors sit on their own cache line so consumers do not invalidate each other
+#define EMB_RB_BCAST_CACHE_LINE       64
+
+// Cursor states
+#define EMB_RB_BCAST_FREE             0
+#define EMB_RB_BCAST_ACTIVE           1
+#define EMB_RB_BCAST_DROPPED          2
+
+// Consumer read cursor. pos is a free running byte count like emb_rb_t.tail, the consumer publishes it
+// with a release store and the producer gates on the slowest one. idx is where it sits in the storage,
+// only the consumer touches it.
+typedef struct
+{
+   uint64_t pos, idx;
+   uint8_t  state;
+} __attribute__((aligned(EMB_RB_BCAST_CACHE_LINE))) emb_rb_bcast_cursor_t;
+
+// rb holds the storage and the producer's head, its tail is unused. lock serializes the producer with
+// consumer registration, consumers never take it.
+typedef struct
+{
+   emb_rb_t              rb;
+   emb_rb_bcast_cursor_t cursors[EMB_RB_BCAST_MAX_CONSUMERS];
+   uint8_t               drop_slow;
+   uint32_t              drops;
+   pthread_mutex_t       lock;
+} emb_rb_bcast_t;
+
+/**
+ * @brief Initialize a broadcast ring, one producer writes once and every registered consumer reads
+ * the same bytes through its own cursor. Consumers never lock or wait on each other, each one only
+ * publishes its cursor, and space is reclaimed once the slowest cursor has passed it. Every consumer
+ * id is meant to be used by one thread at a time.
+ *
+ * @param bc pointer to the broadcast ring we want to initialize
+ * @param bP pointer to the buffer we want to use
+ * @param size size of the buffer we want to use
+ * @param drop_slow 1 to drop the slowest consumers when the producer runs out of space, 0 to report full
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_bcast_init(emb_rb_bcast_t *bc, uint8_t *bP, uint64_t size, uint8_t drop_slow);
+
+/**
+ * @brief Register a consumer, it starts reading at the current head. Slots of dropped consumers are
+ * only handed out again after emb_rb_bcast_remove_consumer.
+ *
+ * @param bc pointer to the broadcast ring
+ * @return int consumer id on success, negative error code on failure
+ */
+int emb_rb_bcast_add_consumer(emb_rb_bcast_t *bc);
+
+/**
+ * @brief Unregister a consumer, including one that was dropped, which frees its slot for reuse
+ *
+ * @param bc pointer to the broadcast ring
+ * @param id consumer id returned by emb_rb_bcast_add_consumer
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_bcast_remove_consumer(emb_rb_bcast_t *bc, int id);
+
+/**
+ * @brief Queue len number of bytes for every consumer, making a single deep copy
+ *
+ * @param bc pointer to the broadcast ring we want to queue bytes into
+ * @param bytes pointer to the bytes we want to queue
+ * @param len number of bytes we want to queue
+ * @param err pointer to the error code, can be NULL
+ * @return uint32_t number of bytes queued
+ */
+uint32_t emb_rb_bcast_queue(emb_rb_bcast_t *bc, const uint8_t *bytes, uint32_t len, int *err);
+
+/**
+ * @brief Dequeue len number of bytes through a consumer cursor
+ *
+ * @param bc pointer to the broadcast ring we want to dequeue bytes from
+ * @param id consumer id
+ * @param bytes pointer to the bytes we want to dequeue
+ * @param len number of bytes we want to dequeue
+ * @param err pointer to the error code, can be NULL, EMB_RB_ERR_DROPPED if the consumer fell too far behind,
+ * it stays dropped until emb_rb_bcast_remove_consumer
+ * @return uint32_t number of bytes dequeued
+ */
+uint32_t emb_rb_bcast_dequeue(emb_rb_bcast_t *bc, int id, uint8_t *bytes, uint32_t len, int *err);
+
+/**
+ * @brief Peek len number of bytes through a consumer cursor without moving it
+ *
+ * @param bc pointer to the broadcast ring we want to peek bytes from
+ * @param id consumer id
+ * @param position the position offset from the cursor we want to peek bytes
+ * @param bytes pointer to the bytes we want to peek
+ * @param len number of bytes we want to peek
+ * @return uint32_t number of bytes peeked
+ */
+uint32_t emb_rb_bcast_peek(emb_rb_bcast_t *bc, int id, uint32_t position, uint8_t *bytes, uint32_t len);
+
+/**
+ * @brief Get the number of bytes a consumer has left to read
+ *
+ * @param bc pointer to the broadcast ring
+ * @param id consumer id
+ * @return uint64_t used space for the consumer in bytes
+ */
+uint64_t emb_rb_bcast_used_space(emb_rb_bcast_t *bc, int id);
+
+/**
+ * @brief Get the free space for the producer, bounded by the slowest consumer
+ *
+ * @param bc pointer to the broadcast ring
+ * @return uint64_t free space in bytes
+ */
+uint64_t emb_rb_bcast_free_space(emb_rb_bcast_t *bc);
+
+/**
+ * @brief Destroy the broadcast ring
+ *
+ * @param bc pointer to the broadcast ring we want to destroy
+ */
+void emb_rb_bcast_destroy(emb_rb_bcast_t *bc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_BCAST_H_ */
@@ -0,0 +1,69 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_COPY_H_
+#define EMB_RB_COPY_H_
+
+// Wrap around copy helpers over a ring's storage, shared by emb_rb.c and the modules that keep their
+// own cursors on top of an emb_rb_t
+
+#include <stdint.h>
+#include <string.h>
+#include "emb_rb.h"
+
+// Move a physical index forward by n bytes, n <= size
+static inline uint64_t _internal_emb_rb_advance(emb_rb_t *rb, uint64_t idx, uint64_t n)
+{
+   idx += n;
+   return(idx >= rb->size ? idx - rb->size : idx);
+}
+
+// Copy n bytes into the ring starting at physical index idx, handling the wrap around
+static inline void _internal_emb_rb_write(emb_rb_t *rb, uint64_t idx, const uint8_t *bytes, uint64_t n)
+{
+   uint64_t len_till_wrap = rb->size - idx;
+
+   if (n > len_till_wrap)
+   {
+      memcpy(rb->bP + idx, bytes, len_till_wrap);
+      bytes += len_till_wrap;
+      n     -= len_till_wrap;
+      idx    = 0;
+   }
+   memcpy(rb->bP + idx, bytes, n);
+}
+
+// Copy n bytes out of the ring starting at physical index idx, handling the wrap around
+static inline void _internal_emb_rb_read(emb_rb_t *rb, uint64_t idx, uint8_t *bytes, uint64_t n)
+{
+   uint64_t len_till_wrap = rb->size - idx;
+
+   if (n > len_till_wrap)
+   {
+      memcpy(bytes, rb->bP + idx, len_till_wrap);
+      bytes += len_till_wrap;
+      n     -= len_till_wrap;
+      idx    = 0;
+   }
+   memcpy(bytes, rb->bP + idx, n);
+}
+
+#endif /* EMB_RB_COPY_H_ */
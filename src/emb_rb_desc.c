@@ -0,0 +1,269 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_desc.h"
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+// Initialize the descriptor ring
+int emb_rb_desc_init(emb_rb_desc_ring_t *dr, emb_rb_desc_t *slots, uint32_t count)
+{
+   // Null check
+   if (!dr || !slots || !count)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   memset(dr, 0, sizeof(*dr));
+   dr->slots = slots;
+   dr->count = count;
+   if (pthread_mutex_init(&dr->lock, NULL) != 0)
+   {
+      return(EMB_RB_ERR_LOCK);
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Queue a caller buffer by reference
+int emb_rb_desc_push(emb_rb_desc_ring_t *dr, const uint8_t *ptr, uint64_t len, emb_rb_desc_release_t release, void *ctx)
+{
+   // Null check
+   if (!dr || (!ptr && len))
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   pthread_mutex_lock(&dr->lock);
+   if (dr->head - dr->tail == dr->count)
+   {
+      pthread_mutex_unlock(&dr->lock);
+      return(EMB_RB_ERR_BUFFER_FULL);
+   }
+   emb_rb_desc_t *d = &dr->slots[dr->head % dr->count];
+   d->ptr     = ptr;
+   d->len     = len;
+   d->release = release;
+   d->ctx     = ctx;
+   dr->head++;
+   dr->bytes += len;
+   pthread_mutex_unlock(&dr->lock);
+   return(EMB_RB_ERR_OK);
+}
+
+// Hand up to max descriptors to the caller
+uint32_t emb_rb_desc_pop_n(emb_rb_desc_ring_t *dr, emb_rb_desc_t *descs, uint32_t max, uint64_t *offset)
+{
+   uint32_t n = 0;
+
+   // Null check
+   if (!dr || !descs)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&dr->lock);
+   if (offset)
+   {
+      *offset = dr->offset;
+   }
+   while (n < max && dr->tail != dr->head)
+   {
+      descs[n] = dr->slots[dr->tail % dr->count];
+      dr->bytes -= descs[n].len - (n ? 0 : dr->offset);
+      dr->tail++;
+      n++;
+   }
+   if (n)
+   {
+      dr->offset = 0;
+   }
+   pthread_mutex_unlock(&dr->lock);
+   return(n);
+}
+
+// Run the release callbacks of a batch of descriptors
+void emb_rb_desc_release(const emb_rb_desc_t *descs, uint32_t n)
+{
+   // Null check
+   if (!descs)
+   {
+      return;
+   }
+   for (uint32_t i = 0; i < n; i++)
+   {
+      if (descs[i].release)
+      {
+         descs[i].release(descs[i].ctx, descs[i].ptr, descs[i].len);
+      }
+   }
+}
+
+// Describe the pending bytes as a scatter list
+uint32_t emb_rb_desc_iov(emb_rb_desc_ring_t *dr, struct iovec *iov, uint32_t max)
+{
+   uint32_t n = 0;
+
+   // Null check
+   if (!dr || !iov)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&dr->lock);
+   uint64_t off = dr->offset;
+   for (uint64_t pos = dr->tail; pos != dr->head && n < max; pos++)
+   {
+      emb_rb_desc_t *d = &dr->slots[pos % dr->count];
+      if (d->len > off)
+      {
+         iov[n].iov_base = (void *)(d->ptr + off);
+         iov[n].iov_len  = (size_t)(d->len - off);
+         n++;
+      }
+      off = 0;
+   }
+   pthread_mutex_unlock(&dr->lock);
+   return(n);
+}
+
+// Consume bytes from the tail, completed descriptors are collected under the lock and released after it
+uint64_t emb_rb_desc_consume(emb_rb_desc_ring_t *dr, uint64_t len)
+{
+   emb_rb_desc_t done[EMB_RB_DESC_BATCH_MAX];
+   uint64_t      total = 0;
+   uint8_t       more;
+
+   // Null check
+   if (!dr)
+   {
+      return(0);
+   }
+   do
+   {
+      uint32_t n = 0;
+      pthread_mutex_lock(&dr->lock);
+      while (dr->tail != dr->head && n < EMB_RB_DESC_BATCH_MAX)
+      {
+         emb_rb_desc_t *d    = &dr->slots[dr->tail % dr->count];
+         uint64_t       left = d->len - dr->offset;
+         if (len < left)
+         {
+            dr->offset += len;
+            dr->bytes  -= len;
+            total      += len;
+            len         = 0;
+            break;
+         }
+         len        -= left;
+         total      += left;
+         dr->bytes  -= left;
+         dr->offset  = 0;
+         done[n++]   = *d;
+         dr->tail++;
+      }
+      more = len && dr->tail != dr->head;
+      pthread_mutex_unlock(&dr->lock);
+      emb_rb_desc_release(done, n);
+   } while (more);
+   return(total);
+}
+
+// Write the pending bytes to fd straight from the caller buffers
+uint64_t emb_rb_desc_write_fd(emb_rb_desc_ring_t *dr, int fd, int *err)
+{
+   struct iovec iov[EMB_RB_DESC_IOV_MAX];
+
+   // Null check
+   if (!dr || fd < 0)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   uint32_t n = emb_rb_desc_iov(dr, iov, EMB_RB_DESC_IOV_MAX);
+   if (!n)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_BUFFER_EMPTY;
+      }
+      return(0);
+   }
+   ssize_t written = writev(fd, iov, (int)n);
+   if (written < 0)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_IO;
+      }
+      return(0);
+   }
+   if (err)
+   {
+      *err = EMB_RB_ERR_OK;
+   }
+   return(emb_rb_desc_consume(dr, (uint64_t)written));
+}
+
+// Get the number of queued descriptors
+uint32_t emb_rb_desc_used(emb_rb_desc_ring_t *dr)
+{
+   // Null check
+   if (!dr)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&dr->lock);
+   uint32_t used = (uint32_t)(dr->head - dr->tail);
+   pthread_mutex_unlock(&dr->lock);
+   return(used);
+}
+
+// Get the number of pending payload bytes
+uint64_t emb_rb_desc_bytes(emb_rb_desc_ring_t *dr)
+{
+   // Null check
+   if (!dr)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&dr->lock);
+   uint64_t bytes = dr->bytes;
+   pthread_mutex_unlock(&dr->lock);
+   return(bytes);
+}
+
+// Destroy the descriptor ring, pending buffers go back to their owners
+void emb_rb_desc_destroy(emb_rb_desc_ring_t *dr)
+{
+   emb_rb_desc_t done[EMB_RB_DESC_BATCH_MAX];
+   uint32_t      n;
+
+   // Null check
+   if (!dr)
+   {
+      return;
+   }
+   while ((n = emb_rb_desc_pop_n(dr, done, EMB_RB_DESC_BATCH_MAX, NULL)) > 0)
+   {
+      emb_rb_desc_release(done, n);
+   }
+   pthread_mutex_destroy(&dr->lock);
+}
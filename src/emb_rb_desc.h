@@ -0,0 +1,166 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_DESC_H_
+#define EMB_RB_DESC_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "emb_rb.h"
+
+// Most iovecs handed to a single writev by emb_rb_desc_write_fd
+#define EMB_RB_DESC_IOV_MAX      64
+
+// Most descriptors released per batch, releases run outside the lock
+#define EMB_RB_DESC_BATCH_MAX    32
+
+// Called once the consumer is done with a buffer, ownership goes back to whoever ctx belongs to
+typedef void (*emb_rb_desc_release_t)(void *ctx, const uint8_t *ptr, uint64_t len);
+
+// A queued caller buffer, the bytes themselves are never copied
+typedef struct
+{
+   const uint8_t *       ptr;
+   uint64_t              len;
+   emb_rb_desc_release_t release;
+   void *                ctx;
+} emb_rb_desc_t;
+
+// Ring of descriptors, head / tail are free running counts like emb_rb_t. offset is how much of the
+// tail descriptor was already consumed by a partial write.
+typedef struct
+{
+   emb_rb_desc_t * slots;
+   uint32_t        count;
+   uint64_t        head, tail;
+   uint64_t        offset;
+   uint64_t        bytes;
+   pthread_mutex_t lock;
+} emb_rb_desc_ring_t;
+
+/**
+ * @brief Initialize a descriptor ring, it queues {pointer, length, release callback} entries so large
+ * payloads are handed to the consumer instead of copied into ring storage
+ *
+ * @param dr pointer to the descriptor ring we want to initialize
+ * @param slots pointer to the descriptor storage
+ * @param count number of descriptors in slots
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_desc_init(emb_rb_desc_ring_t *dr, emb_rb_desc_t *slots, uint32_t count);
+
+/**
+ * @brief Queue a caller buffer, ownership passes to the ring until the release callback runs
+ *
+ * @param dr pointer to the descriptor ring
+ * @param ptr pointer to the payload
+ * @param len length of the payload
+ * @param release callback run once the payload is consumed, can be NULL
+ * @param ctx context passed to release
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_BUFFER_FULL if every slot is taken, negative error code on failure
+ */
+int emb_rb_desc_push(emb_rb_desc_ring_t *dr, const uint8_t *ptr, uint64_t len, emb_rb_desc_release_t release, void *ctx);
+
+/**
+ * @brief Dequeue up to max descriptors, ownership passes to the caller who releases them, e.g. with
+ * emb_rb_desc_release. If the first one was partly consumed through emb_rb_desc_consume it is
+ * returned as queued and *offset says how much of it is already gone.
+ *
+ * @param dr pointer to the descriptor ring
+ * @param descs pointer to where the descriptors are stored
+ * @param max maximum number of descriptors to dequeue
+ * @param offset pointer to where the consumed part of the first descriptor is stored, can be NULL
+ * @return uint32_t number of descriptors dequeued
+ */
+uint32_t emb_rb_desc_pop_n(emb_rb_desc_ring_t *dr, emb_rb_desc_t *descs, uint32_t max, uint64_t *offset);
+
+/**
+ * @brief Run the release callbacks of n descriptors
+ *
+ * @param descs pointer to the descriptors
+ * @param n number of descriptors
+ */
+void emb_rb_desc_release(const emb_rb_desc_t *descs, uint32_t n);
+
+/**
+ * @brief Describe the pending bytes as a scatter list without dequeuing, for writev style output
+ *
+ * @param dr pointer to the descriptor ring
+ * @param iov pointer to the iovec array
+ * @param max number of entries in iov
+ * @return uint32_t number of entries filled
+ */
+uint32_t emb_rb_desc_iov(emb_rb_desc_ring_t *dr, struct iovec *iov, uint32_t max);
+
+/**
+ * @brief Consume len pending bytes, descriptors that are fully consumed are released in batches
+ *
+ * @param dr pointer to the descriptor ring
+ * @param len number of bytes consumed
+ * @return uint64_t number of bytes consumed, less than len only if fewer were pending
+ */
+uint64_t emb_rb_desc_consume(emb_rb_desc_ring_t *dr, uint64_t len);
+
+/**
+ * @brief Write pending bytes to fd with a single writev and consume what was written
+ *
+ * @param dr pointer to the descriptor ring
+ * @param fd file descriptor we want to write to
+ * @param err pointer to the error code, EMB_RB_ERR_IO if writev failed with errno set, can be NULL
+ * @return uint64_t number of bytes written
+ */
+uint64_t emb_rb_desc_write_fd(emb_rb_desc_ring_t *dr, int fd, int *err);
+
+/**
+ * @brief Get the number of queued descriptors
+ *
+ * @param dr pointer to the descriptor ring
+ * @return uint32_t number of descriptors
+ */
+uint32_t emb_rb_desc_used(emb_rb_desc_ring_t *dr);
+
+/**
+ * @brief Get the number of pending payload bytes
+ *
+ * @param dr pointer to the descriptor ring
+ * @return uint64_t number of bytes
+ */
+uint64_t emb_rb_desc_bytes(emb_rb_desc_ring_t *dr);
+
+/**
+ * @brief Destroy the descriptor ring, pending descriptors are released
+ *
+ * @param dr pointer to the descriptor ring
+ */
+void emb_rb_desc_destroy(emb_rb_desc_ring_t *dr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_DESC_H_ */
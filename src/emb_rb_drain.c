@@ -0,0 +1,171 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_drain.h"
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+// Monotonic time in nanoseconds, used for the timeout and stall statistics
+static uint64_t _internal_emb_rb_drain_now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+// Write one batch, waiting for a non blocking fd to become writable. Returns 0 or an errno.
+static int _internal_emb_rb_drain_write(emb_rb_drain_t *d)
+{
+   int      err;
+   // We are the only consumer, so the write covers at least this much unless the fd pushes back
+   uint64_t want    = emb_rb_used_space64(d->rb);
+   uint64_t start   = _internal_emb_rb_drain_now_ns();
+   uint64_t written = emb_rb_write_fd(d->rb, d->fd, d->max_batch, &err);
+   int      stalled = 0;
+   int      rtn     = 0;
+
+   if (want > d->max_batch)
+   {
+      want = d->max_batch;
+   }
+   if (err == EMB_RB_ERR_IO)
+   {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+         // Wake up now and then so a stop is not stuck behind a fd that never drains
+         struct pollfd pfd = { d->fd, POLLOUT, 0 };
+         uint64_t      ms  = d->timeout_ns / 1000000 + 1;
+         poll(&pfd, 1, ms < EMB_RB_DRAIN_POLL_MAX_MS ? (int)ms : EMB_RB_DRAIN_POLL_MAX_MS);
+         stalled = 1;
+      }
+      else if (errno != EINTR)
+      {
+         rtn = errno;
+      }
+   }
+   else if (written < want)
+   {
+      stalled = 1;
+   }
+   // Only time lost to a full fd is a stall, not the cost of the writes themselves
+   if (stalled)
+   {
+      __atomic_add_fetch(&d->stats.stall_ns, _internal_emb_rb_drain_now_ns() - start, __ATOMIC_RELAXED);
+   }
+   if (written)
+   {
+      __atomic_add_fetch(&d->stats.bytes, written, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&d->stats.writes, 1, __ATOMIC_RELAXED);
+   }
+   return(rtn);
+}
+
+// Drainer thread, batches on min_batch / timeout until stopped, then writes what is left
+static void *_internal_emb_rb_drain_thread(void *arg)
+{
+   emb_rb_drain_t *d    = (emb_rb_drain_t *)arg;
+   uint64_t        last = _internal_emb_rb_drain_now_ns();
+
+   while (!__atomic_load_n(&d->stop, __ATOMIC_ACQUIRE) && !d->err)
+   {
+      // A full ring counts as a full batch even if min_batch is larger than the ring
+      uint64_t min  = emb_rb_size64(d->rb, NULL);
+      uint64_t now  = _internal_emb_rb_drain_now_ns();
+      uint64_t left = now - last < d->timeout_ns ? d->timeout_ns - (now - last) : 0;
+      min = d->min_batch < min ? d->min_batch : min;
+      uint64_t used = emb_rb_wait(d->rb, min, left, &d->stop);
+      if (used >= min || (used && _internal_emb_rb_drain_now_ns() - last >= d->timeout_ns))
+      {
+         if (used < min)
+         {
+            __atomic_add_fetch(&d->stats.timeouts, 1, __ATOMIC_RELAXED);
+         }
+         d->err = _internal_emb_rb_drain_write(d);
+         last   = _internal_emb_rb_drain_now_ns();
+      }
+      else if (!used)
+      {
+         last = _internal_emb_rb_drain_now_ns();
+      }
+   }
+   // Graceful shutdown, write out everything producers queued before the stop
+   while (!d->err && emb_rb_used_space64(d->rb))
+   {
+      d->err = _internal_emb_rb_drain_write(d);
+   }
+   return(NULL);
+}
+
+// Start the drainer thread
+int emb_rb_drain_start(emb_rb_drain_t *d, emb_rb_t *rb, int fd, uint64_t min_batch, uint64_t max_batch, uint64_t timeout_ns)
+{
+   // Null check
+   if (!d || !rb || fd < 0 || !min_batch || !timeout_ns)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   memset(d, 0, sizeof(*d));
+   d->rb         = rb;
+   d->fd         = fd;
+   d->min_batch  = min_batch;
+   d->max_batch  = max_batch ? max_batch : UINT64_MAX;
+   d->timeout_ns = timeout_ns;
+   if (pthread_create(&d->thread, NULL, _internal_emb_rb_drain_thread, d) != 0)
+   {
+      return(EMB_RB_ERR_NO_MEM);
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Stop the drainer after it wrote out the rest of the ring
+int emb_rb_drain_stop(emb_rb_drain_t *d)
+{
+   // Null check
+   if (!d || !d->rb)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   // Sequentially consistent so it pairs with the fence in emb_rb_wait, see emb_rb_wake_waiters
+   __atomic_store_n(&d->stop, 1, __ATOMIC_SEQ_CST);
+   emb_rb_wake_waiters(d->rb);
+   pthread_join(d->thread, NULL);
+   d->rb = NULL;
+   return(d->err ? EMB_RB_ERR_IO : EMB_RB_ERR_OK);
+}
+
+// Snapshot the drainer statistics
+int emb_rb_drain_stats(emb_rb_drain_t *d, emb_rb_drain_stats_t *stats)
+{
+   // Null check
+   if (!d || !stats)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   stats->bytes    = __atomic_load_n(&d->stats.bytes, __ATOMIC_RELAXED);
+   stats->writes   = __atomic_load_n(&d->stats.writes, __ATOMIC_RELAXED);
+   stats->timeouts = __atomic_load_n(&d->stats.timeouts, __ATOMIC_RELAXED);
+   stats->stall_ns = __atomic_load_n(&d->stats.stall_ns, __ATOMIC_RELAXED);
+   return(EMB_RB_ERR_OK);
+}
@@ -0,0 +1,97 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_DRAIN_H_
+#define EMB_RB_DRAIN_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "emb_rb.h"
+
+// Longest the drainer sleeps in poll on a full fd before it looks at the stop flag again
+#ifndef EMB_RB_DRAIN_POLL_MAX_MS
+#define EMB_RB_DRAIN_POLL_MAX_MS    100
+#endif
+
+// Drainer statistics, safe to read while the drainer runs through emb_rb_drain_stats
+typedef struct
+{
+   uint64_t bytes;     // bytes written to the fd
+   uint64_t writes;    // writev calls that wrote something
+   uint64_t timeouts;  // batches written below min_batch because the timeout expired
+   uint64_t stall_ns;  // time spent in writevs that came up short or would block, and waiting for POLLOUT
+} emb_rb_drain_stats_t;
+
+// Background drainer, the only consumer of its ring while it runs
+typedef struct
+{
+   emb_rb_t *           rb;
+   int                  fd;
+   uint64_t             min_batch, max_batch;
+   uint64_t             timeout_ns;
+   uint8_t              stop;
+   int                  err;
+   emb_rb_drain_stats_t stats;
+   pthread_t            thread;
+} emb_rb_drain_t;
+
+/**
+ * @brief Start a thread that writes the ring to fd with writev straight from ring storage. It writes
+ * once min_batch bytes are queued, or whatever is queued once timeout_ns passed since the last write.
+ *
+ * @param d pointer to the drainer
+ * @param rb pointer to the ring buffer to drain
+ * @param fd file descriptor to write to, blocking or non blocking
+ * @param min_batch number of queued bytes that triggers a write
+ * @param max_batch maximum number of bytes per writev, 0 for no limit
+ * @param timeout_ns time after which queued bytes are written even below min_batch
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_drain_start(emb_rb_drain_t *d, emb_rb_t *rb, int fd, uint64_t min_batch, uint64_t max_batch, uint64_t timeout_ns);
+
+/**
+ * @brief Stop the drainer, everything still queued is written before the thread exits
+ *
+ * @param d pointer to the drainer
+ * @return EMB_RB_ERR_OK if the ring was drained, EMB_RB_ERR_IO if a write failed, errno of the failure in d->err
+ */
+int emb_rb_drain_stop(emb_rb_drain_t *d);
+
+/**
+ * @brief Get a snapshot of the drainer statistics
+ *
+ * @param d pointer to the drainer
+ * @param stats pointer to where the statistics are copied
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_drain_stats(emb_rb_drain_t *d, emb_rb_drain_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_DRAIN_H_ */
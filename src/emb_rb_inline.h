@@ -0,0 +1,213 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_INLINE_H_
+#define EMB_RB_INLINE_H_
+
+// Header only fast paths for small queue / dequeue calls, pulled in by emb_rb.h when EMB_RB_INLINE is
+// defined. They have the same semantics as the out of line functions, which they fall back to for
+// large copies and for elastic rings or rings with watermarks, event loop notifications or a ready set.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Largest copy handled inline, anything bigger goes to the out of line memcpy path
+#ifndef EMB_RB_INLINE_MAX
+#define EMB_RB_INLINE_MAX    16
+#endif
+
+// Take the lock for the data path, only a try unless the ring was set up as blocking
+static inline int emb_rb_inline_trylock(emb_rb_t *rb)
+{
+   if (rb->lock.blocking)
+   {
+      emb_rb_lock_acquire(&rb->lock);
+      return(1);
+   }
+   return(emb_rb_lock_try(&rb->lock));
+}
+
+// Wake batch consumers if there are any, waiters register under the ring lock so only rings without
+// one need the fence pairing with emb_rb_wait
+static inline void emb_rb_inline_wake(emb_rb_t *rb)
+{
+   if (rb->lock.policy == EMB_RB_LOCK_NONE)
+   {
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   }
+   if (__atomic_load_n(&rb->waiters, __ATOMIC_RELAXED))
+   {
+      emb_rb_wake_waiters(rb);
+   }
+}
+
+// Queue a single byte, inline
+static inline uint8_t emb_rb_queue_single_inline(emb_rb_t *rb, uint8_t byte, int *err)
+{
+   // Elastic rings may have to grow, leave that to the out of line code
+   if (!rb || rb->elastic || rb->wm || rb->notify || rb->ready)
+   {
+      return(emb_rb_queue_single(rb, byte, err));
+   }
+   if (!emb_rb_inline_trylock(rb))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   // Large copies are running outside the lock, the out of line code waits for them
+   if (rb->copying)
+   {
+      emb_rb_lock_release(&rb->lock);
+      return(emb_rb_queue_single(rb, byte, err));
+   }
+   uint8_t ret = 0;
+   if (rb->head - rb->tail < rb->size)
+   {
+      rb->bP[rb->head_idx] = byte;
+      rb->head_idx         = rb->head_idx + 1 == rb->size ? 0 : rb->head_idx + 1;
+      __atomic_store_n(&rb->head, rb->head + 1, __ATOMIC_RELEASE);
+      ret = 1;
+   }
+   emb_rb_lock_release(&rb->lock);
+   if (ret)
+   {
+      emb_rb_inline_wake(rb);
+   }
+
+   if (err)
+   {
+      *err = ret ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_FULL;
+   }
+   return(ret);
+}
+
+// Queue up to EMB_RB_INLINE_MAX bytes, inline
+static inline uint32_t emb_rb_queue_inline(emb_rb_t *rb, const uint8_t *bytes, uint32_t len, int *err)
+{
+   if (!rb || !bytes || !len || len > EMB_RB_INLINE_MAX || rb->elastic || rb->wm || rb->notify || rb->ready)
+   {
+      return(emb_rb_queue(rb, bytes, len, err));
+   }
+   if (!emb_rb_inline_trylock(rb))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   // A large queue is still being published, the out of line code queues behind it
+   if (rb->head_pend)
+   {
+      emb_rb_lock_release(&rb->lock);
+      return(emb_rb_queue(rb, bytes, len, err));
+   }
+   uint64_t space = rb->size - (rb->head - rb->tail);
+   if (len > space)
+   {
+      len = (uint32_t)space;
+   }
+   uint64_t idx = rb->head_idx;
+   for (uint32_t i = 0; i < len; i++)
+   {
+      rb->bP[idx] = bytes[i];
+      idx         = idx + 1 == rb->size ? 0 : idx + 1;
+   }
+   rb->head_idx = idx;
+   __atomic_store_n(&rb->head, rb->head + len, __ATOMIC_RELEASE);
+   emb_rb_lock_release(&rb->lock);
+   if (len)
+   {
+      emb_rb_inline_wake(rb);
+   }
+
+   if (err)
+   {
+      *err = len ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_FULL;
+   }
+   return(len);
+}
+
+// Dequeue up to EMB_RB_INLINE_MAX bytes, inline
+static inline uint32_t emb_rb_dequeue_inline(emb_rb_t *rb, uint8_t *bytes, uint32_t len, int *err)
+{
+   if (!rb || !bytes || !len || len > EMB_RB_INLINE_MAX || rb->elastic || rb->wm || rb->notify || rb->ready)
+   {
+      return(emb_rb_dequeue(rb, bytes, len, err));
+   }
+   if (!emb_rb_inline_trylock(rb))
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_LOCK;
+      }
+      return(0);
+   }
+   // A large dequeue is still being published, the out of line code dequeues behind it
+   if (rb->tail_pend)
+   {
+      emb_rb_lock_release(&rb->lock);
+      return(emb_rb_dequeue(rb, bytes, len, err));
+   }
+   uint64_t used = rb->head - rb->tail;
+   if (len > used)
+   {
+      len = (uint32_t)used;
+   }
+   uint64_t idx = rb->tail_idx;
+   for (uint32_t i = 0; i < len; i++)
+   {
+      bytes[i] = rb->bP[idx];
+      idx      = idx + 1 == rb->size ? 0 : idx + 1;
+   }
+   // Same tail_seq window as _internal_emb_rb_set_tail
+   __atomic_store_n(&rb->tail_seq, rb->tail_seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   __atomic_store_n(&rb->tail_idx, idx, __ATOMIC_RELAXED);
+   __atomic_store_n(&rb->tail, rb->tail + len, __ATOMIC_RELEASE);
+   __atomic_store_n(&rb->tail_seq, rb->tail_seq + 1, __ATOMIC_RELEASE);
+   emb_rb_lock_release(&rb->lock);
+
+   if (err)
+   {
+      *err = len ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_EMPTY;
+   }
+   return(len);
+}
+
+// Route the public names to the inline versions, defined last so the fallbacks above still call out of line
+#define emb_rb_queue_single    emb_rb_queue_single_inline
+#define emb_rb_queue           emb_rb_queue_inline
+#define emb_rb_dequeue         emb_rb_dequeue_inline
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_INLINE_H_ */
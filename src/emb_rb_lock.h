@@ -0,0 +1,257 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_LOCK_H_
+#define EMB_RB_LOCK_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Number of pause / relax rounds the spin and adaptive policies go through before yielding or parking
+#ifndef EMB_RB_SPIN_LIMIT
+#define EMB_RB_SPIN_LIMIT    1024
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EMB_RB_CPU_RELAX()    __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define EMB_RB_CPU_RELAX()    __asm__ __volatile__ ("yield")
+#else
+#define EMB_RB_CPU_RELAX()    do {} while (0)
+#endif
+
+// Synchronization strategy of a ring, picked at init time
+typedef enum
+{
+   EMB_RB_LOCK_MUTEX = 0,
+   EMB_RB_LOCK_NONE,
+   EMB_RB_LOCK_SPIN,
+   EMB_RB_LOCK_ADAPTIVE,
+   EMB_RB_LOCK_CALLBACK
+} emb_rb_lock_policy_t;
+
+// Lock configuration. With blocking set every operation waits for the lock, otherwise
+// emb_rb_queue_single, emb_rb_queue and emb_rb_dequeue try once and report EMB_RB_ERR_LOCK, and
+// everything else waits. This is the same for every policy. With optimistic_peek set emb_rb_peek
+// reads without the lock and validates afterwards, see emb_rb_peek_optimistic. With unlocked_copy set
+// emb_rb_queue / emb_rb_dequeue copies of EMB_RB_UNLOCKED_COPY_MIN bytes and up run outside the lock.
+// While one is in flight the other operations that move head or tail wait for it, and the ones that
+// only try the lock report EMB_RB_ERR_LOCK. Only EMB_RB_LOCK_MUTEX and EMB_RB_LOCK_ADAPTIVE honour it,
+// the other policies may run where waiting for another copy to finish would never end.
+typedef struct
+{
+   emb_rb_lock_policy_t policy;
+   uint8_t              blocking;
+   void                 (*lock)(void *ctx);
+   int                  (*trylock)(void *ctx);
+   void                 (*unlock)(void *ctx);
+   void *               ctx;
+   uint8_t              optimistic_peek;
+   uint8_t              unlocked_copy;
+} emb_rb_lock_cfg_t;
+
+typedef struct
+{
+   uint8_t         policy;
+   uint8_t         blocking;
+   uint8_t         optimistic_peek;
+   uint8_t         unlocked_copy;
+   uint32_t        spin;
+   pthread_mutex_t mtx;
+   void            (*lock_cb)(void *ctx);
+   int             (*trylock_cb)(void *ctx);
+   void            (*unlock_cb)(void *ctx);
+   void *          ctx;
+} emb_rb_lock_t;
+
+/**
+ * @brief Initialize a lock, cfg can be NULL for a non blocking pthread mutex
+ *
+ * @param l pointer to the lock we want to initialize
+ * @param cfg pointer to the lock configuration, can be NULL
+ * @return int 0 on success, non zero on failure
+ */
+static inline int emb_rb_lock_init(emb_rb_lock_t *l, const emb_rb_lock_cfg_t *cfg)
+{
+   l->policy     = cfg ? (uint8_t)cfg->policy : (uint8_t)EMB_RB_LOCK_MUTEX;
+   l->blocking   = cfg ? cfg->blocking : 0;
+   l->optimistic_peek = cfg ? cfg->optimistic_peek : 0;
+   l->unlocked_copy   = cfg && (l->policy == EMB_RB_LOCK_MUTEX || l->policy == EMB_RB_LOCK_ADAPTIVE) ? cfg->unlocked_copy : 0;
+   l->spin       = 0;
+   l->lock_cb    = cfg ? cfg->lock : NULL;
+   l->trylock_cb = cfg ? cfg->trylock : NULL;
+   l->unlock_cb  = cfg ? cfg->unlock : NULL;
+   l->ctx        = cfg ? cfg->ctx : NULL;
+   switch (l->policy)
+   {
+   case EMB_RB_LOCK_MUTEX:
+   case EMB_RB_LOCK_ADAPTIVE:
+      return(pthread_mutex_init(&l->mtx, NULL));
+
+   case EMB_RB_LOCK_CALLBACK:
+      return(!l->lock_cb || !l->unlock_cb);
+
+   case EMB_RB_LOCK_NONE:
+   case EMB_RB_LOCK_SPIN:
+      return(0);
+
+   default:
+      return(-1);
+   }
+}
+
+/**
+ * @brief Try to take the lock once
+ *
+ * @param l pointer to the lock
+ * @return int 1 if the lock was taken, 0 if not
+ */
+static inline int emb_rb_lock_try(emb_rb_lock_t *l)
+{
+   switch (l->policy)
+   {
+   case EMB_RB_LOCK_NONE:
+      return(1);
+
+   case EMB_RB_LOCK_SPIN:
+      return(!__atomic_load_n(&l->spin, __ATOMIC_RELAXED) && !__atomic_exchange_n(&l->spin, 1, __ATOMIC_ACQUIRE));
+
+   case EMB_RB_LOCK_CALLBACK:
+      if (l->trylock_cb)
+      {
+         return(l->trylock_cb(l->ctx));
+      }
+      l->lock_cb(l->ctx);
+      return(1);
+
+   default:
+      return(pthread_mutex_trylock(&l->mtx) == 0);
+   }
+}
+
+/**
+ * @brief Take the lock, waiting as long as it takes
+ *
+ * @param l pointer to the lock
+ */
+static inline void emb_rb_lock_acquire(emb_rb_lock_t *l)
+{
+   switch (l->policy)
+   {
+   case EMB_RB_LOCK_NONE:
+      return;
+
+   case EMB_RB_LOCK_SPIN:
+   {
+      // Test and test and set, spin on a plain load and back off exponentially, then yield
+      uint32_t backoff = 1;
+      while (!emb_rb_lock_try(l))
+      {
+         for (uint32_t i = 0; i < backoff; i++)
+         {
+            EMB_RB_CPU_RELAX();
+         }
+         if (backoff < EMB_RB_SPIN_LIMIT)
+         {
+            backoff <<= 1;
+         }
+         else
+         {
+            sched_yield();
+         }
+      }
+      return;
+   }
+
+   case EMB_RB_LOCK_ADAPTIVE:
+      // Spin a bounded amount in case the holder is about to let go, then park on the mutex
+      for (uint32_t i = 0; i < EMB_RB_SPIN_LIMIT; i++)
+      {
+         if (pthread_mutex_trylock(&l->mtx) == 0)
+         {
+            return;
+         }
+         EMB_RB_CPU_RELAX();
+      }
+      pthread_mutex_lock(&l->mtx);
+      return;
+
+   case EMB_RB_LOCK_CALLBACK:
+      l->lock_cb(l->ctx);
+      return;
+
+   default:
+      pthread_mutex_lock(&l->mtx);
+      return;
+   }
+}
+
+/**
+ * @brief Release the lock
+ *
+ * @param l pointer to the lock
+ */
+static inline void emb_rb_lock_release(emb_rb_lock_t *l)
+{
+   switch (l->policy)
+   {
+   case EMB_RB_LOCK_NONE:
+      return;
+
+   case EMB_RB_LOCK_SPIN:
+      __atomic_store_n(&l->spin, 0, __ATOMIC_RELEASE);
+      return;
+
+   case EMB_RB_LOCK_CALLBACK:
+      l->unlock_cb(l->ctx);
+      return;
+
+   default:
+      pthread_mutex_unlock(&l->mtx);
+      return;
+   }
+}
+
+/**
+ * @brief Destroy the lock
+ *
+ * @param l pointer to the lock
+ */
+static inline void emb_rb_lock_destroy(emb_rb_lock_t *l)
+{
+   if (l->policy == EMB_RB_LOCK_MUTEX || l->policy == EMB_RB_LOCK_ADAPTIVE)
+   {
+      pthread_mutex_destroy(&l->mtx);
+   }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_LOCK_H_ */
@@ -0,0 +1,532 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_log.h"
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Parser results that do not consume an argument
+#define EMB_RB_LOG_SPEC_PERCENT    -1
+#define EMB_RB_LOG_SPEC_INVALID    -2
+
+// Bytes an argument of type t takes in a record, strings count only their length prefix
+static const uint8_t _internal_emb_rb_log_sizes[] = {
+   sizeof(int), sizeof(long), sizeof(long long), sizeof(size_t), sizeof(intmax_t),
+   sizeof(ptrdiff_t), sizeof(double), sizeof(long double), sizeof(void *), sizeof(uint16_t)
+};
+
+// Parse the conversion starting right after a '%', returns its argument type and where it ends
+static int _internal_emb_rb_log_spec(const char *p, const char **end)
+{
+   const char *q  = p;
+   char        m1 = 0, m2 = 0;
+
+   while (*q && strchr("-+ #0", *q))
+   {
+      q++;
+   }
+   while (*q >= '0' && *q <= '9')
+   {
+      q++;
+   }
+   if (*q == '.')
+   {
+      q++;
+      while (*q >= '0' && *q <= '9')
+      {
+         q++;
+      }
+   }
+   if (*q && strchr("hljztL", *q))
+   {
+      m1 = *q++;
+      if ((m1 == 'h' || m1 == 'l') && *q == m1)
+      {
+         m2 = *q++;
+      }
+   }
+   if (!*q)
+   {
+      return(EMB_RB_LOG_SPEC_INVALID);
+   }
+   *end = q + 1;
+   switch (*q)
+   {
+   case '%':
+      return(q == p ? EMB_RB_LOG_SPEC_PERCENT : EMB_RB_LOG_SPEC_INVALID);
+
+   case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+      switch (m1)
+      {
+      case 0:
+      case 'h':
+         return(EMB_RB_LOG_ARG_INT);
+
+      case 'l':
+         return(m2 ? EMB_RB_LOG_ARG_LLONG : EMB_RB_LOG_ARG_LONG);
+
+      case 'j':
+         return(EMB_RB_LOG_ARG_INTMAX);
+
+      case 'z':
+         return(EMB_RB_LOG_ARG_SIZE);
+
+      case 't':
+         return(EMB_RB_LOG_ARG_PTRDIFF);
+      }
+      return(EMB_RB_LOG_SPEC_INVALID);
+
+   case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+      if (!m1 || (m1 == 'l' && !m2))
+      {
+         return(EMB_RB_LOG_ARG_DOUBLE);
+      }
+      return(m1 == 'L' ? EMB_RB_LOG_ARG_LDOUBLE : EMB_RB_LOG_SPEC_INVALID);
+
+   case 'c':
+      return(m1 ? EMB_RB_LOG_SPEC_INVALID : EMB_RB_LOG_ARG_INT);
+
+   case 'p':
+      return(m1 ? EMB_RB_LOG_SPEC_INVALID : EMB_RB_LOG_ARG_PTR);
+
+   case 's':
+      return(m1 ? EMB_RB_LOG_SPEC_INVALID : EMB_RB_LOG_ARG_STR);
+   }
+   return(EMB_RB_LOG_SPEC_INVALID);
+}
+
+// Copy the next fixed size argument out of a record
+static int _internal_emb_rb_log_arg(const uint8_t *rec, uint32_t len, uint32_t *off, void *v, uint32_t size)
+{
+   if (*off + size > len)
+   {
+      return(0);
+   }
+   memcpy(v, rec + *off, size);
+   *off += size;
+   return(1);
+}
+
+// Initialize a deferred formatting logger
+int emb_rb_log_init(emb_rb_log_t *log, emb_rb_t *rb, emb_rb_log_fmt_t *fmts, uint16_t capacity)
+{
+   // Null check
+   if (!log || !fmts || !capacity)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   log->rb       = rb;
+   log->fmts     = fmts;
+   log->capacity = capacity;
+   log->count    = 0;
+   log->dropped  = 0;
+   return(EMB_RB_ERR_OK);
+}
+
+// Register a format string, the argument types are worked out here once
+int emb_rb_log_register(emb_rb_log_t *log, const char *fmt, uint16_t *id)
+{
+   // Null check
+   if (!log || !fmt || !id)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   if (log->count == log->capacity)
+   {
+      return(EMB_RB_ERR_NO_MEM);
+   }
+   emb_rb_log_fmt_t *f     = &log->fmts[log->count];
+   uint32_t          fixed = EMB_RB_LOG_HDR_LEN;
+   const char *      p     = fmt;
+
+   f->fmt   = fmt;
+   f->nargs = 0;
+   while ((p = strchr(p, '%')))
+   {
+      int t = _internal_emb_rb_log_spec(p + 1, &p);
+      if (t == EMB_RB_LOG_SPEC_PERCENT)
+      {
+         continue;
+      }
+      if (t == EMB_RB_LOG_SPEC_INVALID || f->nargs == EMB_RB_LOG_ARGS_MAX)
+      {
+         return(EMB_RB_ERR_ILLEGAL_ARGS);
+      }
+      f->types[f->nargs++] = (uint8_t)t;
+      fixed               += _internal_emb_rb_log_sizes[t];
+   }
+   if (fixed > EMB_RB_LOG_RECORD_MAX)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   f->fixed = (uint16_t)fixed;
+   *id      = log->count++;
+   return(EMB_RB_ERR_OK);
+}
+
+// Log one record, the arguments are copied as passed and queued with the format id
+int emb_rb_log_write(emb_rb_log_t *log, uint16_t id, ...)
+{
+   // Null check
+   if (!log || !log->rb || id >= log->count)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   const emb_rb_log_fmt_t *f = &log->fmts[id];
+   uint8_t                 rec[EMB_RB_LOG_RECORD_MAX];
+   uint32_t                n    = EMB_RB_LOG_HDR_LEN;
+   uint32_t                left = f->fixed - EMB_RB_LOG_HDR_LEN;
+   va_list                 ap;
+   int                     err;
+
+   va_start(ap, id);
+   for (uint32_t i = 0; i < f->nargs; i++)
+   {
+      uint32_t size = _internal_emb_rb_log_sizes[f->types[i]];
+      left -= size;
+      switch (f->types[i])
+      {
+      case EMB_RB_LOG_ARG_INT:
+      {
+         int v = va_arg(ap, int);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_LONG:
+      {
+         long v = va_arg(ap, long);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_LLONG:
+      {
+         long long v = va_arg(ap, long long);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_SIZE:
+      {
+         size_t v = va_arg(ap, size_t);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_INTMAX:
+      {
+         intmax_t v = va_arg(ap, intmax_t);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_PTRDIFF:
+      {
+         ptrdiff_t v = va_arg(ap, ptrdiff_t);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_DOUBLE:
+      {
+         double v = va_arg(ap, double);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_LDOUBLE:
+      {
+         long double v = va_arg(ap, long double);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_PTR:
+      {
+         void *v = va_arg(ap, void *);
+         memcpy(rec + n, &v, size);
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_STR:
+      {
+         // Truncate to what is left once the arguments after this one are accounted for
+         const char *s   = va_arg(ap, const char *);
+         uint32_t    len = s ? (uint32_t)strnlen(s, EMB_RB_LOG_RECORD_MAX) : 0;
+         uint32_t    max = EMB_RB_LOG_RECORD_MAX - n - size - left;
+         if (len > max)
+         {
+            len = max;
+         }
+         rec[n]     = (uint8_t)len;
+         rec[n + 1] = (uint8_t)(len >> 8);
+         if (len)
+         {
+            memcpy(rec + n + size, s, len);
+         }
+         n += len;
+         break;
+      }
+      }
+      n += size;
+   }
+   va_end(ap);
+   rec[0] = (uint8_t)n;
+   rec[1] = (uint8_t)(n >> 8);
+   rec[2] = (uint8_t)id;
+   rec[3] = (uint8_t)(id >> 8);
+   // Lock contention is usually short lived, but a call site must not spin behind a holder that is
+   // not going to let go (e.g. the code it interrupted), so give up after a few tries
+   for (uint32_t i = 0; !emb_rb_queue_record(log->rb, rec, n, &err) && err == EMB_RB_ERR_LOCK; i++)
+   {
+      if (i + 1 == EMB_RB_LOG_LOCK_RETRIES)
+      {
+         break;
+      }
+      EMB_RB_CPU_RELAX();
+   }
+   if (err == EMB_RB_ERR_BUFFER_FULL || err == EMB_RB_ERR_LOCK)
+   {
+      __atomic_fetch_add(&log->dropped, 1, __ATOMIC_RELAXED);
+   }
+   return(err);
+}
+
+// Format one record
+int emb_rb_log_decode(const emb_rb_log_t *log, const uint8_t *rec, uint32_t len, char *out, size_t out_len)
+{
+   // Null check
+   if (!log || !rec || (!out && out_len) || len < EMB_RB_LOG_HDR_LEN || len > EMB_RB_LOG_RECORD_MAX)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   uint32_t id = (uint32_t)rec[2] | ((uint32_t)rec[3] << 8);
+   if (((uint32_t)rec[0] | ((uint32_t)rec[1] << 8)) != len || id >= log->count)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   const char *p   = log->fmts[id].fmt;
+   uint32_t    off = EMB_RB_LOG_HDR_LEN;
+   size_t      pos = 0;
+   char        spec[32];
+   char        str[EMB_RB_LOG_RECORD_MAX];
+
+   while (*p)
+   {
+      char * dst  = pos < out_len ? out + pos : NULL;
+      size_t room = pos < out_len ? out_len - pos : 0;
+      int    w    = -1;
+
+      // Literal text up to the next conversion
+      if (*p != '%')
+      {
+         const char *q = strchr(p, '%');
+         size_t      n = q ? (size_t)(q - p) : strlen(p);
+         if (room)
+         {
+            memcpy(dst, p, n < room ? n : room - 1);
+         }
+         pos += n;
+         p   += n;
+         continue;
+      }
+      const char *end;
+      int         t = _internal_emb_rb_log_spec(p + 1, &end);
+      if (t == EMB_RB_LOG_SPEC_INVALID || (size_t)(end - p) >= sizeof(spec))
+      {
+         return(EMB_RB_ERR_ILLEGAL_ARGS);
+      }
+      memcpy(spec, p, end - p);
+      spec[end - p] = 0;
+      p             = end;
+      switch (t)
+      {
+      case EMB_RB_LOG_SPEC_PERCENT:
+         w = snprintf(dst, room, "%%");
+         break;
+
+      case EMB_RB_LOG_ARG_INT:
+      {
+         int v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_LONG:
+      {
+         long v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_LLONG:
+      {
+         long long v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_SIZE:
+      {
+         size_t v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_INTMAX:
+      {
+         intmax_t v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_PTRDIFF:
+      {
+         ptrdiff_t v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_DOUBLE:
+      {
+         double v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_LDOUBLE:
+      {
+         long double v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_PTR:
+      {
+         void *v;
+         if (_internal_emb_rb_log_arg(rec, len, &off, &v, sizeof(v)))
+         {
+            w = snprintf(dst, room, spec, v);
+         }
+         break;
+      }
+
+      case EMB_RB_LOG_ARG_STR:
+      {
+         // The length prefix is little endian like the header
+         uint8_t n[2];
+         if (_internal_emb_rb_log_arg(rec, len, &off, n, sizeof(n)) &&
+             _internal_emb_rb_log_arg(rec, len, &off, str, (uint32_t)n[0] | ((uint32_t)n[1] << 8)))
+         {
+            str[(uint32_t)n[0] | ((uint32_t)n[1] << 8)] = 0;
+            w = snprintf(dst, room, spec, str);
+         }
+         break;
+      }
+      }
+      if (w < 0)
+      {
+         return(EMB_RB_ERR_ILLEGAL_ARGS);
+      }
+      pos += (size_t)w;
+   }
+   if (out_len)
+   {
+      out[pos < out_len ? pos : out_len - 1] = 0;
+   }
+   return((int)pos);
+}
+
+// Dequeue and format the next record
+int emb_rb_log_next(emb_rb_log_t *log, char *out, size_t out_len, int *err)
+{
+   uint8_t rec[EMB_RB_LOG_RECORD_MAX];
+   int     e = EMB_RB_ERR_BUFFER_EMPTY;
+   int     w = 0;
+
+   // Null check
+   if (!log || !log->rb)
+   {
+      e = EMB_RB_ERR_ILLEGAL_ARGS;
+   }
+   // Records are queued whole, a header means the full record is there
+   else if (emb_rb_peek64(log->rb, 0, rec, EMB_RB_LOG_HDR_LEN) == EMB_RB_LOG_HDR_LEN)
+   {
+      uint32_t len  = (uint32_t)rec[0] | ((uint32_t)rec[1] << 8);
+      uint64_t used = emb_rb_used_space64(log->rb);
+      if (len < EMB_RB_LOG_HDR_LEN || len > EMB_RB_LOG_RECORD_MAX || len > used)
+      {
+         // There is no telling where the next record starts, drop what is queued so the next call
+         // starts clean on whatever producers queue from here on
+         emb_rb_flush_partial64(log->rb, used);
+         e = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      else if (emb_rb_dequeue64(log->rb, rec, len, &e) == len)
+      {
+         w = emb_rb_log_decode(log, rec, len, out, out_len);
+         e = w < 0 ? w : EMB_RB_ERR_OK;
+         w = w < 0 ? 0 : w;
+      }
+   }
+   if (err)
+   {
+      *err = e;
+   }
+   return(w);
+}
+
+// Get the number of dropped records
+uint64_t emb_rb_log_dropped(emb_rb_log_t *log)
+{
+   // Null check
+   if (!log)
+   {
+      return(0);
+   }
+   return(__atomic_load_n(&log->dropped, __ATOMIC_RELAXED));
+}
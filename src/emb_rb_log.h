@@ -0,0 +1,155 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_LOG_H_
+#define EMB_RB_LOG_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "emb_rb.h"
+
+// Largest record, header included, longer strings are truncated to fit
+#define EMB_RB_LOG_RECORD_MAX    192
+// Most conversions a registered format string may hold
+#define EMB_RB_LOG_ARGS_MAX      8
+// Record header, u16 record length then u16 format id, both little endian
+#define EMB_RB_LOG_HDR_LEN       4
+// Tries emb_rb_log_write gives a contended lock before it drops the record
+#ifndef EMB_RB_LOG_LOCK_RETRIES
+#define EMB_RB_LOG_LOCK_RETRIES    64
+#endif
+
+// How an argument was passed and stored. Numeric ones keep their C type's native bytes, so an offline
+// decoder has to run on the producer's ABI, strings are a u16 length and the bytes.
+typedef enum
+{
+   EMB_RB_LOG_ARG_INT = 0,
+   EMB_RB_LOG_ARG_LONG,
+   EMB_RB_LOG_ARG_LLONG,
+   EMB_RB_LOG_ARG_SIZE,
+   EMB_RB_LOG_ARG_INTMAX,
+   EMB_RB_LOG_ARG_PTRDIFF,
+   EMB_RB_LOG_ARG_DOUBLE,
+   EMB_RB_LOG_ARG_LDOUBLE,
+   EMB_RB_LOG_ARG_PTR,
+   EMB_RB_LOG_ARG_STR
+} emb_rb_log_arg_t;
+
+// A registered format string, parsed once so the call site only copies arguments. fixed is the
+// record space taken by everything but the string bytes.
+typedef struct
+{
+   const char *fmt;
+   uint8_t     types[EMB_RB_LOG_ARGS_MAX];
+   uint8_t     nargs;
+   uint16_t    fixed;
+} emb_rb_log_fmt_t;
+
+// Format table plus the ring the records go to. The table is all a decoder needs, an offline tool
+// registers the same strings in the same order and decodes a dump of the ring.
+typedef struct
+{
+   emb_rb_t *        rb;
+   emb_rb_log_fmt_t *fmts;
+   uint16_t          capacity;
+   uint16_t          count;
+   uint64_t          dropped;
+} emb_rb_log_t;
+
+/**
+ * @brief Initialize a deferred formatting logger, call sites queue a format id and the raw argument
+ * bytes and formatting happens later on the consumer side
+ *
+ * @param log pointer to the logger we want to initialize
+ * @param rb pointer to the ring the records are queued into, can be NULL for a decode only table
+ * @param fmts pointer to the format table storage
+ * @param capacity number of entries in fmts
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_log_init(emb_rb_log_t *log, emb_rb_t *rb, emb_rb_log_fmt_t *fmts, uint16_t capacity);
+
+/**
+ * @brief Register a printf style format string, not thread safe, do it at startup. Supports the
+ * d i u o x X c e E f F g G a A p s conversions with flags, width, precision and the hh h l ll j z t L
+ * length modifiers, but not * widths or %n. The string must stay valid for the logger's lifetime.
+ *
+ * @param log pointer to the logger
+ * @param fmt pointer to the format string
+ * @param id pointer to where the format id is stored
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_NO_MEM if the table is full, negative error code on failure
+ */
+int emb_rb_log_register(emb_rb_log_t *log, const char *fmt, uint16_t *id);
+
+/**
+ * @brief Log one record, copies the arguments as they were passed without formatting them. Records
+ * that do not fit in the ring, or that still find the lock taken after EMB_RB_LOG_LOCK_RETRIES tries,
+ * are dropped and counted.
+ *
+ * @param log pointer to the logger
+ * @param id format id returned by emb_rb_log_register
+ * @param ... arguments matching the format string
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_BUFFER_FULL or EMB_RB_ERR_LOCK if the record was dropped, negative error code on failure
+ */
+int emb_rb_log_write(emb_rb_log_t *log, uint16_t id, ...);
+
+/**
+ * @brief Format one record, for a consumer or an offline tool that got the record bytes some other way
+ *
+ * @param log pointer to the logger holding the format table
+ * @param rec pointer to the record, header included
+ * @param len length of the record
+ * @param out pointer to the text output, always NUL terminated
+ * @param out_len size of out
+ * @return int length of the formatted text (which may exceed out_len like snprintf), negative error code on failure
+ */
+int emb_rb_log_decode(const emb_rb_log_t *log, const uint8_t *rec, uint32_t len, char *out, size_t out_len);
+
+/**
+ * @brief Dequeue and format the next record, the logger's single consumer (e.g. a background thread)
+ * calls this in a loop. A record with a corrupt length loses the framing, so everything queued at that
+ * point is discarded and EMB_RB_ERR_ILLEGAL_ARGS is reported once.
+ *
+ * @param log pointer to the logger
+ * @param out pointer to the text output, always NUL terminated
+ * @param out_len size of out
+ * @param err pointer to the error code, EMB_RB_ERR_BUFFER_EMPTY if there is no record, can be NULL
+ * @return int length of the formatted text, 0 if no record was dequeued
+ */
+int emb_rb_log_next(emb_rb_log_t *log, char *out, size_t out_len, int *err);
+
+/**
+ * @brief Get the number of records dropped because the ring was full or the lock stayed contended
+ *
+ * @param log pointer to the logger
+ * @return uint64_t number of dropped records
+ */
+uint64_t emb_rb_log_dropped(emb_rb_log_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_LOG_H_ */
@@ -0,0 +1,256 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_pool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Free the slabs of every class that has been set up so far
+static void _internal_emb_rb_pool_free(emb_rb_pool_t *pool)
+{
+   for (uint8_t c = 0; c < pool->num_classes; c++)
+   {
+      emb_rb_pool_class_state_t *cs = &pool->classes[c];
+      if (cs->slots)
+      {
+         for (uint32_t i = 0; i < cs->count; i++)
+         {
+            emb_rb_destroy(&cs->slots[i].rb);
+         }
+      }
+      free(cs->slots);
+      free(cs->slab);
+      cs->slots = NULL;
+      cs->slab  = NULL;
+   }
+}
+
+// Put a released ring back the way emb_rb_pool_init left it, in place. The lock and the wait primitives
+// are kept so churn never pays for their setup again, only a lock config the previous owner changed
+// goes back to the default mutex. Nothing in here can fail.
+static void _internal_emb_rb_pool_reset(emb_rb_t *rb, uint8_t *bP, uint32_t size)
+{
+   emb_rb_lock_t *l = &rb->lock;
+
+   emb_rb_notify_destroy(rb);
+   // Elastic rings own their storage
+   if (rb->elastic)
+   {
+      rb->elastic->cfg.free(rb->elastic->cfg.ctx, rb->bP);
+      rb->elastic = NULL;
+   }
+   if (l->policy != EMB_RB_LOCK_MUTEX || l->blocking || l->optimistic_peek || l->unlocked_copy ||
+       l->lock_cb || l->trylock_cb || l->unlock_cb || l->ctx)
+   {
+      // The static initializer sets up the same default mutex as pthread_mutex_init, without a
+      // failure path
+      pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+      emb_rb_lock_destroy(l);
+      l->policy          = EMB_RB_LOCK_MUTEX;
+      l->blocking        = 0;
+      l->optimistic_peek = 0;
+      l->unlocked_copy   = 0;
+      l->spin            = 0;
+      l->mtx             = mtx;
+      l->lock_cb         = NULL;
+      l->trylock_cb      = NULL;
+      l->unlock_cb       = NULL;
+      l->ctx             = NULL;
+   }
+   rb->bP        = bP;
+   rb->size      = size;
+   rb->head      = 0;
+   rb->tail      = 0;
+   rb->head_idx  = 0;
+   rb->tail_idx  = 0;
+   rb->wm        = NULL;
+   rb->notify    = NULL;
+   rb->ready     = NULL;
+   rb->elem_size = 0;
+   rb->waiters   = 0;
+   rb->seq       = 0;
+   rb->tail_seq  = 0;
+   rb->head_pend = 0;
+   rb->tail_pend = 0;
+   rb->copying   = 0;
+}
+
+// Initialize the pool, carve every class out of a single slab
+int emb_rb_pool_init(emb_rb_pool_t *pool, const emb_rb_pool_class_t *classes, uint8_t num_classes)
+{
+   // Null check
+   if (!pool || !classes || !num_classes || num_classes > EMB_RB_POOL_MAX_CLASSES)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   // Classes must be sorted so acquire can stop at the first fit
+   for (uint8_t c = 0; c < num_classes; c++)
+   {
+      if (!classes[c].size || !classes[c].count || (c > 0 && classes[c].size <= classes[c - 1].size))
+      {
+         return(EMB_RB_ERR_ILLEGAL_ARGS);
+      }
+   }
+   memset(pool, 0, sizeof(*pool));
+   if (pthread_mutex_init(&pool->lock, NULL) != 0)
+   {
+      return(EMB_RB_ERR_LOCK);
+   }
+   for (uint8_t c = 0; c < num_classes; c++)
+   {
+      emb_rb_pool_class_state_t *cs = &pool->classes[c];
+      pool->num_classes = c + 1;
+      cs->size          = classes[c].size;
+      cs->slab          = (uint8_t *)malloc((size_t)classes[c].size * classes[c].count);
+      cs->slots         = (emb_rb_pool_slot_t *)calloc(classes[c].count, sizeof(emb_rb_pool_slot_t));
+      if (!cs->slab || !cs->slots)
+      {
+         _internal_emb_rb_pool_free(pool);
+         pthread_mutex_destroy(&pool->lock);
+         return(EMB_RB_ERR_NO_MEM);
+      }
+      // Initialize every control block once, they are reused from here on out
+      for (uint32_t i = 0; i < classes[c].count; i++)
+      {
+         emb_rb_pool_slot_t *slot = &cs->slots[i];
+         int                 rtn  = emb_rb_init(&slot->rb, cs->slab + (size_t)i * cs->size, cs->size);
+         if (rtn != EMB_RB_ERR_OK)
+         {
+            _internal_emb_rb_pool_free(pool);
+            pthread_mutex_destroy(&pool->lock);
+            return(rtn);
+         }
+         cs->count++;
+         slot->next = cs->free;
+         cs->free   = slot;
+      }
+      cs->available = cs->count;
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Pop a ring from the first class that fits and has one left
+emb_rb_t *emb_rb_pool_acquire(emb_rb_pool_t *pool, uint32_t min_size, int *err)
+{
+   // Null check
+   if (!pool)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(NULL);
+   }
+   emb_rb_pool_slot_t *slot = NULL;
+   pthread_mutex_lock(&pool->lock);
+   for (uint8_t c = 0; c < pool->num_classes && !slot; c++)
+   {
+      emb_rb_pool_class_state_t *cs = &pool->classes[c];
+      if (cs->size >= min_size && cs->free)
+      {
+         slot     = cs->free;
+         cs->free = slot->next;
+         cs->available--;
+      }
+   }
+   if (slot)
+   {
+      slot->next   = NULL;
+      slot->in_use = 1;
+   }
+   pthread_mutex_unlock(&pool->lock);
+
+   if (err)
+   {
+      *err = slot ? EMB_RB_ERR_OK : EMB_RB_ERR_NO_MEM;
+   }
+   return(slot ? &slot->rb : NULL);
+}
+
+// Push the ring back on its class free list
+int emb_rb_pool_release(emb_rb_pool_t *pool, emb_rb_t *rb)
+{
+   // Null check
+   if (!pool || !rb)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   // Make sure the ring actually came out of this pool and points at the start of a slot
+   emb_rb_pool_slot_t *       slot = (emb_rb_pool_slot_t *)rb;
+   emb_rb_pool_class_state_t *cs   = NULL;
+   for (uint8_t c = 0; c < pool->num_classes && !cs; c++)
+   {
+      emb_rb_pool_class_state_t *cur = &pool->classes[c];
+      uintptr_t                  off = (uintptr_t)slot - (uintptr_t)cur->slots;
+      if (slot >= cur->slots && slot < cur->slots + cur->count && off % sizeof(emb_rb_pool_slot_t) == 0)
+      {
+         cs = cur;
+      }
+   }
+   if (!cs)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+
+   pthread_mutex_lock(&pool->lock);
+   if (!slot->in_use)
+   {
+      pthread_mutex_unlock(&pool->lock);
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   // The next owner starts empty, without the previous owner's watermark, eventfds, ready hook or
+   // lock config
+   _internal_emb_rb_pool_reset(rb, cs->slab + (size_t)(slot - cs->slots) * cs->size, cs->size);
+   slot->in_use = 0;
+   slot->next   = cs->free;
+   cs->free     = slot;
+   cs->available++;
+   pthread_mutex_unlock(&pool->lock);
+   return(EMB_RB_ERR_OK);
+}
+
+// Get the number of rings left in a class
+uint32_t emb_rb_pool_available(emb_rb_pool_t *pool, uint8_t cls)
+{
+   // Null check
+   if (!pool || cls >= pool->num_classes)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&pool->lock);
+   uint32_t ret = pool->classes[cls].available;
+   pthread_mutex_unlock(&pool->lock);
+   return(ret);
+}
+
+// Destroy the pool
+void emb_rb_pool_destroy(emb_rb_pool_t *pool)
+{
+   // Null check
+   if (!pool)
+   {
+      return;
+   }
+   _internal_emb_rb_pool_free(pool);
+   pool->num_classes = 0;
+   pthread_mutex_destroy(&pool->lock);
+}
@@ -0,0 +1,119 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_POOL_H_
+#define EMB_RB_POOL_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "emb_rb.h"
+
+#define EMB_RB_POOL_MAX_CLASSES    8
+
+// Size class description handed to emb_rb_pool_init
+typedef struct
+{
+   uint32_t size;
+   uint32_t count;
+} emb_rb_pool_class_t;
+
+// A pooled ring, the ring must stay the first member so we can get back to the slot
+typedef struct emb_rb_pool_slot_s
+{
+   emb_rb_t                   rb;
+   struct emb_rb_pool_slot_s *next;
+   uint8_t                    in_use;
+} emb_rb_pool_slot_t;
+
+typedef struct
+{
+   uint32_t            size, count, available;
+   uint8_t *           slab;
+   emb_rb_pool_slot_t *slots;
+   emb_rb_pool_slot_t *free;
+} emb_rb_pool_class_state_t;
+
+typedef struct
+{
+   emb_rb_pool_class_state_t classes[EMB_RB_POOL_MAX_CLASSES];
+   uint8_t                   num_classes;
+   pthread_mutex_t           lock;
+} emb_rb_pool_t;
+
+/**
+ * @brief Initialize a ring buffer pool, preallocating one slab per size class
+ *
+ * @param pool pointer to the pool we want to initialize
+ * @param classes array of size classes, sorted by ascending size
+ * @param num_classes number of entries in classes, at most EMB_RB_POOL_MAX_CLASSES
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_pool_init(emb_rb_pool_t *pool, const emb_rb_pool_class_t *classes, uint8_t num_classes);
+
+/**
+ * @brief Acquire an empty ring buffer of at least min_size bytes from the pool
+ *
+ * @param pool pointer to the pool we want to acquire a ring buffer from
+ * @param min_size minimum size of the ring buffer in bytes
+ * @param err pointer to the error code, can be NULL
+ * @return emb_rb_t* pointer to the ring buffer, NULL if no class can satisfy min_size
+ */
+emb_rb_t *emb_rb_pool_acquire(emb_rb_pool_t *pool, uint32_t min_size, int *err);
+
+/**
+ * @brief Release a ring buffer back to the pool it was acquired from. The ring is reset in place, so
+ * anything attached to it (watermark, eventfds, ready hook, lock config) is dropped and the eventfds
+ * are closed, while the lock set up by emb_rb_pool_init is kept for the next owner. Remove it from
+ * any emb_rb_set first, the set would still point at it. Only fails for a ring that is not in use.
+ *
+ * @param pool pointer to the pool we want to release the ring buffer to
+ * @param rb pointer to the ring buffer we want to release
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_pool_release(emb_rb_pool_t *pool, emb_rb_t *rb);
+
+/**
+ * @brief Get the number of ring buffers left in a size class
+ *
+ * @param pool pointer to the pool we want to query
+ * @param cls index of the size class
+ * @return uint32_t number of free ring buffers in the class
+ */
+uint32_t emb_rb_pool_available(emb_rb_pool_t *pool, uint8_t cls);
+
+/**
+ * @brief Destroy the pool and free all of its slabs
+ *
+ * @param pool pointer to the pool we want to destroy
+ */
+void emb_rb_pool_destroy(emb_rb_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_POOL_H_ */
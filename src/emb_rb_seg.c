@@ -0,0 +1,268 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_seg.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Get a chunk from the free list, or allocate a new one
+static emb_rb_seg_chunk_t *_internal_emb_rb_seg_get_chunk(emb_rb_seg_t *seg)
+{
+   emb_rb_seg_chunk_t *chunk = seg->free;
+
+   if (chunk)
+   {
+      seg->free = chunk->next;
+      seg->num_free--;
+   }
+   else
+   {
+      chunk = (emb_rb_seg_chunk_t *)malloc(sizeof(emb_rb_seg_chunk_t) + seg->chunk_size);
+      if (!chunk)
+      {
+         return(NULL);
+      }
+      // The queue lock already covers the chunks
+      emb_rb_lock_cfg_t none = { EMB_RB_LOCK_NONE, 0, NULL, NULL, NULL, NULL, 0, 0 };
+      if (emb_rb_init_ex(&chunk->rb, (uint8_t *)(chunk + 1), seg->chunk_size, &none) != EMB_RB_ERR_OK)
+      {
+         free(chunk);
+         return(NULL);
+      }
+   }
+   chunk->next = NULL;
+   return(chunk);
+}
+
+// Return a drained chunk to the free list, or free it if the list is full
+static void _internal_emb_rb_seg_put_chunk(emb_rb_seg_t *seg, emb_rb_seg_chunk_t *chunk)
+{
+   if (seg->num_free < seg->max_free)
+   {
+      emb_rb_flush(&chunk->rb);
+      chunk->next = seg->free;
+      seg->free   = chunk;
+      seg->num_free++;
+   }
+   else
+   {
+      emb_rb_destroy(&chunk->rb);
+      free(chunk);
+   }
+}
+
+// Initialize the segmented queue with a single empty chunk
+int emb_rb_seg_init(emb_rb_seg_t *seg, uint32_t chunk_size, uint32_t max_free)
+{
+   // Null check
+   if (!seg || !chunk_size)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   memset(seg, 0, sizeof(*seg));
+   seg->chunk_size = chunk_size;
+   seg->max_free   = max_free;
+   if (pthread_mutex_init(&seg->lock, NULL) != 0)
+   {
+      return(EMB_RB_ERR_LOCK);
+   }
+   seg->head = _internal_emb_rb_seg_get_chunk(seg);
+   if (!seg->head)
+   {
+      pthread_mutex_destroy(&seg->lock);
+      return(EMB_RB_ERR_NO_MEM);
+   }
+   seg->tail = seg->head;
+   return(EMB_RB_ERR_OK);
+}
+
+// Queue len number of bytes, linking in new chunks as the head chunk fills
+uint32_t emb_rb_seg_queue(emb_rb_seg_t *seg, const uint8_t *bytes, uint32_t len, int *err)
+{
+   // Null check
+   if (!seg || !bytes || !len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   int      rtn = EMB_RB_ERR_OK;
+   uint32_t n   = 0;
+   pthread_mutex_lock(&seg->lock);
+   while (n < len)
+   {
+      n += emb_rb_queue(&seg->head->rb, bytes + n, len - n, NULL);
+      if (n < len)
+      {
+         // Head chunk is full, add capacity without touching what is already queued
+         emb_rb_seg_chunk_t *chunk = _internal_emb_rb_seg_get_chunk(seg);
+         if (!chunk)
+         {
+            rtn = EMB_RB_ERR_NO_MEM;
+            break;
+         }
+         seg->head->next = chunk;
+         seg->head       = chunk;
+      }
+   }
+   seg->used += n;
+   pthread_mutex_unlock(&seg->lock);
+
+   if (err)
+   {
+      *err = rtn;
+   }
+   return(n);
+}
+
+// Dequeue len number of bytes, recycling chunks as they drain
+uint32_t emb_rb_seg_dequeue(emb_rb_seg_t *seg, uint8_t *bytes, uint32_t len, int *err)
+{
+   // Null check
+   if (!seg || !bytes || !len)
+   {
+      if (err)
+      {
+         *err = EMB_RB_ERR_ILLEGAL_ARGS;
+      }
+      return(0);
+   }
+   uint32_t n = 0;
+   pthread_mutex_lock(&seg->lock);
+   while (n < len)
+   {
+      n += emb_rb_dequeue(&seg->tail->rb, bytes + n, len - n, NULL);
+      if (n < len)
+      {
+         // Tail chunk is drained, the head chunk always stays
+         if (seg->tail == seg->head)
+         {
+            break;
+         }
+         emb_rb_seg_chunk_t *chunk = seg->tail;
+         seg->tail = chunk->next;
+         _internal_emb_rb_seg_put_chunk(seg, chunk);
+      }
+   }
+   seg->used -= n;
+   pthread_mutex_unlock(&seg->lock);
+
+   if (err)
+   {
+      *err = n ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_EMPTY;
+   }
+   return(n);
+}
+
+// Peek len number of bytes at position without dequeuing
+uint32_t emb_rb_seg_peek(emb_rb_seg_t *seg, uint64_t position, uint8_t *bytes, uint32_t len)
+{
+   // Null check
+   if (!seg || !bytes || !len)
+   {
+      return(0);
+   }
+   uint32_t n = 0;
+   pthread_mutex_lock(&seg->lock);
+   if (position > seg->used)
+   {
+      pthread_mutex_unlock(&seg->lock);
+      return(0);
+   }
+   // Skip whole chunks until we reach the one holding position
+   for (emb_rb_seg_chunk_t *chunk = seg->tail; chunk && n < len; chunk = chunk->next)
+   {
+      uint32_t used = emb_rb_used_space(&chunk->rb);
+      if (position >= used)
+      {
+         position -= used;
+         continue;
+      }
+      n       += emb_rb_peek(&chunk->rb, (uint32_t)position, bytes + n, len - n);
+      position = 0;
+   }
+   pthread_mutex_unlock(&seg->lock);
+   return(n);
+}
+
+// Get the number of used bytes across all chunks
+uint64_t emb_rb_seg_used_space(emb_rb_seg_t *seg)
+{
+   // Null check
+   if (!seg)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&seg->lock);
+   uint64_t ret = seg->used;
+   pthread_mutex_unlock(&seg->lock);
+   return(ret);
+}
+
+// Flush everything, keeping only the head chunk
+int emb_rb_seg_flush(emb_rb_seg_t *seg)
+{
+   // Null check
+   if (!seg)
+   {
+      return(0);
+   }
+   pthread_mutex_lock(&seg->lock);
+   while (seg->tail != seg->head)
+   {
+      emb_rb_seg_chunk_t *chunk = seg->tail;
+      seg->tail = chunk->next;
+      _internal_emb_rb_seg_put_chunk(seg, chunk);
+   }
+   emb_rb_flush(&seg->head->rb);
+   seg->used = 0;
+   pthread_mutex_unlock(&seg->lock);
+   return(-1);
+}
+
+// Destroy the segmented queue
+void emb_rb_seg_destroy(emb_rb_seg_t *seg)
+{
+   // Null check
+   if (!seg || !seg->head)
+   {
+      return;
+   }
+   // The free list and the live list are both NULL terminated
+   emb_rb_seg_chunk_t *lists[2] = { seg->tail, seg->free };
+   for (int i = 0; i < 2; i++)
+   {
+      while (lists[i])
+      {
+         emb_rb_seg_chunk_t *chunk = lists[i];
+         lists[i] = chunk->next;
+         emb_rb_destroy(&chunk->rb);
+         free(chunk);
+      }
+   }
+   seg->head = NULL;
+   seg->tail = NULL;
+   seg->free = NULL;
+   pthread_mutex_destroy(&seg->lock);
+}
@@ -0,0 +1,123 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_SEG_H_
+#define EMB_RB_SEG_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "emb_rb.h"
+
+// A fixed size ring chunk, the storage follows the struct in the same allocation
+typedef struct emb_rb_seg_chunk_s
+{
+   emb_rb_t                   rb;
+   struct emb_rb_seg_chunk_s *next;
+} emb_rb_seg_chunk_t;
+
+typedef struct
+{
+   emb_rb_seg_chunk_t *head, *tail;
+   emb_rb_seg_chunk_t *free;
+   uint32_t            chunk_size;
+   uint32_t            max_free, num_free;
+   uint64_t            used;
+   pthread_mutex_t     lock;
+} emb_rb_seg_t;
+
+/**
+ * @brief Initialize a segmented queue, an unbounded FIFO made of linked fixed size ring chunks
+ *
+ * @param seg pointer to the segmented queue we want to initialize
+ * @param chunk_size size of every chunk in bytes
+ * @param max_free number of drained chunks kept on the free list for reuse, the rest are freed
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_seg_init(emb_rb_seg_t *seg, uint32_t chunk_size, uint32_t max_free);
+
+/**
+ * @brief Queue len number of bytes into the segmented queue, adding chunks as needed. Data already
+ * queued is never moved.
+ *
+ * @param seg pointer to the segmented queue we want to queue bytes into
+ * @param bytes pointer to the bytes we want to queue
+ * @param len number of bytes we want to queue
+ * @param err pointer to the error code, can be NULL
+ * @return uint32_t number of bytes queued, less than len only if a chunk could not be allocated
+ */
+uint32_t emb_rb_seg_queue(emb_rb_seg_t *seg, const uint8_t *bytes, uint32_t len, int *err);
+
+/**
+ * @brief Dequeue len number of bytes from the segmented queue, recycling drained chunks
+ *
+ * @param seg pointer to the segmented queue we want to dequeue bytes from
+ * @param bytes pointer to the bytes we want to dequeue
+ * @param len number of bytes we want to dequeue
+ * @param err pointer to the error code, can be NULL
+ * @return uint32_t number of bytes dequeued
+ */
+uint32_t emb_rb_seg_dequeue(emb_rb_seg_t *seg, uint8_t *bytes, uint32_t len, int *err);
+
+/**
+ * @brief Peek len number of bytes from the segmented queue without dequeuing
+ *
+ * @param seg pointer to the segmented queue we want to peek bytes from
+ * @param position the position offset from the tail we want to peek bytes
+ * @param bytes pointer to the bytes we want to peek
+ * @param len number of bytes we want to peek
+ * @return uint32_t number of bytes peeked
+ */
+uint32_t emb_rb_seg_peek(emb_rb_seg_t *seg, uint64_t position, uint8_t *bytes, uint32_t len);
+
+/**
+ * @brief Get the used space in the segmented queue
+ *
+ * @param seg pointer to the segmented queue we want to get the used space of
+ * @return uint64_t used space in bytes
+ */
+uint64_t emb_rb_seg_used_space(emb_rb_seg_t *seg);
+
+/**
+ * @brief Flush the segmented queue, all chunks but one go to the free list
+ *
+ * @param seg pointer to the segmented queue we want to flush
+ * @return int returns 0 on failure, -1 on success
+ */
+int emb_rb_seg_flush(emb_rb_seg_t *seg);
+
+/**
+ * @brief Destroy the segmented queue and free all of its chunks
+ *
+ * @param seg pointer to the segmented queue we want to destroy
+ */
+void emb_rb_seg_destroy(emb_rb_seg_t *seg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_SEG_H_ */
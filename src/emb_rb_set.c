@@ -0,0 +1,212 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_set.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// Wake the consumer if it sleeps in emb_rb_set_wait, the fence pairs with the one there
+static void _internal_emb_rb_set_wake(void *ctx)
+{
+   emb_rb_set_t *set = (emb_rb_set_t *)ctx;
+
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&set->waiters, __ATOMIC_RELAXED))
+   {
+      pthread_mutex_lock(&set->mtx);
+      pthread_cond_broadcast(&set->cv);
+      pthread_mutex_unlock(&set->mtx);
+   }
+}
+
+// Take the ready bits, summary word first and then only the bitmap words it points at
+static uint32_t _internal_emb_rb_set_collect(emb_rb_set_t *set, emb_rb_t **ready, uint32_t max)
+{
+   uint64_t summary = __atomic_exchange_n(&set->summary, 0, __ATOMIC_ACQ_REL);
+   uint32_t n       = 0;
+
+   while (summary)
+   {
+      uint32_t w    = (uint32_t)__builtin_ctzll(summary);
+      uint64_t bits = __atomic_exchange_n(&set->words[w], 0, __ATOMIC_ACQ_REL);
+      summary &= summary - 1;
+      while (bits)
+      {
+         // Out of room, put back what is left for the next call
+         if (n == max)
+         {
+            __atomic_fetch_or(&set->words[w], bits, __ATOMIC_ACQ_REL);
+            __atomic_fetch_or(&set->summary, summary | (1ull << w), __ATOMIC_ACQ_REL);
+            return(n);
+         }
+         uint32_t   b  = (uint32_t)__builtin_ctzll(bits);
+         emb_rb_t * rb = set->slots[w * 64 + b].rb;
+         bits &= bits - 1;
+         if (rb)
+         {
+            ready[n++] = rb;
+         }
+      }
+   }
+   return(n);
+}
+
+// Initialize a ring set
+int emb_rb_set_init(emb_rb_set_t *set, emb_rb_set_slot_t *slots, uint32_t capacity)
+{
+   // Null check
+   if (!set || !slots || !capacity || capacity > EMB_RB_SET_MAX)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   memset(slots, 0, sizeof(*slots) * capacity);
+   memset(set->words, 0, sizeof(set->words));
+   set->slots    = slots;
+   set->capacity = capacity;
+   set->summary  = 0;
+   set->waiters  = 0;
+   // The consumer waits on a monotonic clock so wall clock jumps do not stretch the deadline
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   int rtn = pthread_mutex_init(&set->mtx, NULL);
+   if (!rtn && pthread_cond_init(&set->cv, &attr) != 0)
+   {
+      pthread_mutex_destroy(&set->mtx);
+      rtn = 1;
+   }
+   pthread_condattr_destroy(&attr);
+   if (rtn)
+   {
+      // Leave the set unusable, emb_rb_set_destroy then has nothing to tear down
+      set->slots = NULL;
+      return(EMB_RB_ERR_LOCK);
+   }
+   return(EMB_RB_ERR_OK);
+}
+
+// Add a ring to the set
+int emb_rb_set_add(emb_rb_set_t *set, emb_rb_t *rb)
+{
+   // Null check
+   if (!set || !set->slots || !rb || rb->ready)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   pthread_mutex_lock(&set->mtx);
+   uint32_t i = 0;
+   while (i < set->capacity && set->slots[i].rb)
+   {
+      i++;
+   }
+   if (i == set->capacity)
+   {
+      pthread_mutex_unlock(&set->mtx);
+      return(EMB_RB_ERR_NO_MEM);
+   }
+   emb_rb_set_slot_t *slot = &set->slots[i];
+   slot->rb                = rb;
+   slot->ready.word        = &set->words[i / 64];
+   slot->ready.summary     = &set->summary;
+   slot->ready.bit         = 1ull << (i % 64);
+   slot->ready.summary_bit = 1ull << (i / 64);
+   slot->ready.wake        = _internal_emb_rb_set_wake;
+   slot->ready.ctx         = set;
+   pthread_mutex_unlock(&set->mtx);
+   return(emb_rb_ready_attach(rb, &slot->ready));
+}
+
+// Remove a ring from the set
+int emb_rb_set_remove(emb_rb_set_t *set, emb_rb_t *rb)
+{
+   // Null check
+   if (!set || !set->slots || !rb || !rb->ready || rb->ready->ctx != set)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   emb_rb_set_slot_t *slot = (emb_rb_set_slot_t *)((uint8_t *)rb->ready - offsetof(emb_rb_set_slot_t, ready));
+   emb_rb_ready_attach(rb, NULL);
+   // A stale bit is harmless, collect skips empty slots
+   __atomic_fetch_and(slot->ready.word, ~slot->ready.bit, __ATOMIC_ACQ_REL);
+   pthread_mutex_lock(&set->mtx);
+   slot->rb = NULL;
+   pthread_mutex_unlock(&set->mtx);
+   return(EMB_RB_ERR_OK);
+}
+
+// Get the rings that hold data
+uint32_t emb_rb_set_wait(emb_rb_set_t *set, emb_rb_t **ready, uint32_t max, uint64_t max_wait_ns)
+{
+   // Null check
+   if (!set || !set->slots || !ready || !max)
+   {
+      return(0);
+   }
+   uint32_t n = _internal_emb_rb_set_collect(set, ready, max);
+   if (n || !max_wait_ns)
+   {
+      return(n);
+   }
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   // Saturate so a huge max_wait_ns means wait forever instead of wrapping into the past
+   uint64_t now      = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+   uint64_t deadline = max_wait_ns > UINT64_MAX - now ? UINT64_MAX : now + max_wait_ns;
+   ts.tv_sec  = (time_t)(deadline / 1000000000ull);
+   ts.tv_nsec = (long)(deadline % 1000000000ull);
+
+   pthread_mutex_lock(&set->mtx);
+   __atomic_add_fetch(&set->waiters, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   while (!(n = _internal_emb_rb_set_collect(set, ready, max)))
+   {
+      if (pthread_cond_timedwait(&set->cv, &set->mtx, &ts) != 0)
+      {
+         n = _internal_emb_rb_set_collect(set, ready, max);
+         break;
+      }
+   }
+   __atomic_sub_fetch(&set->waiters, 1, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&set->mtx);
+   return(n);
+}
+
+// Destroy the set
+void emb_rb_set_destroy(emb_rb_set_t *set)
+{
+   // Null check
+   if (!set || !set->slots)
+   {
+      return;
+   }
+   for (uint32_t i = 0; i < set->capacity; i++)
+   {
+      if (set->slots[i].rb)
+      {
+         emb_rb_ready_attach(set->slots[i].rb, NULL);
+         set->slots[i].rb = NULL;
+      }
+   }
+   pthread_cond_destroy(&set->cv);
+   pthread_mutex_destroy(&set->mtx);
+   set->slots = NULL;
+}
@@ -0,0 +1,111 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_SET_H_
+#define EMB_RB_SET_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "emb_rb.h"
+
+// Most rings a set can hold, one summary word over 64 bitmap words
+#define EMB_RB_SET_MAX    4096
+
+// One member of a set, the storage is owned by the caller
+typedef struct
+{
+   emb_rb_t *     rb;
+   emb_rb_ready_t ready;
+} emb_rb_set_slot_t;
+
+// Ready set over many rings. Producers flag their ring in the bitmap when it holds data, the consumer
+// takes whole words at a time so a pass only touches the rings that are ready.
+typedef struct
+{
+   emb_rb_set_slot_t *slots;
+   uint32_t           capacity;
+   uint64_t           summary;
+   uint64_t           words[EMB_RB_SET_MAX / 64];
+   uint32_t           waiters;
+   pthread_mutex_t    mtx;
+   pthread_cond_t     cv;
+} emb_rb_set_t;
+
+/**
+ * @brief Initialize a ring set
+ *
+ * @param set pointer to the set
+ * @param slots pointer to capacity member slots, owned by the caller
+ * @param capacity number of slots, at most EMB_RB_SET_MAX
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_set_init(emb_rb_set_t *set, emb_rb_set_slot_t *slots, uint32_t capacity);
+
+/**
+ * @brief Add a ring to the set, a ring already holding data is ready right away. A ring belongs to at
+ * most one set.
+ *
+ * @param set pointer to the set
+ * @param rb pointer to the ring buffer
+ * @return EMB_RB_ERR_OK on success, EMB_RB_ERR_NO_MEM if every slot is taken, negative error code on failure
+ */
+int emb_rb_set_add(emb_rb_set_t *set, emb_rb_t *rb);
+
+/**
+ * @brief Remove a ring from the set, call once no other thread is using the ring
+ *
+ * @param set pointer to the set
+ * @param rb pointer to the ring buffer
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_set_remove(emb_rb_set_t *set, emb_rb_t *rb);
+
+/**
+ * @brief Get the rings that hold data, sleeping up to max_wait_ns if none do. A returned ring is not
+ * reported again until new data arrives or a dequeue leaves data behind, so drain what you can from
+ * every ring returned. The cost is O(ready), not O(rings in the set). Meant for a single consumer.
+ *
+ * @param set pointer to the set
+ * @param ready pointer to an array that receives the ready rings
+ * @param max size of the ready array, rings that do not fit stay flagged for the next call
+ * @param max_wait_ns maximum time to wait for a ring to become ready, 0 to only poll
+ * @return uint32_t number of rings returned
+ */
+uint32_t emb_rb_set_wait(emb_rb_set_t *set, emb_rb_t **ready, uint32_t max, uint64_t max_wait_ns);
+
+/**
+ * @brief Destroy the set, detaching every ring still in it
+ *
+ * @param set pointer to the set
+ */
+void emb_rb_set_destroy(emb_rb_set_t *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_SET_H_ */
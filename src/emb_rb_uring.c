@@ -0,0 +1,536 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#include "emb_rb_uring.h"
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define EMB_RB_HAVE_URING    1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define EMB_RB_URING_DRAIN     0
+#define EMB_RB_URING_FILL      1
+
+// user_data of cancel requests, their completions carry no op
+#define EMB_RB_URING_CANCEL    UINT64_MAX
+
+// Take a free op slot
+static inline uint16_t _internal_emb_rb_uring_get_slot(emb_rb_uring_t *u)
+{
+   return(u->free_slots[--u->num_free]);
+}
+
+// Return an op slot
+static inline void _internal_emb_rb_uring_put_slot(emb_rb_uring_t *u, uint16_t slot)
+{
+   u->free_slots[u->num_free++] = slot;
+}
+
+// Move the ring past len completed bytes of direction d
+static void _internal_emb_rb_uring_advance(emb_rb_uring_t *u, int d, uint64_t len)
+{
+   emb_rb_uring_dir_t *dir = &u->dir[d];
+
+   if (d == EMB_RB_URING_DRAIN)
+   {
+      emb_rb_flush_partial64(u->rb, len);
+   }
+   else
+   {
+      emb_rb_publish(u->rb, len);
+   }
+   dir->bytes += len;
+   if (dir->off_done >= 0)
+   {
+      dir->off_done += (int64_t)len;
+   }
+}
+
+// Retire the completed ops of direction d in submission order, so the ring only ever advances over
+// bytes that are done even if the kernel completes them out of order
+static int _internal_emb_rb_uring_retire(emb_rb_uring_t *u, int d)
+{
+   emb_rb_uring_dir_t *dir = &u->dir[d];
+
+   while (dir->fifo_head != dir->fifo_tail)
+   {
+      uint16_t           slot = dir->fifo[dir->fifo_head % EMB_RB_URING_MAX_DEPTH];
+      emb_rb_uring_op_t *op   = &u->ops[slot];
+      if (!op->done)
+      {
+         break;
+      }
+      if (!dir->rewind)
+      {
+         if (op->res > 0)
+         {
+            _internal_emb_rb_uring_advance(u, d, (uint32_t)op->res < op->len ? (uint32_t)op->res : op->len);
+         }
+         // Anything short of the full length breaks the sequence, later ops are dropped and resubmitted
+         if (op->res != (int32_t)op->len)
+         {
+            dir->rewind = 1;
+            if (op->res == 0 && d == EMB_RB_URING_FILL)
+            {
+               dir->eof = 1;
+            }
+            else if (op->res < 0 && op->res != -ECANCELED && op->res != -EAGAIN && op->res != -EINTR)
+            {
+               dir->err = -op->res;
+            }
+         }
+      }
+      dir->pending -= op->len;
+      dir->fifo_head++;
+      u->inflight--;
+      _internal_emb_rb_uring_put_slot(u, slot);
+   }
+   // Once everything after a short op is back, carry on from the first byte that did not complete
+   if (dir->rewind && dir->fifo_head == dir->fifo_tail)
+   {
+      dir->rewind = 0;
+      dir->off    = dir->off_done;
+   }
+   return(dir->err ? EMB_RB_ERR_IO : EMB_RB_ERR_OK);
+}
+
+// Synchronous readv / writev of everything that fits in one call, for the fallback mode
+static int _internal_emb_rb_uring_sync(emb_rb_uring_t *u, int d)
+{
+   emb_rb_uring_dir_t *dir = &u->dir[d];
+   emb_rb_span_t       spans[2];
+   struct iovec        iov[2];
+   ssize_t             res;
+
+   if (dir->fd < 0 || dir->err || (d == EMB_RB_URING_FILL && dir->eof))
+   {
+      return(0);
+   }
+   uint64_t len = d == EMB_RB_URING_DRAIN ? emb_rb_read_spans(u->rb, 0, spans, u->chunk) : emb_rb_write_spans(u->rb, 0, spans, u->chunk);
+   if (!len)
+   {
+      return(0);
+   }
+   iov[0].iov_base = spans[0].ptr;
+   iov[0].iov_len  = (size_t)spans[0].len;
+   iov[1].iov_base = spans[1].ptr;
+   iov[1].iov_len  = (size_t)spans[1].len;
+   int cnt = spans[1].len ? 2 : 1;
+   if (d == EMB_RB_URING_DRAIN)
+   {
+      res = dir->off < 0 ? writev(dir->fd, iov, cnt) : pwritev(dir->fd, iov, cnt, dir->off);
+   }
+   else
+   {
+      res = dir->off < 0 ? readv(dir->fd, iov, cnt) : preadv(dir->fd, iov, cnt, dir->off);
+   }
+   if (res < 0)
+   {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+         dir->err = errno;
+      }
+      return(0);
+   }
+   if (res == 0 && d == EMB_RB_URING_FILL)
+   {
+      dir->eof = 1;
+   }
+   _internal_emb_rb_uring_advance(u, d, (uint64_t)res);
+   dir->off = dir->off_done;
+   return(1);
+}
+
+#ifdef EMB_RB_HAVE_URING
+// Unmap the rings and close the io_uring fd
+static void _internal_emb_rb_uring_teardown(emb_rb_uring_t *u)
+{
+   if (u->sqes && u->sqes != MAP_FAILED)
+   {
+      munmap(u->sqes, u->sqes_sz);
+   }
+   if (u->cq_ptr && u->cq_ptr != MAP_FAILED && u->cq_ptr != u->sq_ptr)
+   {
+      munmap(u->cq_ptr, u->cq_sz);
+   }
+   if (u->sq_ptr && u->sq_ptr != MAP_FAILED)
+   {
+      munmap(u->sq_ptr, u->sq_sz);
+   }
+   if (u->ring_fd >= 0)
+   {
+      close(u->ring_fd);
+   }
+   u->sq_ptr  = NULL;
+   u->cq_ptr  = NULL;
+   u->sqes    = NULL;
+   u->ring_fd = -1;
+}
+
+// Create the io_uring instance and register the ring storage as fixed buffer 0
+static int _internal_emb_rb_uring_setup(emb_rb_uring_t *u, uint32_t flags)
+{
+   struct io_uring_params p;
+
+   memset(&p, 0, sizeof(p));
+   u->ring_fd = (int)syscall(__NR_io_uring_setup, u->depth, &p);
+   if (u->ring_fd < 0)
+   {
+      return(-1);
+   }
+   u->sq_sz = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+   u->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+   if (p.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      u->sq_sz = u->cq_sz = u->sq_sz > u->cq_sz ? u->sq_sz : u->cq_sz;
+   }
+   u->sq_ptr = mmap(NULL, u->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+   if (u->sq_ptr == MAP_FAILED)
+   {
+      _internal_emb_rb_uring_teardown(u);
+      return(-1);
+   }
+   if (p.features & IORING_FEAT_SINGLE_MMAP)
+   {
+      u->cq_ptr = u->sq_ptr;
+   }
+   else
+   {
+      u->cq_ptr = mmap(NULL, u->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+      if (u->cq_ptr == MAP_FAILED)
+      {
+         _internal_emb_rb_uring_teardown(u);
+         return(-1);
+      }
+   }
+   u->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+   u->sqes    = mmap(NULL, u->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+   if (u->sqes == MAP_FAILED)
+   {
+      _internal_emb_rb_uring_teardown(u);
+      return(-1);
+   }
+   u->sq_head  = (uint32_t *)((uint8_t *)u->sq_ptr + p.sq_off.head);
+   u->sq_tail  = (uint32_t *)((uint8_t *)u->sq_ptr + p.sq_off.tail);
+   u->sq_mask  = (uint32_t *)((uint8_t *)u->sq_ptr + p.sq_off.ring_mask);
+   u->sq_array = (uint32_t *)((uint8_t *)u->sq_ptr + p.sq_off.array);
+   u->cq_head  = (uint32_t *)((uint8_t *)u->cq_ptr + p.cq_off.head);
+   u->cq_tail  = (uint32_t *)((uint8_t *)u->cq_ptr + p.cq_off.tail);
+   u->cq_mask  = (uint32_t *)((uint8_t *)u->cq_ptr + p.cq_off.ring_mask);
+   u->cqes     = (uint8_t *)u->cq_ptr + p.cq_off.cqes;
+   u->mode     = EMB_RB_URING_MODE_PLAIN;
+   // Fixed buffers save the kernel pinning the pages on every op, fall back to plain ops if the
+   // registration is refused (e.g. RLIMIT_MEMLOCK or a ring over 1 GiB)
+   if (!(flags & EMB_RB_URING_NO_FIXED))
+   {
+      struct iovec iov = { u->rb->bP, (size_t)u->rb->size };
+      if (syscall(__NR_io_uring_register, u->ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0)
+      {
+         u->mode = EMB_RB_URING_MODE_FIXED;
+      }
+   }
+   return(0);
+}
+
+// Get the next submission queue entry, it is handed to the kernel on the next io_uring_enter
+static struct io_uring_sqe *_internal_emb_rb_uring_sqe(emb_rb_uring_t *u, uint64_t user_data)
+{
+   uint32_t             tail = *u->sq_tail;
+   uint32_t             idx  = tail & *u->sq_mask;
+   struct io_uring_sqe *sqe  = &((struct io_uring_sqe *)u->sqes)[idx];
+
+   memset(sqe, 0, sizeof(*sqe));
+   sqe->user_data = user_data;
+   u->sq_array[idx] = idx;
+   __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+   u->to_submit++;
+   return(sqe);
+}
+
+// Submit queued entries and optionally wait for completions
+static int _internal_emb_rb_uring_enter(emb_rb_uring_t *u, uint32_t wait_nr)
+{
+   int ret;
+
+   do
+   {
+      ret = (int)syscall(__NR_io_uring_enter, u->ring_fd, u->to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+   } while (ret < 0 && errno == EINTR);
+   if (ret < 0)
+   {
+      return(EMB_RB_ERR_IO);
+   }
+   u->to_submit -= (uint32_t)ret;
+   return(EMB_RB_ERR_OK);
+}
+
+// Queue reads or writes for everything in direction d that is not in flight yet
+static int _internal_emb_rb_uring_prep(emb_rb_uring_t *u, int d)
+{
+   emb_rb_uring_dir_t * dir  = &u->dir[d];
+   struct io_uring_sqe *last = NULL;
+   int                  n    = 0;
+
+   if (dir->fd < 0 || dir->rewind || dir->err || (d == EMB_RB_URING_FILL && dir->eof))
+   {
+      return(0);
+   }
+   // Pipes and sockets have no offsets, one linked chain at a time keeps their bytes in order
+   uint8_t stream = dir->off < 0;
+   if (stream && dir->fifo_head != dir->fifo_tail)
+   {
+      return(0);
+   }
+   while (u->inflight < u->depth)
+   {
+      emb_rb_span_t spans[2];
+      uint64_t      len = d == EMB_RB_URING_DRAIN ? emb_rb_read_spans(u->rb, dir->pending, spans, u->chunk) : emb_rb_write_spans(u->rb, dir->pending, spans, u->chunk);
+      if (!len)
+      {
+         break;
+      }
+      // One op per contiguous span, the part after the wrap goes in the next op
+      uint16_t             slot = _internal_emb_rb_uring_get_slot(u);
+      struct io_uring_sqe *sqe  = _internal_emb_rb_uring_sqe(u, slot);
+      if (u->mode == EMB_RB_URING_MODE_FIXED)
+      {
+         sqe->opcode    = d == EMB_RB_URING_DRAIN ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+         sqe->buf_index = 0;
+      }
+      else
+      {
+         sqe->opcode = d == EMB_RB_URING_DRAIN ? IORING_OP_WRITE : IORING_OP_READ;
+      }
+      sqe->fd   = dir->fd;
+      sqe->off  = stream ? (uint64_t)-1 : (uint64_t)dir->off;
+      sqe->addr = (uint64_t)(uintptr_t)spans[0].ptr;
+      sqe->len  = (uint32_t)spans[0].len;
+      if (stream)
+      {
+         sqe->flags = IOSQE_IO_LINK;
+      }
+      last = sqe;
+
+      emb_rb_uring_op_t *op = &u->ops[slot];
+      op->len  = (uint32_t)spans[0].len;
+      op->res  = 0;
+      op->dir  = (uint8_t)d;
+      op->done = 0;
+      dir->fifo[dir->fifo_tail++ % EMB_RB_URING_MAX_DEPTH] = slot;
+      dir->pending += spans[0].len;
+      if (!stream)
+      {
+         dir->off += (int64_t)spans[0].len;
+      }
+      u->inflight++;
+      n++;
+   }
+   // The chain ends with the last op
+   if (last)
+   {
+      last->flags &= (uint8_t)~IOSQE_IO_LINK;
+   }
+   return(n);
+}
+#endif
+
+// Initialize the backend
+int emb_rb_uring_init(emb_rb_uring_t *u, emb_rb_t *rb, uint32_t depth, uint32_t chunk, uint32_t flags)
+{
+   // Null check
+   if (!u || !rb || rb->elastic || !depth || depth > EMB_RB_URING_MAX_DEPTH)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   memset(u, 0, sizeof(*u));
+   u->rb       = rb;
+   u->depth    = depth;
+   u->chunk    = chunk ? chunk : UINT32_MAX;
+   u->ring_fd  = -1;
+   u->num_free = depth;
+   for (uint32_t i = 0; i < depth; i++)
+   {
+      u->free_slots[i] = (uint16_t)i;
+   }
+   for (int d = 0; d < 2; d++)
+   {
+      u->dir[d].fd       = -1;
+      u->dir[d].off      = -1;
+      u->dir[d].off_done = -1;
+   }
+   u->mode = EMB_RB_URING_MODE_FALLBACK;
+#ifdef EMB_RB_HAVE_URING
+   if (!(flags & EMB_RB_URING_NO_URING))
+   {
+      _internal_emb_rb_uring_setup(u, flags);
+   }
+#else
+   (void)flags;
+#endif
+   return(EMB_RB_ERR_OK);
+}
+
+// Point one direction at an fd
+static int _internal_emb_rb_uring_set(emb_rb_uring_t *u, int d, int fd, int64_t off)
+{
+   // Null check
+   if (!u || !u->rb || u->dir[d].fifo_head != u->dir[d].fifo_tail)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   emb_rb_uring_dir_t *dir = &u->dir[d];
+   dir->fd       = fd;
+   dir->off      = off < 0 ? -1 : off;
+   dir->off_done = dir->off;
+   dir->pending  = 0;
+   dir->rewind   = 0;
+   dir->eof      = 0;
+   dir->err      = 0;
+   return(EMB_RB_ERR_OK);
+}
+
+// Set the drain fd
+int emb_rb_uring_set_drain(emb_rb_uring_t *u, int fd, int64_t off)
+{
+   return(_internal_emb_rb_uring_set(u, EMB_RB_URING_DRAIN, fd, off));
+}
+
+// Set the fill fd
+int emb_rb_uring_set_fill(emb_rb_uring_t *u, int fd, int64_t off)
+{
+   return(_internal_emb_rb_uring_set(u, EMB_RB_URING_FILL, fd, off));
+}
+
+// Submit whatever is not in flight yet
+int emb_rb_uring_submit(emb_rb_uring_t *u)
+{
+   // Null check
+   if (!u || !u->rb)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+   if (u->mode == EMB_RB_URING_MODE_FALLBACK)
+   {
+      int n = _internal_emb_rb_uring_sync(u, EMB_RB_URING_DRAIN) + _internal_emb_rb_uring_sync(u, EMB_RB_URING_FILL);
+      return(u->dir[0].err || u->dir[1].err ? EMB_RB_ERR_IO : n);
+   }
+#ifdef EMB_RB_HAVE_URING
+   int n = _internal_emb_rb_uring_prep(u, EMB_RB_URING_DRAIN) + _internal_emb_rb_uring_prep(u, EMB_RB_URING_FILL);
+   if (u->to_submit && _internal_emb_rb_uring_enter(u, 0) != EMB_RB_ERR_OK)
+   {
+      return(EMB_RB_ERR_IO);
+   }
+   return(n);
+#else
+   return(0);
+#endif
+}
+
+// Process completions
+int emb_rb_uring_reap(emb_rb_uring_t *u, uint32_t wait_nr)
+{
+   int count = 0;
+
+   // Null check
+   if (!u || !u->rb)
+   {
+      return(EMB_RB_ERR_ILLEGAL_ARGS);
+   }
+#ifdef EMB_RB_HAVE_URING
+   if (u->mode != EMB_RB_URING_MODE_FALLBACK)
+   {
+      if (wait_nr > u->inflight)
+      {
+         wait_nr = u->inflight;
+      }
+      if ((u->to_submit || wait_nr) && _internal_emb_rb_uring_enter(u, wait_nr) != EMB_RB_ERR_OK)
+      {
+         return(EMB_RB_ERR_IO);
+      }
+      uint32_t head = *u->cq_head;
+      uint32_t tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+      while (head != tail)
+      {
+         struct io_uring_cqe *cqe = &((struct io_uring_cqe *)u->cqes)[head & *u->cq_mask];
+         if (cqe->user_data != EMB_RB_URING_CANCEL)
+         {
+            u->ops[cqe->user_data].res  = cqe->res;
+            u->ops[cqe->user_data].done = 1;
+            count++;
+         }
+         head++;
+      }
+      __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+   }
+#else
+   (void)wait_nr;
+#endif
+   int err_drain = _internal_emb_rb_uring_retire(u, EMB_RB_URING_DRAIN);
+   int err_fill  = _internal_emb_rb_uring_retire(u, EMB_RB_URING_FILL);
+   if (err_drain != EMB_RB_ERR_OK || err_fill != EMB_RB_ERR_OK)
+   {
+      return(EMB_RB_ERR_IO);
+   }
+   return(count);
+}
+
+// Cancel what is in flight, wait for it and release the kernel resources
+void emb_rb_uring_destroy(emb_rb_uring_t *u)
+{
+   // Null check
+   if (!u || !u->rb)
+   {
+      return;
+   }
+#ifdef EMB_RB_HAVE_URING
+   if (u->mode != EMB_RB_URING_MODE_FALLBACK)
+   {
+      // Reads from an idle pipe never complete on their own, cancel everything before waiting
+      for (int d = 0; d < 2; d++)
+      {
+         for (uint32_t i = u->dir[d].fifo_head; i != u->dir[d].fifo_tail; i++)
+         {
+            struct io_uring_sqe *sqe = _internal_emb_rb_uring_sqe(u, EMB_RB_URING_CANCEL);
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr   = u->dir[d].fifo[i % EMB_RB_URING_MAX_DEPTH];
+         }
+      }
+      while (u->inflight)
+      {
+         if (emb_rb_uring_reap(u, 1) == EMB_RB_ERR_IO && u->to_submit)
+         {
+            break;
+         }
+      }
+      _internal_emb_rb_uring_teardown(u);
+   }
+#endif
+   u->rb = NULL;
+}
@@ -0,0 +1,158 @@
+//MIT License
+//
+//Copyright (c) 2023 budgettsfrog
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+#ifndef EMB_RB_URING_H_
+#define EMB_RB_URING_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "emb_rb.h"
+
+// Most operations in flight at once, across both directions
+#define EMB_RB_URING_MAX_DEPTH    64
+
+// emb_rb_uring_init flags
+#define EMB_RB_URING_NO_URING     (1u << 0)  // always use the readv / writev fallback
+#define EMB_RB_URING_NO_FIXED     (1u << 1)  // do not register the ring storage as a fixed buffer
+
+// How the backend ended up doing I/O
+typedef enum
+{
+   EMB_RB_URING_MODE_FALLBACK = 0,  // synchronous readv / writev
+   EMB_RB_URING_MODE_PLAIN,         // io_uring read / write
+   EMB_RB_URING_MODE_FIXED          // io_uring read / write fixed on the registered ring storage
+} emb_rb_uring_mode_t;
+
+// One in flight read or write
+typedef struct
+{
+   uint32_t len;
+   int32_t  res;
+   uint8_t  dir;
+   uint8_t  done;
+} emb_rb_uring_op_t;
+
+// Per direction state, dir 0 drains the ring to an fd, dir 1 fills it from one. pending counts bytes
+// submitted but not yet completed, they sit right after the tail (drain) or head (fill).
+typedef struct
+{
+   int      fd;
+   int64_t  off;       // next file offset to submit at, -1 for pipes and sockets
+   int64_t  off_done;  // file offset of the first byte not completed yet
+   uint64_t pending;
+   uint16_t fifo[EMB_RB_URING_MAX_DEPTH];
+   uint32_t fifo_head, fifo_tail;
+   uint8_t  rewind;    // a short or failed op, later ones are discarded and resubmitted
+   uint8_t  eof;
+   int      err;
+   uint64_t bytes;
+} emb_rb_uring_dir_t;
+
+typedef struct
+{
+   emb_rb_t *          rb;
+   emb_rb_uring_mode_t mode;
+   uint32_t            depth, chunk;
+   uint32_t            inflight;
+   uint16_t            free_slots[EMB_RB_URING_MAX_DEPTH];
+   uint32_t            num_free;
+   emb_rb_uring_op_t   ops[EMB_RB_URING_MAX_DEPTH];
+   emb_rb_uring_dir_t  dir[2];
+   // io_uring state, unused in fallback mode
+   int                 ring_fd;
+   void *              sq_ptr, *cq_ptr, *sqes;
+   size_t              sq_sz, cq_sz, sqes_sz;
+   uint32_t *          sq_head, *sq_tail, *sq_mask, *sq_array;
+   uint32_t *          cq_head, *cq_tail, *cq_mask;
+   void *              cqes;
+   uint32_t            to_submit;
+} emb_rb_uring_t;
+
+/**
+ * @brief Initialize an asynchronous I/O backend for a ring. It registers the ring storage with
+ * io_uring as a fixed buffer and keeps up to depth reads / writes in flight, advancing the tail (drain)
+ * or head (fill) in order as they complete. Without io_uring it falls back to readv / writev.
+ *
+ * @param u pointer to the backend
+ * @param rb pointer to the ring buffer, not elastic
+ * @param depth maximum number of operations in flight, at most EMB_RB_URING_MAX_DEPTH
+ * @param chunk maximum size of a single read or write, 0 for no limit
+ * @param flags EMB_RB_URING_* flags
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_uring_init(emb_rb_uring_t *u, emb_rb_t *rb, uint32_t depth, uint32_t chunk, uint32_t flags);
+
+/**
+ * @brief Set the fd the ring is drained to, the backend becomes the ring's only consumer
+ *
+ * @param u pointer to the backend
+ * @param fd file descriptor to write to, -1 to stop draining
+ * @param off file offset of the first write, -1 for pipes and sockets
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_uring_set_drain(emb_rb_uring_t *u, int fd, int64_t off);
+
+/**
+ * @brief Set the fd the ring is filled from, the backend becomes the ring's only producer
+ *
+ * @param u pointer to the backend
+ * @param fd file descriptor to read from, -1 to stop filling
+ * @param off file offset of the first read, -1 for pipes and sockets
+ * @return EMB_RB_ERR_OK on success, negative error code on failure
+ */
+int emb_rb_uring_set_fill(emb_rb_uring_t *u, int fd, int64_t off);
+
+/**
+ * @brief Submit writes for queued bytes and reads into free space that are not in flight yet. Pipes
+ * and sockets get one linked chain at a time so their bytes stay in order, files are pipelined freely.
+ * In fallback mode the I/O is done right here.
+ *
+ * @param u pointer to the backend
+ * @return int number of operations submitted, negative error code on failure
+ */
+int emb_rb_uring_submit(emb_rb_uring_t *u);
+
+/**
+ * @brief Process completions, waiting for at least wait_nr of them
+ *
+ * @param u pointer to the backend
+ * @param wait_nr number of completions to wait for, 0 to only collect what is ready
+ * @return int number of completions processed, EMB_RB_ERR_IO if a read or write failed (errno in dir[].err)
+ */
+int emb_rb_uring_reap(emb_rb_uring_t *u, uint32_t wait_nr);
+
+/**
+ * @brief Destroy the backend, waits for operations in flight
+ *
+ * @param u pointer to the backend
+ */
+void emb_rb_uring_destroy(emb_rb_uring_t *u);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMB_RB_URING_H_ */
@@ -0,0 +1,287 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include "../src/emb_rb_async.hpp"
+
+// Fire and forget coroutine, the frame frees itself when the body returns
+struct detached
+{
+   struct promise_type
+   {
+      detached get_return_object()
+      {
+         return(detached{});
+      }
+      std::suspend_never initial_suspend()
+      {
+         return(std::suspend_never{});
+      }
+      std::suspend_never final_suspend() noexcept
+      {
+         return(std::suspend_never{});
+      }
+      void return_void()
+      {
+      }
+      void unhandled_exception()
+      {
+         std::terminate();
+      }
+   };
+};
+
+// Single thread executor, resumed coroutines run on its worker
+struct worker
+{
+   std::mutex                          mtx;
+   std::condition_variable             cv;
+   std::deque<std::coroutine_handle<>> q;
+   bool                                stop = false;
+   std::thread                         t;
+
+   worker() : t([this]() { run(); })
+   {
+   }
+
+   ~worker()
+   {
+      {
+         std::lock_guard<std::mutex> g(mtx);
+         stop = true;
+      }
+      cv.notify_one();
+      t.join();
+   }
+
+   void run()
+   {
+      std::unique_lock<std::mutex> g(mtx);
+      while (!stop || !q.empty())
+      {
+         if (q.empty())
+         {
+            cv.wait(g);
+            continue;
+         }
+         std::coroutine_handle<> h = q.front();
+         q.pop_front();
+         g.unlock();
+         h.resume();
+         g.lock();
+      }
+   }
+
+   static void post(void *ctx, std::coroutine_handle<> h)
+   {
+      worker *w = (worker *)ctx;
+      {
+         std::lock_guard<std::mutex> g(w->mtx);
+         w->q.push_back(h);
+      }
+      w->cv.notify_one();
+   }
+};
+
+static detached producer(emb_rb_async &ring, const uint8_t *src, uint64_t len, uint64_t chunk, bool *done)
+{
+   uint64_t off = 0;
+   while (off < len)
+   {
+      uint64_t n = std::min(chunk, len - off);
+      off += co_await ring.write(std::span<const uint8_t>(src + off, n));
+   }
+   *done = true;
+}
+
+static detached producer_mt(emb_rb_async &ring, const uint8_t *src, uint64_t len, uint64_t chunk, std::atomic<bool> *done)
+{
+   uint64_t off = 0;
+   while (off < len)
+   {
+      uint64_t n = std::min(chunk, len - off);
+      off += co_await ring.write(std::span<const uint8_t>(src + off, n));
+   }
+   done->store(true, std::memory_order_release);
+}
+
+static detached consumer(emb_rb_async &ring, uint8_t *dst, uint64_t len, std::atomic<uint64_t> *got,
+                         std::thread::id *where = nullptr)
+{
+   uint64_t off = 0;
+   while (off < len)
+   {
+      uint64_t n = co_await ring.read(dst + off, len - off);
+      if (!n && ring.closed())
+      {
+         break;
+      }
+      off += n;
+      if (where)
+      {
+         *where = std::this_thread::get_id();
+      }
+      got->store(off, std::memory_order_release);
+   }
+}
+
+class RBAsyncTesting : public ::testing::Test
+{
+public:
+   RBAsyncTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBAsyncTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure a reader and a writer on one thread hand the data over in order through a tiny ring,
+// each suspending and being resumed inline by the other
+TEST_F(RBAsyncTesting, Test_Ping_Pong)
+{
+   emb_rb_t              rb;
+   uint8_t               buf[8];
+   uint8_t               src[1000];
+   uint8_t               dst[1000];
+   std::atomic<uint64_t> got{ 0 };
+   bool                  done = false;
+
+   for (int i = 0; i < 1000; i++)
+   {
+      src[i] = (uint8_t)(i * 7);
+   }
+   memset(dst, 0, sizeof(dst));
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   emb_rb_async ring(&rb);
+
+   // The reader parks first on the empty ring, the writer then fills the ring and parks on it
+   consumer(ring, dst, sizeof(dst), &got);
+   EXPECT_EQ(got.load(), 0u);
+   producer(ring, src, sizeof(src), 13, &done);
+   EXPECT_TRUE(done);
+   EXPECT_EQ(got.load(), sizeof(dst));
+   EXPECT_EQ(memcmp(src, dst, sizeof(src)), 0);
+
+   // Closing resumes a parked reader with 0
+   got = 0;
+   consumer(ring, dst, 4, &got);
+   ring.close();
+   EXPECT_EQ(got.load(), 0u);
+
+   // and a closed ring takes no more data
+   uint8_t  one = 1;
+   uint64_t n   = 1;
+   [&]() -> detached { n = co_await ring.write(std::span<const uint8_t>(&one, 1)); }();
+   EXPECT_EQ(n, 0u);
+   EXPECT_EQ(emb_rb_used_space64(&rb), 0u);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure coroutines posted to an executor are resumed there, with a plain C producer on another thread
+TEST_F(RBAsyncTesting, Test_Executor)
+{
+   emb_rb_t              rb;
+   uint8_t               buf[64];
+   std::vector<uint8_t>  src(100000);
+   std::vector<uint8_t>  dst(100000);
+   std::atomic<uint64_t> got{ 0 };
+   std::thread::id       where;
+   std::thread::id       worker_id;
+
+   for (size_t i = 0; i < src.size(); i++)
+   {
+      src[i] = (uint8_t)(i * 31 + 5);
+   }
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   {
+      worker       w;
+      emb_rb_async ring(&rb, emb_rb_executor{ worker::post, &w });
+
+      // The reader starts here, parks on the empty ring and from then on runs on the worker
+      consumer(ring, dst.data(), dst.size(), &got, &where);
+
+      std::thread prod([&]() {
+         uint64_t off = 0;
+         while (off < src.size())
+         {
+            int      err;
+            uint64_t n = emb_rb_queue64(&rb, src.data() + off, std::min<uint64_t>(17, src.size() - off), &err);
+            off += n;
+            if (n)
+            {
+               ring.wake_readers();
+            }
+            else
+            {
+               std::this_thread::yield();
+            }
+         }
+      });
+      prod.join();
+      while (got.load(std::memory_order_acquire) < dst.size())
+      {
+         std::this_thread::yield();
+      }
+      worker_id = w.t.get_id();
+   }
+   EXPECT_EQ(where, worker_id);
+   EXPECT_EQ(memcmp(src.data(), dst.data(), src.size()), 0);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure a reader and a writer started on different threads on a ring without a lock never both park
+// and miss each other, the only ordering between them is the fences in park / wake
+TEST_F(RBAsyncTesting, Test_No_Lock_Threads)
+{
+   emb_rb_t              rb;
+   uint8_t               buf[16];
+   std::vector<uint8_t>  src(1 << 20);
+   std::vector<uint8_t>  dst(1 << 20);
+   std::atomic<uint64_t> got{ 0 };
+   std::atomic<bool>     done{ false };
+   emb_rb_lock_cfg_t     cfg = { EMB_RB_LOCK_NONE, 0, NULL, NULL, NULL, NULL, 0, 0 };
+
+   for (size_t i = 0; i < src.size(); i++)
+   {
+      src[i] = (uint8_t)(i * 13 + 1);
+   }
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+   emb_rb_async ring(&rb);
+
+   std::thread reader([&]() { consumer(ring, dst.data(), dst.size(), &got); });
+   std::thread writer([&]() { producer_mt(ring, src.data(), src.size(), 7, &done); });
+   reader.join();
+   writer.join();
+
+   // A lost wakeup leaves both parked, close them out instead of hanging
+   auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+   while ((got.load(std::memory_order_acquire) < dst.size() || !done.load(std::memory_order_acquire)) &&
+          std::chrono::steady_clock::now() < deadline)
+   {
+      std::this_thread::yield();
+   }
+   bool finished = got.load() == dst.size() && done.load();
+   if (!finished)
+   {
+      ring.close();
+   }
+   ASSERT_TRUE(finished);
+   EXPECT_EQ(memcmp(src.data(), dst.data(), src.size()), 0);
+   emb_rb_destroy(&rb);
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include "../src/emb_rb_bcast.h"
+
+class RBBcastTesting : public ::testing::Test
+{
+public:
+   RBBcastTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBBcastTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure that every consumer sees the full stream and space is held by the slowest one
+TEST_F(RBBcastTesting, Test_Bcast_Fan_Out)
+{
+   emb_rb_bcast_t bc;
+   uint8_t        buf[10];
+   uint8_t        data[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+   uint8_t        rd[10];
+   int            err;
+
+   ASSERT_EQ(emb_rb_bcast_init(&bc, 0, 10, 0), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_bcast_init(&bc, buf, 10, 0), EMB_RB_ERR_OK);
+   int a = emb_rb_bcast_add_consumer(&bc);
+   int b = emb_rb_bcast_add_consumer(&bc);
+   ASSERT_GE(a, 0);
+   ASSERT_GE(b, 0);
+   ASSERT_NE(a, b);
+
+   ASSERT_EQ(emb_rb_bcast_queue(&bc, data, 7, &err), 7);
+   ASSERT_EQ(emb_rb_bcast_free_space(&bc), 3);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, a, rd, 7, &err), 7);
+   ASSERT_EQ(memcmp(data, rd, 7), 0);
+
+   // b still holds all 7 bytes
+   ASSERT_EQ(emb_rb_bcast_free_space(&bc), 3);
+   ASSERT_EQ(emb_rb_bcast_queue(&bc, data + 7, 3, &err), 3);
+   ASSERT_EQ(emb_rb_bcast_queue(&bc, data, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_FULL);
+   ASSERT_EQ(emb_rb_bcast_peek(&bc, b, 5, rd, 10), 5);
+   ASSERT_EQ(memcmp(data + 5, rd, 5), 0);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, b, rd, 4, &err), 4);
+   ASSERT_EQ(emb_rb_bcast_free_space(&bc), 4);
+
+   // Wrap the storage and read it back through both cursors
+   ASSERT_EQ(emb_rb_bcast_queue(&bc, data, 4, &err), 4);
+   ASSERT_EQ(emb_rb_bcast_used_space(&bc, a), 7);
+   ASSERT_EQ(emb_rb_bcast_used_space(&bc, b), 10);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, a, rd, 10, &err), 7);
+   uint8_t expect_a[7] = { 7, 8, 9, 0, 1, 2, 3 };
+   ASSERT_EQ(memcmp(expect_a, rd, 7), 0);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, b, rd, 10, &err), 10);
+   uint8_t expect_b[10] = { 4, 5, 6, 7, 8, 9, 0, 1, 2, 3 };
+   ASSERT_EQ(memcmp(expect_b, rd, 10), 0);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, b, rd, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+   ASSERT_EQ(emb_rb_bcast_free_space(&bc), 10);
+   emb_rb_bcast_destroy(&bc);
+}
+
+// Ensure that slow consumers get dropped instead of stalling the producer when asked to
+TEST_F(RBBcastTesting, Test_Bcast_Drop_Slow)
+{
+   emb_rb_bcast_t bc;
+   uint8_t        buf[8];
+   uint8_t        data[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+   uint8_t        rd[8];
+   int            err;
+
+   ASSERT_EQ(emb_rb_bcast_init(&bc, buf, 8, 1), EMB_RB_ERR_OK);
+   int fast = emb_rb_bcast_add_consumer(&bc);
+   int slow = emb_rb_bcast_add_consumer(&bc);
+   ASSERT_EQ(emb_rb_bcast_queue(&bc, data, 6, &err), 6);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, fast, rd, 6, &err), 6);
+   ASSERT_EQ(emb_rb_bcast_queue(&bc, data, 6, &err), 6);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(bc.drops, 1);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, slow, rd, 6, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_DROPPED);
+   ASSERT_EQ(emb_rb_bcast_dequeue(&bc, fast, rd, 8, &err), 6);
+   ASSERT_EQ(memcmp(data, rd, 6), 0);
+
+   // A dropped slot has to be removed before it can be reused
+   ASSERT_EQ(emb_rb_bcast_remove_consumer(&bc, slow), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_bcast_add_consumer(&bc), slow);
+   ASSERT_EQ(emb_rb_bcast_used_space(&bc, slow), 0);
+   ASSERT_EQ(emb_rb_bcast_remove_consumer(&bc, EMB_RB_BCAST_MAX_CONSUMERS), EMB_RB_ERR_ILLEGAL_ARGS);
+   emb_rb_bcast_destroy(&bc);
+}
+
+// Ensure consumers on their own threads each see the whole stream in order while the producer gates
+// on the slowest cursor
+TEST_F(RBBcastTesting, Test_Bcast_Threads)
+{
+   emb_rb_bcast_t    bc;
+   uint8_t           buf[64];
+   const uint32_t    total = 200000;
+   std::atomic<bool> ok[2];
+
+   ASSERT_EQ(emb_rb_bcast_init(&bc, buf, sizeof(buf), 0), EMB_RB_ERR_OK);
+   int ids[2] = { emb_rb_bcast_add_consumer(&bc), emb_rb_bcast_add_consumer(&bc) };
+   std::thread consumers[2];
+   for (int c = 0; c < 2; c++)
+   {
+      ok[c] = true;
+      consumers[c] = std::thread([&, c]() {
+         uint8_t  rd[16];
+         uint32_t seen = 0;
+         while (seen < total)
+         {
+            uint32_t n = emb_rb_bcast_dequeue(&bc, ids[c], rd, (uint32_t)sizeof(rd), NULL);
+            for (uint32_t i = 0; i < n; i++, seen++)
+            {
+               if (rd[i] != (uint8_t)(seen * 7))
+               {
+                  ok[c] = false;
+               }
+            }
+            if (!n)
+            {
+               std::this_thread::yield();
+            }
+         }
+      });
+   }
+   uint32_t sent = 0;
+   while (sent < total)
+   {
+      uint8_t  wr[13];
+      uint32_t len = total - sent < sizeof(wr) ? total - sent : (uint32_t)sizeof(wr);
+      for (uint32_t i = 0; i < len; i++)
+      {
+         wr[i] = (uint8_t)((sent + i) * 7);
+      }
+      uint32_t n = emb_rb_bcast_queue(&bc, wr, len, NULL);
+      sent += n;
+      if (!n)
+      {
+         std::this_thread::yield();
+      }
+   }
+   consumers[0].join();
+   consumers[1].join();
+   EXPECT_TRUE(ok[0]);
+   EXPECT_TRUE(ok[1]);
+   EXPECT_EQ(emb_rb_bcast_free_space(&bc), sizeof(buf));
+   emb_rb_bcast_destroy(&bc);
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/emb_rb_desc.h"
+
+class RBDescTesting : public ::testing::Test
+{
+public:
+   RBDescTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+      released       = 0;
+      released_bytes = 0;
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBDescTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+
+   static void release(void *ctx, const uint8_t *ptr, uint64_t len)
+   {
+      (void)ctx;
+      (void)ptr;
+      released++;
+      released_bytes += len;
+   }
+
+   static int      released;
+   static uint64_t released_bytes;
+};
+
+int      RBDescTesting::released;
+uint64_t RBDescTesting::released_bytes;
+
+// Ensure that buffers are handed over by reference and released once consumed
+TEST_F(RBDescTesting, Test_Desc_Consume)
+{
+   emb_rb_desc_ring_t dr;
+   emb_rb_desc_t      slots[4];
+   emb_rb_desc_t      out[4];
+   struct iovec       iov[4];
+   uint8_t            a[10], b[20], c[30];
+   uint64_t           offset;
+
+   ASSERT_EQ(emb_rb_desc_init(&dr, slots, 0), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_desc_init(&dr, slots, 4), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_push(&dr, a, sizeof(a), release, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_push(&dr, b, sizeof(b), release, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_push(&dr, c, sizeof(c), release, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_push(&dr, a, sizeof(a), release, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_push(&dr, a, sizeof(a), release, NULL), EMB_RB_ERR_BUFFER_FULL);
+   ASSERT_EQ(emb_rb_desc_used(&dr), 4);
+   ASSERT_EQ(emb_rb_desc_bytes(&dr), 70);
+
+   // A partial consume keeps the first descriptor and trims its iovec
+   ASSERT_EQ(emb_rb_desc_consume(&dr, 4), 4);
+   ASSERT_EQ(released, 0);
+   ASSERT_EQ(emb_rb_desc_iov(&dr, iov, 2), 2);
+   ASSERT_EQ(iov[0].iov_base, (void *)(a + 4));
+   ASSERT_EQ(iov[0].iov_len, 6);
+   ASSERT_EQ(iov[1].iov_base, (void *)b);
+
+   // Consuming past descriptor ends releases them
+   ASSERT_EQ(emb_rb_desc_consume(&dr, 36), 36);
+   ASSERT_EQ(released, 2);
+   ASSERT_EQ(released_bytes, 30);
+   ASSERT_EQ(emb_rb_desc_bytes(&dr), 30);
+
+   // Popping hands ownership over with the consumed offset
+   ASSERT_EQ(emb_rb_desc_pop_n(&dr, out, 1, &offset), 1);
+   ASSERT_EQ(out[0].ptr, c);
+   ASSERT_EQ(offset, 10);
+   ASSERT_EQ(emb_rb_desc_bytes(&dr), 10);
+   emb_rb_desc_release(out, 1);
+   ASSERT_EQ(released, 3);
+
+   // Destroy releases what is left
+   emb_rb_desc_destroy(&dr);
+   ASSERT_EQ(released, 4);
+}
+
+// Ensure that scatter output writes straight from the caller buffers
+TEST_F(RBDescTesting, Test_Desc_Write_Fd)
+{
+   emb_rb_desc_ring_t dr;
+   emb_rb_desc_t      slots[4];
+   const uint8_t      a[] = "hello ";
+   const uint8_t      b[] = "world";
+   char               rd[16] = { 0 };
+   int                fds[2];
+   int                err;
+
+   ASSERT_EQ(pipe(fds), 0);
+   ASSERT_EQ(emb_rb_desc_init(&dr, slots, 4), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_write_fd(&dr, fds[1], &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+   ASSERT_EQ(emb_rb_desc_push(&dr, a, 6, release, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_push(&dr, b, 5, release, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_desc_write_fd(&dr, fds[1], &err), 11);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(released, 2);
+   ASSERT_EQ(read(fds[0], rd, sizeof(rd)), 11);
+   ASSERT_STREQ(rd, "hello world");
+   ASSERT_EQ(emb_rb_desc_write_fd(&dr, -1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+   close(fds[0]);
+   close(fds[1]);
+   emb_rb_desc_destroy(&dr);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
+#include "../src/emb_rb_drain.h"
+
+class RBDrainTesting : public ::testing::Test
+{
+public:
+   RBDrainTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBDrainTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure that emb_rb_write_fd writes across the wrap and consumes only what was written
+TEST_F(RBDrainTesting, Test_Write_Fd)
+{
+   emb_rb_t rb;
+   uint8_t  buf[8];
+   char     rd[16] = { 0 };
+   int      fds[2];
+   int      err;
+
+   ASSERT_EQ(pipe(fds), 0);
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_write_fd(&rb, fds[1], 8, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+   ASSERT_EQ(emb_rb_queue(&rb, (const uint8_t *)"xxxxxx", 6, NULL), 6);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 6), 6);
+   ASSERT_EQ(emb_rb_queue(&rb, (const uint8_t *)"abcdef", 6, NULL), 6);
+   ASSERT_EQ(emb_rb_write_fd(&rb, fds[1], 4, &err), 4);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_write_fd(&rb, fds[1], 8, &err), 2);
+   ASSERT_EQ(emb_rb_used_space(&rb), 0);
+   ASSERT_EQ(read(fds[0], rd, sizeof(rd)), 6);
+   ASSERT_STREQ(rd, "abcdef");
+   emb_rb_destroy(&rb);
+
+   // Rings set up for unlocked copies write outside the lock and drop the reservation afterwards
+   emb_rb_lock_cfg_t cfg = { EMB_RB_LOCK_MUTEX, 0, NULL, NULL, NULL, NULL, 0, 1 };
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, (const uint8_t *)"xxxxxx", 6, NULL), 6);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 6), 6);
+   ASSERT_EQ(emb_rb_queue(&rb, (const uint8_t *)"ghijkl", 6, NULL), 6);
+   ASSERT_EQ(emb_rb_write_fd(&rb, fds[1], 8, &err), 6);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_used_space(&rb), 0);
+   ASSERT_EQ(rb.tail_pend, 0);
+   ASSERT_EQ(rb.copying, 0);
+   memset(rd, 0, sizeof(rd));
+   ASSERT_EQ(read(fds[0], rd, sizeof(rd)), 6);
+   ASSERT_STREQ(rd, "ghijkl");
+   close(fds[0]);
+   close(fds[1]);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that the drainer batches, flushes on timeout and drains the rest on stop
+TEST_F(RBDrainTesting, Test_Drain_Thread)
+{
+   emb_rb_t             rb;
+   emb_rb_drain_t       d;
+   emb_rb_drain_stats_t stats;
+   uint8_t              buf[256];
+   uint8_t              data[64];
+   uint8_t              rd[1024];
+   int                  fds[2];
+
+   for (int i = 0; i < (int)sizeof(data); i++)
+   {
+      data[i] = (uint8_t)i;
+   }
+   ASSERT_EQ(pipe(fds), 0);
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_drain_start(&d, &rb, fds[1], 0, 0, 1000000), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_drain_start(&d, &rb, fds[1], 32, 0, 5000000), EMB_RB_ERR_OK);
+
+   // A small write goes out on the timeout
+   ASSERT_EQ(emb_rb_queue(&rb, data, 4, NULL), 4);
+   ASSERT_EQ(read(fds[0], rd, sizeof(rd)), 4);
+   ASSERT_EQ(emb_rb_drain_stats(&d, &stats), EMB_RB_ERR_OK);
+   ASSERT_EQ(stats.timeouts, 1);
+
+   // Larger writes go out as batches, the rest on stop. The drainer holds the lock now and then and
+   // the ring fills up, so retry until everything is in.
+   uint64_t sent = 4;
+   auto queue_all = [&](uint32_t len) {
+      uint32_t n = 0;
+      while ((n += emb_rb_queue(&rb, data + n, len - n, NULL)) < len)
+      {
+         std::this_thread::yield();
+      }
+      sent += len;
+   };
+   for (int i = 0; i < 10; i++)
+   {
+      queue_all(sizeof(data));
+   }
+   queue_all(3);
+   ASSERT_EQ(emb_rb_drain_stop(&d), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_used_space(&rb), 0);
+   ASSERT_EQ(emb_rb_drain_stats(&d, &stats), EMB_RB_ERR_OK);
+   ASSERT_EQ(stats.bytes, sent);
+   ASSERT_GE(stats.writes, 2);
+   // The pipe never fills up, so no write stalled
+   ASSERT_EQ(stats.stall_ns, 0);
+
+   uint64_t got = 0;
+   while (got < sent - 4)
+   {
+      ssize_t n = read(fds[0], rd, sizeof(rd));
+      ASSERT_GT(n, 0);
+      got += n;
+   }
+   ASSERT_EQ(got, sent - 4);
+   close(fds[0]);
+   close(fds[1]);
+   emb_rb_destroy(&rb);
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#define EMB_RB_INLINE
+#include "../src/emb_rb.h"
+
+class RBInlineTesting : public ::testing::Test
+{
+public:
+   RBInlineTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBInlineTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure that the inline fast paths behave like the out of line functions, including the wrap
+TEST_F(RBInlineTesting, Test_Inline_Queue_Dequeue)
+{
+   emb_rb_t rb;
+   uint8_t  buf[10];
+   uint8_t  data[32];
+   uint8_t  rd[32];
+   int      err;
+
+   for (int i = 0; i < 32; i++)
+   {
+      data[i] = (uint8_t)i;
+   }
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, 0, 4, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_queue_single(0, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+
+   for (int round = 0; round < 5; round++)
+   {
+      ASSERT_EQ(emb_rb_queue(&rb, data, 7, &err), 7);
+      ASSERT_EQ(err, EMB_RB_ERR_OK);
+      ASSERT_EQ(emb_rb_queue_single(&rb, 7, &err), 1);
+      ASSERT_EQ(emb_rb_queue(&rb, data + 8, 7, &err), 2);
+      ASSERT_EQ(emb_rb_queue_single(&rb, 0, &err), 0);
+      ASSERT_EQ(err, EMB_RB_ERR_BUFFER_FULL);
+      ASSERT_EQ(emb_rb_dequeue(&rb, rd, 3, &err), 3);
+      ASSERT_EQ(emb_rb_dequeue(&rb, rd + 3, 16, &err), 7);
+      ASSERT_EQ(memcmp(data, rd, 10), 0);
+      ASSERT_EQ(emb_rb_dequeue(&rb, rd, 1, &err), 0);
+      ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+      ASSERT_EQ(emb_rb_queue_single(&rb, 0, NULL), 1);
+      ASSERT_EQ(emb_rb_dequeue(&rb, rd, 1, NULL), 1);
+   }
+
+   // Large copies take the out of line path, same results
+   uint8_t big_buf[64];
+   emb_rb_t big;
+   ASSERT_EQ(emb_rb_init(&big, big_buf, sizeof(big_buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&big, data, 32, &err), 32);
+   ASSERT_EQ(emb_rb_dequeue(&big, rd, 32, &err), 32);
+   ASSERT_EQ(memcmp(data, rd, 32), 0);
+
+   // Lock contention is reported the same way
+   emb_rb_lock_acquire(&rb.lock);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 4, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_LOCK);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 4, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_LOCK);
+   emb_rb_lock_release(&rb.lock);
+   emb_rb_destroy(&big);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that elastic rings still grow through the inline entry points
+TEST_F(RBInlineTesting, Test_Inline_Elastic_Fallback)
+{
+   emb_rb_t         rb;
+   emb_rb_elastic_t el;
+   uint8_t          data[8] = { 0 };
+
+   ASSERT_EQ(emb_rb_elastic_init(&rb, &el, 4, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 8, NULL), 8);
+   ASSERT_EQ(emb_rb_queue_single(&rb, 1, NULL), 1);
+   ASSERT_EQ(emb_rb_size(&rb, NULL), 16);
+   emb_rb_destroy(&rb);
+}
@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include "../src/emb_rb_log.h"
+
+class RBLogTesting : public ::testing::Test
+{
+public:
+   RBLogTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBLogTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure records decode to exactly what snprintf makes of the same format and arguments
+TEST_F(RBLogTesting, Test_Log_Format)
+{
+   emb_rb_t         rb;
+   uint8_t          buf[1024];
+   emb_rb_log_fmt_t fmts[4];
+   emb_rb_log_t     log;
+   uint16_t         id[4];
+   char             out[256];
+   char             ref[256];
+   int              err;
+   int              x = 42;
+   const char *     f0 = "rx %u bytes on port %hhx, 100%% ok";
+   const char *     f1 = "[%-8s] %5.2f %+lld %zu %c|";
+   const char *     f2 = "%p %Lf %ld %jd %td %s";
+   const char *     f3 = "no args";
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_init(&log, &rb, fmts, 4), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_register(&log, f0, &id[0]), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_register(&log, f1, &id[1]), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_register(&log, f2, &id[2]), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_register(&log, f3, &id[3]), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_log_register(&log, f3, &id[3]), EMB_RB_ERR_NO_MEM);
+
+   EXPECT_EQ(emb_rb_log_write(&log, id[0], 1500u, 0x1ff), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_log_write(&log, id[1], "eth0", 3.14159, -7ll, (size_t)99, 'z'), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_log_write(&log, id[2], (void *)&x, 2.5L, -123456789l, (intmax_t)-5, (ptrdiff_t)17, (const char *)NULL), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_log_write(&log, id[3]), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_log_write(&log, 4), EMB_RB_ERR_ILLEGAL_ARGS);
+
+   snprintf(ref, sizeof(ref), f0, 1500u, (unsigned char)0x1ff);
+   EXPECT_EQ(emb_rb_log_next(&log, out, sizeof(out), &err), (int)strlen(ref));
+   EXPECT_EQ(err, EMB_RB_ERR_OK);
+   EXPECT_STREQ(out, ref);
+   snprintf(ref, sizeof(ref), f1, "eth0", 3.14159, -7ll, (size_t)99, 'z');
+   emb_rb_log_next(&log, out, sizeof(out), &err);
+   EXPECT_STREQ(out, ref);
+   snprintf(ref, sizeof(ref), f2, (void *)&x, 2.5L, -123456789l, (intmax_t)-5, (ptrdiff_t)17, "");
+   emb_rb_log_next(&log, out, sizeof(out), &err);
+   EXPECT_STREQ(out, ref);
+
+   // A short output buffer truncates like snprintf and still reports the full length
+   EXPECT_EQ(emb_rb_log_next(&log, out, 4, &err), 7);
+   EXPECT_STREQ(out, "no ");
+   EXPECT_EQ(emb_rb_log_next(&log, out, sizeof(out), &err), 0);
+   EXPECT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure full rings drop whole records, long strings are truncated and a second table decodes a
+// dump of the ring offline
+TEST_F(RBLogTesting, Test_Log_Drop_Decode)
+{
+   emb_rb_t         rb;
+   uint8_t          buf[64];
+   emb_rb_log_fmt_t fmts[2];
+   emb_rb_log_fmt_t offline_fmts[2];
+   emb_rb_log_t     log;
+   emb_rb_log_t     offline;
+   uint16_t         id, big;
+   uint8_t          rec[EMB_RB_LOG_RECORD_MAX];
+   char             out[512];
+   int              err;
+   std::string      longstr(1000, 'a');
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_init(&log, &rb, fmts, 2), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_log_register(&log, "%n", &id), EMB_RB_ERR_ILLEGAL_ARGS);
+   EXPECT_EQ(emb_rb_log_register(&log, "%*d", &id), EMB_RB_ERR_ILLEGAL_ARGS);
+   EXPECT_EQ(emb_rb_log_register(&log, "%d%d%d%d%d%d%d%d%d", &id), EMB_RB_ERR_ILLEGAL_ARGS);
+   EXPECT_EQ(emb_rb_log_register(&log, "trailing %", &id), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_log_register(&log, "seq %d", &id), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_register(&log, "%s %d", &big), EMB_RB_ERR_OK);
+
+   // 8 byte records, 8 fit and the rest are dropped whole
+   for (int i = 0; i < 10; i++)
+   {
+      EXPECT_EQ(emb_rb_log_write(&log, id, i), i < 8 ? EMB_RB_ERR_OK : EMB_RB_ERR_BUFFER_FULL);
+   }
+   EXPECT_EQ(emb_rb_log_dropped(&log), 2u);
+   EXPECT_EQ(emb_rb_queue_record(&rb, rec, 1, &err), 0u);
+   EXPECT_EQ(err, EMB_RB_ERR_BUFFER_FULL);
+
+   // Dump the ring, then decode the dump with a table registered in the same order
+   uint8_t dump[64];
+   ASSERT_EQ(emb_rb_dequeue(&rb, dump, sizeof(dump), &err), 64u);
+   ASSERT_EQ(emb_rb_log_init(&offline, NULL, offline_fmts, 2), EMB_RB_ERR_OK);
+   emb_rb_log_register(&offline, "seq %d", &id);
+   emb_rb_log_register(&offline, "%s %d", &big);
+   for (int i = 0; i < 8; i++)
+   {
+      char ref[16];
+      snprintf(ref, sizeof(ref), "seq %d", i);
+      EXPECT_EQ(emb_rb_log_decode(&offline, dump + i * 8, 8, out, sizeof(out)), (int)strlen(ref));
+      EXPECT_STREQ(out, ref);
+   }
+   EXPECT_EQ(emb_rb_log_decode(&offline, dump, 7, out, sizeof(out)), EMB_RB_ERR_ILLEGAL_ARGS);
+
+   // Long strings are cut so the record, header and trailing int included, is EMB_RB_LOG_RECORD_MAX
+   uint8_t          large[512];
+   emb_rb_t         rb2;
+   emb_rb_log_t     log2;
+   emb_rb_log_fmt_t fmts2[1];
+   ASSERT_EQ(emb_rb_init(&rb2, large, sizeof(large)), EMB_RB_ERR_OK);
+   emb_rb_log_init(&log2, &rb2, fmts2, 1);
+   emb_rb_log_register(&log2, "%s %d", &big);
+   EXPECT_EQ(emb_rb_log_write(&log2, big, longstr.c_str(), 77), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_used_space(&rb2), (uint32_t)EMB_RB_LOG_RECORD_MAX);
+   std::string ref = longstr.substr(0, EMB_RB_LOG_RECORD_MAX - EMB_RB_LOG_HDR_LEN - 2 - sizeof(int)) + " 77";
+   emb_rb_log_next(&log2, out, sizeof(out), &err);
+   EXPECT_EQ(err, EMB_RB_ERR_OK);
+   EXPECT_STREQ(out, ref.c_str());
+
+   // A corrupt length is reported once and the ring starts over clean
+   const uint8_t junk[6] = { 0xff, 0xff, 0, 0, 1, 2 };
+   ASSERT_EQ(emb_rb_queue(&rb2, junk, sizeof(junk), NULL), sizeof(junk));
+   EXPECT_EQ(emb_rb_log_next(&log2, out, sizeof(out), &err), 0);
+   EXPECT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+   EXPECT_EQ(emb_rb_used_space(&rb2), 0u);
+   EXPECT_EQ(emb_rb_log_write(&log2, big, "ok", 1), EMB_RB_ERR_OK);
+   emb_rb_log_next(&log2, out, sizeof(out), &err);
+   EXPECT_EQ(err, EMB_RB_ERR_OK);
+   EXPECT_STREQ(out, "ok 1");
+   emb_rb_destroy(&rb2);
+   emb_rb_destroy(&rb);
+}
+
+static void log_cb_lock(void *ctx)
+{
+   (void)ctx;
+}
+
+static int log_cb_trylock(void *ctx)
+{
+   (void)ctx;
+   return(0);
+}
+
+static void log_cb_unlock(void *ctx)
+{
+   (void)ctx;
+}
+
+// Ensure a lock that never frees up drops the record instead of spinning forever
+TEST_F(RBLogTesting, Test_Log_Lock_Drop)
+{
+   emb_rb_t          rb;
+   uint8_t           buf[64];
+   emb_rb_log_fmt_t  fmts[1];
+   emb_rb_log_t      log;
+   uint16_t          id;
+   emb_rb_lock_cfg_t cfg = { EMB_RB_LOCK_CALLBACK, 0, log_cb_lock, log_cb_trylock, log_cb_unlock, NULL, 0, 0 };
+
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_init(&log, &rb, fmts, 1), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_log_register(&log, "seq %d", &id), EMB_RB_ERR_OK);
+   EXPECT_EQ(emb_rb_log_write(&log, id, 1), EMB_RB_ERR_LOCK);
+   EXPECT_EQ(emb_rb_log_dropped(&log), 1u);
+   EXPECT_EQ(emb_rb_used_space(&rb), 0u);
+   emb_rb_destroy(&rb);
+}
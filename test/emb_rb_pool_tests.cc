@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include "../src/emb_rb_pool.h"
+
+class RBPoolTesting : public ::testing::Test
+{
+public:
+   RBPoolTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBPoolTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure that the pool rejects bad class tables
+TEST_F(RBPoolTesting, Test_Pool_Null_Init)
+{
+   emb_rb_pool_t       pool;
+   emb_rb_pool_class_t unsorted[2] = { { 64, 4 }, { 32, 4 } };
+   emb_rb_pool_class_t empty[1]    = { { 64, 0 } };
+
+   ASSERT_EQ(emb_rb_pool_init(0, unsorted, 2), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_pool_init(&pool, 0, 2), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_pool_init(&pool, unsorted, 0), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_pool_init(&pool, unsorted, 2), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_pool_init(&pool, empty, 1), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_pool_init(&pool, unsorted, EMB_RB_POOL_MAX_CLASSES + 1), EMB_RB_ERR_ILLEGAL_ARGS);
+}
+
+// Ensure that acquire picks the smallest fitting class and spills into larger ones
+TEST_F(RBPoolTesting, Test_Pool_Acquire_Classes)
+{
+   emb_rb_pool_t       pool;
+   emb_rb_pool_class_t classes[2] = { { 32, 2 }, { 128, 1 } };
+   int                 err;
+
+   ASSERT_EQ(emb_rb_pool_init(&pool, classes, 2), EMB_RB_ERR_OK);
+   emb_rb_t *a = emb_rb_pool_acquire(&pool, 16, &err);
+   ASSERT_TRUE(a != NULL);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_size(a, NULL), 32);
+   emb_rb_t *b = emb_rb_pool_acquire(&pool, 32, &err);
+   ASSERT_TRUE(b != NULL);
+   ASSERT_EQ(emb_rb_pool_available(&pool, 0), 0);
+
+   // Small class is gone, should spill into the big one
+   emb_rb_t *c = emb_rb_pool_acquire(&pool, 1, &err);
+   ASSERT_TRUE(c != NULL);
+   ASSERT_EQ(emb_rb_size(c, NULL), 128);
+
+   // Everything is handed out now
+   ASSERT_TRUE(emb_rb_pool_acquire(&pool, 1, &err) == NULL);
+   ASSERT_EQ(err, EMB_RB_ERR_NO_MEM);
+   ASSERT_TRUE(emb_rb_pool_acquire(&pool, 129, &err) == NULL);
+   ASSERT_EQ(err, EMB_RB_ERR_NO_MEM);
+
+   ASSERT_EQ(emb_rb_pool_release(&pool, a), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_pool_release(&pool, b), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_pool_release(&pool, c), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_pool_available(&pool, 0), 2);
+   ASSERT_EQ(emb_rb_pool_available(&pool, 1), 1);
+   emb_rb_pool_destroy(&pool);
+}
+
+// Ensure that released rings come back empty and that bad releases are caught
+TEST_F(RBPoolTesting, Test_Pool_Release_Reuse)
+{
+   emb_rb_pool_t       pool;
+   emb_rb_pool_class_t classes[1] = { { 16, 1 } };
+   emb_rb_t            foreign;
+   uint8_t             buf[16];
+   uint8_t             data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+   ASSERT_EQ(emb_rb_pool_init(&pool, classes, 1), EMB_RB_ERR_OK);
+   emb_rb_t *rb = emb_rb_pool_acquire(&pool, 16, NULL);
+   ASSERT_TRUE(rb != NULL);
+   emb_rb_watermark_t wm;
+   ASSERT_EQ(emb_rb_watermark_init(rb, &wm, 12, 4, NULL, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(rb, data, 8, NULL), 8);
+   // A pointer into the middle of a slot is rejected without touching the ring
+   ASSERT_EQ(emb_rb_pool_release(&pool, (emb_rb_t *)((uint8_t *)rb + 1)), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_used_space(rb), 8);
+   ASSERT_EQ(emb_rb_pool_release(&pool, rb), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_pool_release(&pool, rb), EMB_RB_ERR_ILLEGAL_ARGS);
+
+   // Same control block comes back, empty and with nothing attached
+   emb_rb_t *again = emb_rb_pool_acquire(&pool, 16, NULL);
+   ASSERT_EQ(again, rb);
+   ASSERT_TRUE(again->wm == NULL);
+   ASSERT_EQ(emb_rb_used_space(again), 0);
+   ASSERT_EQ(emb_rb_free_space(again), 16);
+
+   // An owner that switched the lock config gets the default mutex back on release
+   uint8_t *         storage = again->bP;
+   emb_rb_lock_cfg_t cfg     = { EMB_RB_LOCK_SPIN, 1, NULL, NULL, NULL, NULL, 0, 0 };
+   ASSERT_EQ(emb_rb_init_ex(again, storage, 16, &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_pool_release(&pool, again), EMB_RB_ERR_OK);
+   again = emb_rb_pool_acquire(&pool, 16, NULL);
+   ASSERT_EQ(again->lock.policy, EMB_RB_LOCK_MUTEX);
+   ASSERT_EQ(again->lock.blocking, 0);
+   ASSERT_EQ(again->bP, storage);
+   ASSERT_EQ(emb_rb_queue(again, data, 8, NULL), 8);
+   ASSERT_EQ(emb_rb_pool_release(&pool, again), EMB_RB_ERR_OK);
+
+   // Rings that did not come from the pool are rejected
+   ASSERT_EQ(emb_rb_init(&foreign, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_pool_release(&pool, &foreign), EMB_RB_ERR_ILLEGAL_ARGS);
+   emb_rb_destroy(&foreign);
+   emb_rb_pool_destroy(&pool);
+}
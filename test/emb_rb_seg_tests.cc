@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include "../src/emb_rb_seg.h"
+
+class RBSegTesting : public ::testing::Test
+{
+public:
+   RBSegTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBSegTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure that the segmented queue null checks pass
+TEST_F(RBSegTesting, Test_Seg_Null)
+{
+   emb_rb_seg_t seg;
+   uint8_t      data[4];
+
+   ASSERT_EQ(emb_rb_seg_init(0, 16, 1), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_seg_init(&seg, 0, 1), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_seg_init(&seg, 16, 1), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_seg_queue(&seg, 0, 4, NULL), 0);
+   ASSERT_EQ(emb_rb_seg_queue(&seg, data, 0, NULL), 0);
+   ASSERT_EQ(emb_rb_seg_dequeue(&seg, 0, 4, NULL), 0);
+   ASSERT_EQ(emb_rb_seg_peek(&seg, 0, 0, 4), 0);
+   ASSERT_EQ(emb_rb_seg_used_space(0), 0);
+   emb_rb_seg_destroy(&seg);
+}
+
+// Ensure that data spanning many chunks comes out in order, and that chunk storage never moves
+TEST_F(RBSegTesting, Test_Seg_Queue_Dequeue)
+{
+   emb_rb_seg_t seg;
+   uint8_t      data[100];
+   uint8_t      rd[100];
+   int          err;
+
+   for (int i = 0; i < 100; i++)
+   {
+      data[i] = (uint8_t)i;
+   }
+   ASSERT_EQ(emb_rb_seg_init(&seg, 16, 2), EMB_RB_ERR_OK);
+   uint8_t *first = seg.head->rb.bP;
+   ASSERT_EQ(emb_rb_seg_queue(&seg, data, 10, &err), 10);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_seg_queue(&seg, data + 10, 90, &err), 90);
+   ASSERT_EQ(seg.tail->rb.bP, first);
+   ASSERT_EQ(emb_rb_seg_used_space(&seg), 100);
+
+   // Peek across chunk boundaries
+   ASSERT_EQ(emb_rb_seg_peek(&seg, 14, rd, 20), 20);
+   ASSERT_EQ(memcmp(data + 14, rd, 20), 0);
+   ASSERT_EQ(emb_rb_seg_peek(&seg, 90, rd, 20), 10);
+   ASSERT_EQ(memcmp(data + 90, rd, 10), 0);
+   ASSERT_EQ(emb_rb_seg_peek(&seg, 101, rd, 1), 0);
+
+   ASSERT_EQ(emb_rb_seg_dequeue(&seg, rd, 37, &err), 37);
+   ASSERT_EQ(memcmp(data, rd, 37), 0);
+   ASSERT_EQ(seg.num_free, 2);
+   ASSERT_EQ(emb_rb_seg_dequeue(&seg, rd, 100, &err), 63);
+   ASSERT_EQ(memcmp(data + 37, rd, 63), 0);
+   ASSERT_EQ(emb_rb_seg_used_space(&seg), 0);
+   ASSERT_EQ(emb_rb_seg_dequeue(&seg, rd, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+
+   // Capacity comes back from the free list
+   ASSERT_EQ(emb_rb_seg_queue(&seg, data, 40, &err), 40);
+   ASSERT_EQ(seg.num_free, 0);
+   ASSERT_EQ(emb_rb_seg_flush(&seg), -1);
+   ASSERT_EQ(emb_rb_seg_used_space(&seg), 0);
+   ASSERT_EQ(seg.num_free, 2);
+   ASSERT_EQ(seg.head, seg.tail);
+   emb_rb_seg_destroy(&seg);
+}
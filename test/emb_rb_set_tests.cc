@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "../src/emb_rb_set.h"
+
+class RBSetTesting : public ::testing::Test
+{
+public:
+   RBSetTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBSetTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+};
+
+// Ensure that only rings holding data are reported, once per arrival, across bitmap words
+TEST_F(RBSetTesting, Test_Ready_Set)
+{
+   static emb_rb_t          rings[200];
+   static uint8_t           bufs[200][16];
+   static emb_rb_set_slot_t slots[200];
+   emb_rb_set_t             set;
+   emb_rb_t *               ready[8];
+   uint8_t                  rd[16];
+
+   ASSERT_EQ(emb_rb_set_init(&set, slots, EMB_RB_SET_MAX + 1), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_set_init(&set, slots, 200), EMB_RB_ERR_OK);
+   for (int i = 0; i < 200; i++)
+   {
+      ASSERT_EQ(emb_rb_init(&rings[i], bufs[i], sizeof(bufs[i])), EMB_RB_ERR_OK);
+   }
+   // A ring with data is ready as soon as it joins
+   ASSERT_EQ(emb_rb_queue(&rings[0], (const uint8_t *)"x", 1, NULL), 1);
+   for (int i = 0; i < 200; i++)
+   {
+      ASSERT_EQ(emb_rb_set_add(&set, &rings[i]), EMB_RB_ERR_OK);
+   }
+   ASSERT_EQ(emb_rb_set_add(&set, &rings[0]), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 1);
+   ASSERT_EQ(ready[0], &rings[0]);
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 0);
+
+   // A burst on one ring reports it once, rings in different words all show up
+   for (int i = 0; i < 5; i++)
+   {
+      ASSERT_EQ(emb_rb_queue(&rings[70], (const uint8_t *)"y", 1, NULL), 1);
+   }
+   ASSERT_EQ(emb_rb_queue(&rings[3], (const uint8_t *)"z", 1, NULL), 1);
+   ASSERT_EQ(emb_rb_queue(&rings[199], (const uint8_t *)"z", 1, NULL), 1);
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 3);
+   std::sort(ready, ready + 3);
+   ASSERT_EQ(ready[0], &rings[3]);
+   ASSERT_EQ(ready[1], &rings[70]);
+   ASSERT_EQ(ready[2], &rings[199]);
+
+   // A partial dequeue leaves the ring flagged, a full one does not
+   ASSERT_EQ(emb_rb_dequeue(&rings[70], rd, 2, NULL), 2);
+   ASSERT_EQ(emb_rb_dequeue(&rings[3], rd, 1, NULL), 1);
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 1);
+   ASSERT_EQ(ready[0], &rings[70]);
+
+   // Rings that do not fit stay flagged for the next call
+   for (int i = 10; i < 20; i++)
+   {
+      ASSERT_EQ(emb_rb_queue(&rings[i], (const uint8_t *)"w", 1, NULL), 1);
+   }
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 8);
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 2);
+
+   // Removed rings are no longer reported
+   ASSERT_EQ(emb_rb_set_remove(&set, &rings[5]), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rings[5], (const uint8_t *)"v", 1, NULL), 1);
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 0);
+   ASSERT_EQ(emb_rb_set_add(&set, &rings[5]), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 8, 0), 1);
+   emb_rb_set_destroy(&set);
+   for (int i = 0; i < 200; i++)
+   {
+      ASSERT_EQ(rings[i].ready, nullptr);
+      emb_rb_destroy(&rings[i]);
+   }
+}
+
+// Ensure that a waiting consumer wakes up for a producer on another thread and times out otherwise
+TEST_F(RBSetTesting, Test_Set_Wait)
+{
+   emb_rb_t          rings[4];
+   uint8_t           bufs[4][16];
+   emb_rb_set_slot_t slots[4];
+   emb_rb_set_t      set;
+   emb_rb_t *        ready[4];
+
+   ASSERT_EQ(emb_rb_set_init(&set, slots, 4), EMB_RB_ERR_OK);
+   for (int i = 0; i < 4; i++)
+   {
+      ASSERT_EQ(emb_rb_init(&rings[i], bufs[i], sizeof(bufs[i])), EMB_RB_ERR_OK);
+      ASSERT_EQ(emb_rb_set_add(&set, &rings[i]), EMB_RB_ERR_OK);
+   }
+   auto start = std::chrono::steady_clock::now();
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 4, 10000000), 0);
+   ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(10));
+
+   std::thread producer([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      emb_rb_queue(&rings[2], (const uint8_t *)"p", 1, NULL);
+   });
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 4, 5000000000ull), 1);
+   ASSERT_EQ(ready[0], &rings[2]);
+   producer.join();
+
+   // An endless wait saturates the deadline instead of wrapping into the past
+   std::thread late([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      emb_rb_queue(&rings[1], (const uint8_t *)"q", 1, NULL);
+   });
+   ASSERT_EQ(emb_rb_set_wait(&set, ready, 4, UINT64_MAX), 1);
+   ASSERT_EQ(ready[0], &rings[1]);
+   late.join();
+   emb_rb_set_destroy(&set);
+   for (int i = 0; i < 4; i++)
+   {
+      emb_rb_destroy(&rings[i]);
+   }
+}
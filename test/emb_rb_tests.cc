@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
 #include <string.h>
+#include <poll.h>
+#include <unistd.h>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
 #include "../src/emb_rb.h"
 
 class RBTesting : public ::testing::Test
@@ -744,3 +749,1011 @@ TEST_F(RBTesting, Test_ConcurrencyComprehensive)
 
    ASSERT_EQ(emb_rb_free_space(&rb), 0);
 }
+
+// Counting allocator for the elastic tests
+static int elastic_allocs = 0;
+
+static void *elastic_alloc(void *ctx, size_t size)
+{
+   (void)ctx;
+   elastic_allocs++;
+   return(malloc(size));
+}
+
+static void elastic_free(void *ctx, void *p)
+{
+   (void)ctx;
+   elastic_allocs--;
+   free(p);
+}
+
+// Ensure that an elastic ring grows when full, keeps the data in order across a wrap, and respects the cap
+TEST_F(RBTesting, Test_Elastic_Grow)
+{
+   emb_rb_t               rb;
+   emb_rb_elastic_t       el;
+   emb_rb_elastic_cfg_t   cfg = { elastic_alloc, elastic_free, NULL, 64, 0 };
+   emb_rb_elastic_stats_t stats;
+   uint8_t                data[64];
+   uint8_t                rd[64];
+
+   for (int i = 0; i < 64; i++)
+   {
+      data[i] = (uint8_t)i;
+   }
+   ASSERT_EQ(emb_rb_elastic_init(&rb, &el, 0, &cfg), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_elastic_init(&rb, &el, 128, &cfg), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_elastic_init(&rb, &el, 10, &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(elastic_allocs, 1);
+
+   // Put the tail in the middle so the grow has to relinearize a wrapped region
+   ASSERT_EQ(emb_rb_queue(&rb, data, 6, NULL), 6);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 6, NULL), 6);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 10, NULL), 10);
+   ASSERT_EQ(emb_rb_queue_single(&rb, 10, NULL), 1);
+   ASSERT_EQ(emb_rb_size(&rb, NULL), 20);
+   ASSERT_EQ(emb_rb_queue(&rb, &data[11], 30, NULL), 30);
+   ASSERT_EQ(emb_rb_size(&rb, NULL), 64);
+   ASSERT_EQ(elastic_allocs, 1);
+
+   // Capped, the rest is truncated like a fixed ring
+   int err;
+   ASSERT_EQ(emb_rb_queue(&rb, &data[41], 30, &err), 23);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue_single(&rb, 0, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_FULL);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 64, NULL), 64);
+   ASSERT_EQ(memcmp(data, rd, 64), 0);
+
+   ASSERT_EQ(emb_rb_elastic_stats(&rb, &stats), EMB_RB_ERR_OK);
+   ASSERT_EQ(stats.grows, 2);
+   ASSERT_EQ(stats.shrinks, 0);
+   ASSERT_EQ(stats.bytes_moved, 10 + 11);
+   emb_rb_destroy(&rb);
+   ASSERT_EQ(elastic_allocs, 0);
+}
+
+// Ensure that an elastic ring shrinks back to its initial size once idle
+TEST_F(RBTesting, Test_Elastic_Shrink)
+{
+   emb_rb_t               rb;
+   emb_rb_elastic_t       el;
+   emb_rb_elastic_cfg_t   cfg = { NULL, NULL, NULL, 0, 1000000 };
+   emb_rb_elastic_stats_t stats;
+   uint8_t                data[64] = { 0 };
+   uint8_t                rd[64];
+
+   ASSERT_EQ(emb_rb_elastic_init(&rb, &el, 16, &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 64, NULL), 64);
+   ASSERT_EQ(emb_rb_size(&rb, NULL), 64);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 62, NULL), 62);
+
+   // Not idle long enough yet
+   ASSERT_EQ(emb_rb_size(&rb, NULL), 64);
+   for (int i = 0; i < 2; i++)
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      ASSERT_EQ(emb_rb_elastic_tick(&rb), EMB_RB_ERR_OK);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      ASSERT_EQ(emb_rb_elastic_tick(&rb), EMB_RB_ERR_OK);
+   }
+   ASSERT_EQ(emb_rb_size(&rb, NULL), 16);
+   ASSERT_EQ(emb_rb_used_space(&rb), 2);
+   std::this_thread::sleep_for(std::chrono::milliseconds(2));
+   ASSERT_EQ(emb_rb_elastic_tick(&rb), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_size(&rb, NULL), 16);
+
+   ASSERT_EQ(emb_rb_elastic_stats(&rb, &stats), EMB_RB_ERR_OK);
+   ASSERT_EQ(stats.shrinks, 2);
+   ASSERT_EQ(emb_rb_elastic_tick(NULL), EMB_RB_ERR_ILLEGAL_ARGS);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that the 64 bit API validates its size and clamps in the 32 bit API
+TEST_F(RBTesting, Test_64_Bit_Size)
+{
+   emb_rb_t rb;
+   uint8_t  buf[1];
+   uint64_t big = 5ull * 1024 * 1024 * 1024;
+
+   ASSERT_EQ(emb_rb_init64(&rb, buf, EMB_RB_MAX_SIZE + 1), EMB_RB_ERR_ILLEGAL_ARGS);
+
+   // Never touches the storage, only checks the size math
+   ASSERT_EQ(emb_rb_init64(&rb, buf, big), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_size64(&rb, NULL), big);
+   ASSERT_EQ(emb_rb_size(&rb, NULL), UINT32_MAX);
+   ASSERT_EQ(emb_rb_free_space64(&rb), big);
+   ASSERT_EQ(emb_rb_free_space(&rb), UINT32_MAX);
+   rb.head = big - 1;
+   ASSERT_EQ(emb_rb_used_space64(&rb), big - 1);
+   ASSERT_EQ(emb_rb_used_space(&rb), UINT32_MAX);
+   ASSERT_EQ(emb_rb_free_space64(&rb), 1);
+   ASSERT_EQ(emb_rb_free_space(&rb), 1);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that a non power of two ring keeps its data in order when head and tail wrap the 64 bit limit
+TEST_F(RBTesting, Test_64_Bit_Index_Wrap)
+{
+   emb_rb_t rb;
+   uint8_t  buf[10];
+   uint8_t  data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+   uint8_t  rd[10];
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, 10), EMB_RB_ERR_OK);
+   rb.head     = UINT64_MAX - 3;
+   rb.tail     = UINT64_MAX - 3;
+   rb.head_idx = 7;
+   rb.tail_idx = 7;
+
+   ASSERT_EQ(emb_rb_queue64(&rb, data, 8, NULL), 8);
+   ASSERT_EQ(rb.head, 4);
+   ASSERT_EQ(emb_rb_used_space64(&rb), 8);
+   ASSERT_EQ(emb_rb_free_space64(&rb), 2);
+   ASSERT_EQ(emb_rb_peek64(&rb, 2, rd, 10), 6);
+   ASSERT_EQ(memcmp(data + 2, rd, 6), 0);
+
+   // Insert and remove across both the storage wrap and the counter wrap
+   uint8_t ins[2] = { 0xAA, 0xBB };
+   ASSERT_EQ(emb_rb_insert64(&rb, 2, ins, 2, 1), 2);
+   ASSERT_EQ(emb_rb_used_space64(&rb), 10);
+   ASSERT_EQ(emb_rb_remove64(&rb, 1, rd, 3, 1), 3);
+   uint8_t removed[3] = { 2, 0xAA, 0xBB };
+   ASSERT_EQ(memcmp(removed, rd, 3), 0);
+   ASSERT_EQ(emb_rb_used_space64(&rb), 7);
+   ASSERT_EQ(emb_rb_dequeue64(&rb, rd, 10, NULL), 7);
+   uint8_t expect[7] = { 1, 3, 4, 5, 6, 7, 8 };
+   ASSERT_EQ(memcmp(expect, rd, 7), 0);
+
+   // Keep cycling through the wrap
+   rb.head = UINT64_MAX - 20;
+   rb.tail = UINT64_MAX - 20;
+   for (int i = 0; i < 20; i++)
+   {
+      ASSERT_EQ(emb_rb_queue(&rb, data, 7, NULL), 7);
+      ASSERT_EQ(emb_rb_used_space(&rb), 7);
+      ASSERT_EQ(emb_rb_dequeue(&rb, rd, 7, NULL), 7);
+      ASSERT_EQ(memcmp(data, rd, 7), 0);
+   }
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that remove keeps the data behind the removed region intact when it wraps
+TEST_F(RBTesting, Test_Remove_Wrap_Around)
+{
+   emb_rb_t rb;
+   uint8_t  buf[10];
+   uint8_t  data[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+   uint8_t  rd[10];
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, 10), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 6, NULL), 6);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 6, NULL), 6);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 9, NULL), 9);
+   ASSERT_EQ(emb_rb_remove(&rb, 2, NULL, 3, 1), 3);
+   ASSERT_EQ(emb_rb_remove(&rb, 6, NULL, 1, 1), 0);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 10, NULL), 6);
+   uint8_t expect[6] = { 0, 1, 5, 6, 7, 8 };
+   ASSERT_EQ(memcmp(expect, rd, 6), 0);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that the occupancy getters never wait on the lock
+TEST_F(RBTesting, Test_Occupancy_Lock_Free)
+{
+   emb_rb_t rb;
+   uint8_t  buf[10];
+   uint8_t  data[4] = { 0 };
+   int      err     = EMB_RB_ERR_LOCK;
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, 10), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 4, NULL), 4);
+
+   // Hold the lock like a writer in the middle of a copy would
+   emb_rb_lock_acquire(&rb.lock);
+   ASSERT_EQ(emb_rb_size(&rb, &err), 10);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_used_space(&rb), 4);
+   ASSERT_EQ(emb_rb_free_space(&rb), 6);
+   emb_rb_lock_release(&rb.lock);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that a monitor polling concurrently with a producer and consumer never sees used > size
+TEST_F(RBTesting, Test_Occupancy_Concurrent_Monitor)
+{
+   emb_rb_t          rb;
+   uint8_t           buf[64];
+   std::atomic<bool> done(false);
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+
+   std::thread producer([&rb, &done]() {
+                  uint8_t data[7] = { 0 };
+                  for (int i = 0; i < 200000; i++)
+                  {
+                     emb_rb_queue(&rb, data, 7, NULL);
+                  }
+                  done = true;
+      });
+   std::thread consumer([&rb, &done]() {
+                  uint8_t rd[5];
+                  while (!done)
+                  {
+                     emb_rb_dequeue(&rb, rd, 5, NULL);
+                  }
+      });
+   while (!done)
+   {
+      uint32_t used = emb_rb_used_space(&rb);
+      uint32_t free = emb_rb_free_space(&rb);
+      ASSERT_LE(used, 64);
+      ASSERT_LE(free, 64);
+   }
+   producer.join();
+   consumer.join();
+   ASSERT_EQ(emb_rb_used_space(&rb) + emb_rb_free_space(&rb), 64);
+   emb_rb_destroy(&rb);
+}
+
+// Lock callbacks for the policy tests, count calls and guard with a mutex
+static int             cb_locks   = 0;
+static int             cb_unlocks = 0;
+static pthread_mutex_t cb_mtx     = PTHREAD_MUTEX_INITIALIZER;
+
+static void cb_lock(void *ctx)
+{
+   pthread_mutex_lock((pthread_mutex_t *)ctx);
+   cb_locks++;
+}
+
+static void cb_unlock(void *ctx)
+{
+   cb_unlocks++;
+   pthread_mutex_unlock((pthread_mutex_t *)ctx);
+}
+
+// Ensure that every lock policy gives the same results
+TEST_F(RBTesting, Test_Lock_Policies)
+{
+   emb_rb_lock_policy_t policies[] = { EMB_RB_LOCK_MUTEX, EMB_RB_LOCK_NONE, EMB_RB_LOCK_SPIN,
+                                       EMB_RB_LOCK_ADAPTIVE, EMB_RB_LOCK_CALLBACK };
+   uint8_t              data[8]    = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+   for (int p = 0; p < 5; p++)
+   {
+      emb_rb_t          rb;
+      uint8_t           buf[10];
+      uint8_t           rd[10];
+      emb_rb_lock_cfg_t cfg = { policies[p], 0, cb_lock, NULL, cb_unlock, &cb_mtx, 0, 0 };
+
+      ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+      ASSERT_EQ(emb_rb_queue(&rb, data, 8, NULL), 8);
+      ASSERT_EQ(emb_rb_queue_single(&rb, 9, NULL), 1);
+      ASSERT_EQ(emb_rb_insert(&rb, 0, data, 1, 1), 1);
+      ASSERT_EQ(emb_rb_remove(&rb, 0, NULL, 1, 1), 1);
+      ASSERT_EQ(emb_rb_peek(&rb, 1, rd, 2), 2);
+      ASSERT_EQ(rd[0], 2);
+      ASSERT_EQ(emb_rb_flush_partial(&rb, 1), 1);
+      ASSERT_EQ(emb_rb_dequeue(&rb, rd, 10, NULL), 8);
+      ASSERT_EQ(rd[7], 9);
+      emb_rb_destroy(&rb);
+   }
+   ASSERT_EQ(cb_locks, 7);
+   ASSERT_EQ(cb_unlocks, 7);
+
+   // Callback policy needs both callbacks
+   emb_rb_t          rb;
+   uint8_t           buf[10];
+   emb_rb_lock_cfg_t bad = { EMB_RB_LOCK_CALLBACK, 0, cb_lock, NULL, NULL, NULL, 0, 0 };
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &bad), EMB_RB_ERR_LOCK);
+}
+
+// Ensure that the data path only tries the lock by default, and waits for it when blocking is set
+TEST_F(RBTesting, Test_Lock_Blocking)
+{
+   emb_rb_lock_policy_t policies[] = { EMB_RB_LOCK_MUTEX, EMB_RB_LOCK_SPIN, EMB_RB_LOCK_ADAPTIVE };
+   uint8_t              data[4]    = { 1, 2, 3, 4 };
+
+   for (int p = 0; p < 3; p++)
+   {
+      emb_rb_t          rb;
+      uint8_t           buf[10];
+      int               err;
+      emb_rb_lock_cfg_t cfg = { policies[p], 0, NULL, NULL, NULL, NULL, 0, 0 };
+
+      ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+      emb_rb_lock_acquire(&rb.lock);
+      ASSERT_EQ(emb_rb_queue(&rb, data, 4, &err), 0);
+      ASSERT_EQ(err, EMB_RB_ERR_LOCK);
+      ASSERT_EQ(emb_rb_queue_single(&rb, 1, &err), 0);
+      ASSERT_EQ(err, EMB_RB_ERR_LOCK);
+      emb_rb_lock_release(&rb.lock);
+      emb_rb_destroy(&rb);
+
+      // Blocking, the queue has to wait until the holder lets go
+      cfg.blocking = 1;
+      ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+      emb_rb_lock_acquire(&rb.lock);
+      std::thread holder([&rb]() {
+                  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                  emb_rb_lock_release(&rb.lock);
+         });
+      ASSERT_EQ(emb_rb_queue(&rb, data, 4, &err), 4);
+      ASSERT_EQ(err, EMB_RB_ERR_OK);
+      holder.join();
+      emb_rb_destroy(&rb);
+   }
+}
+
+// Ensure that a producer handle publishes in batches, in order, and holds bytes while the ring is full
+TEST_F(RBTesting, Test_Producer_Handle)
+{
+   emb_rb_t          rb;
+   emb_rb_producer_t p;
+   uint8_t           buf[EMB_RB_PRODUCER_BUF * 2];
+   uint8_t           rd[EMB_RB_PRODUCER_BUF * 2];
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_producer_init(&p, &rb, EMB_RB_PRODUCER_BUF + 1), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_producer_init(&p, &rb, 8), EMB_RB_ERR_OK);
+
+   // Nothing is published until the threshold
+   for (int i = 0; i < 7; i++)
+   {
+      ASSERT_EQ(emb_rb_producer_put(&p, (uint8_t)i), 1);
+   }
+   ASSERT_EQ(emb_rb_used_space(&rb), 0);
+   ASSERT_EQ(emb_rb_producer_put(&p, 7), 1);
+   ASSERT_EQ(emb_rb_used_space(&rb), 8);
+
+   // Explicit flush publishes a partial batch
+   ASSERT_EQ(emb_rb_producer_put(&p, 8), 1);
+   ASSERT_EQ(emb_rb_producer_flush(&p), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_used_space(&rb), 9);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 9, NULL), 9);
+   for (int i = 0; i < 9; i++)
+   {
+      ASSERT_EQ(rd[i], i);
+   }
+
+   // Fill the ring, then the staging buffer, then the handle starts refusing
+   ASSERT_EQ(emb_rb_producer_init(&p, &rb, 0), EMB_RB_ERR_OK);
+   int accepted = 0;
+   for (int i = 0; i < EMB_RB_PRODUCER_BUF * 4; i++)
+   {
+      accepted += emb_rb_producer_put(&p, (uint8_t)i);
+   }
+   ASSERT_EQ(accepted, EMB_RB_PRODUCER_BUF * 3);
+   ASSERT_EQ(emb_rb_used_space(&rb), sizeof(buf));
+   ASSERT_EQ(emb_rb_producer_flush(&p), EMB_RB_ERR_BUFFER_FULL);
+
+   // Draining the ring lets the staged bytes through, still in order
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, sizeof(rd), NULL), sizeof(rd));
+   ASSERT_EQ(emb_rb_producer_flush(&p), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, sizeof(rd), NULL), EMB_RB_PRODUCER_BUF);
+   for (int i = 0; i < EMB_RB_PRODUCER_BUF; i++)
+   {
+      ASSERT_EQ(rd[i], (uint8_t)(i + sizeof(buf)));
+   }
+   emb_rb_destroy(&rb);
+
+   // Past the threshold a full ring is tried once, not again for every staged byte
+   emb_rb_lock_cfg_t cfg = { EMB_RB_LOCK_CALLBACK, 0, cb_lock, NULL, cb_unlock, &cb_mtx, 0, 0 };
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, 8, &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_producer_init(&p, &rb, 8), EMB_RB_ERR_OK);
+   for (int i = 0; i < 8; i++)
+   {
+      ASSERT_EQ(emb_rb_producer_put(&p, (uint8_t)i), 1);
+   }
+   int locks = cb_locks;
+   for (int i = 0; i < EMB_RB_PRODUCER_BUF; i++)
+   {
+      ASSERT_EQ(emb_rb_producer_put(&p, (uint8_t)i), 1);
+   }
+   ASSERT_EQ(cb_locks - locks, 1);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 8, NULL), 8);
+   ASSERT_EQ(emb_rb_producer_flush(&p), EMB_RB_ERR_BUFFER_FULL);
+   ASSERT_EQ(emb_rb_used_space(&rb), 8);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that a parse cursor reads across the wrap, commits what it consumed and detects a stale tail
+TEST_F(RBTesting, Test_Parse_Cursor)
+{
+   emb_rb_t        rb;
+   emb_rb_cursor_t c;
+   uint8_t         buf[16];
+   uint8_t         rd[16];
+   uint8_t         src[16];
+   uint8_t         byte;
+
+   for (int i = 0; i < (int)sizeof(src); i++)
+   {
+      src[i] = (uint8_t)(i + 1);
+   }
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_cursor_begin(NULL, &rb), EMB_RB_ERR_ILLEGAL_ARGS);
+
+   // Put the tail near the end so the pinned region wraps
+   ASSERT_EQ(emb_rb_queue(&rb, src, 12, NULL), 12);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 12), 12);
+   ASSERT_EQ(emb_rb_queue(&rb, src, 10, NULL), 10);
+
+   // Abort leaves everything in place
+   ASSERT_EQ(emb_rb_cursor_begin(&c, &rb), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_cursor_skip(&c, 4), 4);
+   emb_rb_cursor_abort(&c);
+   ASSERT_EQ(emb_rb_used_space(&rb), 10);
+
+   // Read through the wrap, the region is fixed at begin even if more data arrives
+   ASSERT_EQ(emb_rb_cursor_begin(&c, &rb), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, src, 2, NULL), 2);
+   ASSERT_EQ(emb_rb_cursor_read_u8(&c, &byte), EMB_RB_ERR_OK);
+   ASSERT_EQ(byte, src[0]);
+   ASSERT_EQ(emb_rb_cursor_read_bytes(&c, rd, 5), 5);
+   ASSERT_EQ(memcmp(rd, src + 1, 5), 0);
+   ASSERT_EQ(emb_rb_cursor_skip(&c, 100), 4);
+   ASSERT_EQ(emb_rb_cursor_remaining(&c), 0);
+   ASSERT_EQ(emb_rb_cursor_read_u8(&c, &byte), EMB_RB_ERR_BUFFER_EMPTY);
+   ASSERT_EQ(emb_rb_cursor_commit(&c), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_used_space(&rb), 2);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 2, NULL), 2);
+   ASSERT_EQ(memcmp(rd, src, 2), 0);
+
+   // A consumer that flushes between begin and commit makes the cursor stale
+   ASSERT_EQ(emb_rb_queue(&rb, src, 8, NULL), 8);
+   ASSERT_EQ(emb_rb_cursor_begin(&c, &rb), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_cursor_skip(&c, 3), 3);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 1), 1);
+   ASSERT_EQ(emb_rb_cursor_commit(&c), EMB_RB_ERR_STALE);
+   ASSERT_EQ(emb_rb_used_space(&rb), 7);
+
+   // So does rewriting the pinned bytes without moving the tail, and a closed cursor reads nothing
+   ASSERT_EQ(emb_rb_cursor_begin(&c, &rb), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_cursor_skip(&c, 3), 3);
+   ASSERT_EQ(emb_rb_put_u16le(&rb, 1, 0xbeef), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_cursor_commit(&c), EMB_RB_ERR_STALE);
+   ASSERT_EQ(emb_rb_used_space(&rb), 7);
+   ASSERT_EQ(emb_rb_cursor_read_u8(&c, &byte), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_cursor_begin(&c, &rb), EMB_RB_ERR_OK);
+   emb_rb_cursor_abort(&c);
+   ASSERT_EQ(emb_rb_cursor_read_u8(&c, &byte), EMB_RB_ERR_ILLEGAL_ARGS);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that typed integer and varint accessors work in both byte orders and across the wrap
+TEST_F(RBTesting, Test_Typed_Accessors)
+{
+   emb_rb_t rb;
+   uint8_t  buf[16];
+   uint8_t  zero[16] = { 0 };
+   uint8_t  rd[16];
+   uint16_t v16;
+   uint32_t v32;
+   uint64_t v64;
+   uint32_t len;
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_get_u32le(NULL, 0, &v32), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_get_u32le(&rb, 0, &v32), EMB_RB_ERR_BUFFER_EMPTY);
+
+   // Start 13 bytes in so values straddle the wrap
+   ASSERT_EQ(emb_rb_queue(&rb, zero, 13, NULL), 13);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 13), 13);
+   ASSERT_EQ(emb_rb_queue(&rb, zero, 16, NULL), 16);
+
+   ASSERT_EQ(emb_rb_put_u32be(&rb, 1, 0x01020304), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_peek(&rb, 1, rd, 4), 4);
+   ASSERT_EQ(rd[0], 0x01);
+   ASSERT_EQ(rd[3], 0x04);
+   ASSERT_EQ(emb_rb_get_u32be(&rb, 1, &v32), EMB_RB_ERR_OK);
+   ASSERT_EQ(v32, 0x01020304u);
+   ASSERT_EQ(emb_rb_get_u32le(&rb, 1, &v32), EMB_RB_ERR_OK);
+   ASSERT_EQ(v32, 0x04030201u);
+   ASSERT_EQ(emb_rb_get_u16be(&rb, 2, &v16), EMB_RB_ERR_OK);
+   ASSERT_EQ(v16, 0x0203);
+
+   ASSERT_EQ(emb_rb_put_u64le(&rb, 0, 0x1122334455667788ull), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_get_u64le(&rb, 0, &v64), EMB_RB_ERR_OK);
+   ASSERT_EQ(v64, 0x1122334455667788ull);
+   ASSERT_EQ(emb_rb_get_u64be(&rb, 0, &v64), EMB_RB_ERR_OK);
+   ASSERT_EQ(v64, 0x8877665544332211ull);
+   ASSERT_EQ(emb_rb_put_u16le(&rb, 15, 1), EMB_RB_ERR_BUFFER_EMPTY);
+
+   // Varints, including one that straddles the wrap
+   ASSERT_EQ(emb_rb_put_varint(&rb, 1, 300, &len), EMB_RB_ERR_OK);
+   ASSERT_EQ(len, 2);
+   ASSERT_EQ(emb_rb_get_varint(&rb, 1, &v64, &len), EMB_RB_ERR_OK);
+   ASSERT_EQ(v64, 300);
+   ASSERT_EQ(len, 2);
+   ASSERT_EQ(emb_rb_put_varint(&rb, 4, UINT64_MAX, &len), EMB_RB_ERR_OK);
+   ASSERT_EQ(len, EMB_RB_VARINT_MAX);
+   ASSERT_EQ(emb_rb_get_varint(&rb, 4, &v64, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(v64, UINT64_MAX);
+
+   // A 10th byte above 1 would overflow 64 bits
+   ASSERT_EQ(emb_rb_put_u16le(&rb, 13, 0x0002), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_get_varint(&rb, 4, &v64, NULL), EMB_RB_ERR_ILLEGAL_ARGS);
+
+   // Incomplete at the end of the queued bytes
+   ASSERT_EQ(emb_rb_put_u16le(&rb, 14, 0x8080), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_get_varint(&rb, 14, &v64, NULL), EMB_RB_ERR_BUFFER_EMPTY);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that a ring to ring transfer copies across both wraps and respects free space
+TEST_F(RBTesting, Test_Transfer)
+{
+   emb_rb_t src, dst;
+   uint8_t  sbuf[16], dbuf[12];
+   uint8_t  data[16];
+   uint8_t  rd[16];
+   int      err;
+
+   for (int i = 0; i < (int)sizeof(data); i++)
+   {
+      data[i] = (uint8_t)(i + 1);
+   }
+   ASSERT_EQ(emb_rb_init(&src, sbuf, sizeof(sbuf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_init(&dst, dbuf, sizeof(dbuf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_transfer(&dst, &dst, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_transfer(&dst, &src, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+
+   // Move both rings so src wraps after 6 bytes and dst after 3
+   ASSERT_EQ(emb_rb_queue(&src, data, 10, NULL), 10);
+   ASSERT_EQ(emb_rb_flush_partial(&src, 10), 10);
+   ASSERT_EQ(emb_rb_queue(&dst, data, 9, NULL), 9);
+   ASSERT_EQ(emb_rb_flush_partial(&dst, 9), 9);
+   ASSERT_EQ(emb_rb_queue(&src, data, 14, NULL), 14);
+   ASSERT_EQ(emb_rb_queue(&dst, data, 2, NULL), 2);
+
+   // Limited by dst free space
+   ASSERT_EQ(emb_rb_transfer(&dst, &src, 100, &err), 10);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_used_space(&src), 4);
+   ASSERT_EQ(emb_rb_used_space(&dst), 12);
+   ASSERT_EQ(emb_rb_transfer(&dst, &src, 100, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_FULL);
+   ASSERT_EQ(emb_rb_dequeue(&dst, rd, 12, NULL), 12);
+   ASSERT_EQ(memcmp(rd, data, 2), 0);
+   ASSERT_EQ(memcmp(rd + 2, data, 10), 0);
+
+   // Limited by max_len, then the rest
+   ASSERT_EQ(emb_rb_transfer(&dst, &src, 3, &err), 3);
+   ASSERT_EQ(emb_rb_transfer(&dst, &src, 100, &err), 1);
+   ASSERT_EQ(emb_rb_dequeue(&dst, rd, 12, NULL), 4);
+   ASSERT_EQ(memcmp(rd, data + 10, 4), 0);
+   emb_rb_destroy(&src);
+   emb_rb_destroy(&dst);
+}
+
+// Ensure that element mode only ever moves whole elements, including across the wrap
+TEST_F(RBTesting, Test_Element_Mode)
+{
+   emb_rb_t rb;
+   uint64_t buf[4];
+   uint64_t in[6]  = { 1, 2, 3, 4, 5, 6 };
+   uint64_t out[6] = { 0 };
+   int      err;
+
+   ASSERT_EQ(emb_rb_init_elem(&rb, (uint8_t *)buf, 0, 4), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_init_elem(&rb, (uint8_t *)buf, sizeof(uint64_t), 4), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_size(&rb, NULL), sizeof(buf));
+   ASSERT_EQ(emb_rb_pop_n(&rb, out, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+
+   // Only whole elements fit
+   ASSERT_EQ(emb_rb_push_n(&rb, in, 3, &err), 3);
+   ASSERT_EQ(emb_rb_pop_n(&rb, out, 1, &err), 1);
+   ASSERT_EQ(out[0], 1);
+   ASSERT_EQ(emb_rb_push_n(&rb, in + 3, 3, &err), 2);
+   ASSERT_EQ(emb_rb_push_n(&rb, in + 5, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_FULL);
+
+   // Pop across the wrap
+   ASSERT_EQ(emb_rb_pop_n(&rb, out, 6, &err), 4);
+   ASSERT_EQ(out[0], 2);
+   ASSERT_EQ(out[1], 3);
+   ASSERT_EQ(out[2], 4);
+   ASSERT_EQ(out[3], 5);
+
+   // Byte rings are rejected
+   emb_rb_t bytes;
+   uint8_t  bbuf[8];
+   ASSERT_EQ(emb_rb_init(&bytes, bbuf, sizeof(bbuf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_push_n(&bytes, in, 1, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+   emb_rb_destroy(&bytes);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that watermark callbacks fire once per crossing with hysteresis
+static int _wm_high, _wm_low;
+
+static void _wm_cb(void *ctx, uint8_t high)
+{
+   (void)ctx;
+   if (high)
+   {
+      _wm_high++;
+   }
+   else
+   {
+      _wm_low++;
+   }
+}
+
+TEST_F(RBTesting, Test_Watermarks)
+{
+   emb_rb_t           rb;
+   emb_rb_watermark_t wm;
+   uint8_t            buf[16];
+   uint8_t            data[16] = { 0 };
+
+   _wm_high = 0;
+   _wm_low  = 0;
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_watermark_init(&rb, &wm, 8, 8, _wm_cb, NULL), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_watermark_init(&rb, &wm, 12, 4, _wm_cb, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_watermark_high(&rb), 0);
+
+   // Crossing high fires once, staying above does not fire again
+   ASSERT_EQ(emb_rb_queue(&rb, data, 11, NULL), 11);
+   ASSERT_EQ(_wm_high, 0);
+   ASSERT_EQ(emb_rb_queue_single(&rb, 0, NULL), 1);
+   ASSERT_EQ(_wm_high, 1);
+   ASSERT_EQ(emb_rb_watermark_high(&rb), 1);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 4, NULL), 4);
+   ASSERT_EQ(_wm_high, 1);
+
+   // Dropping below high but above low keeps the flag, reaching low clears it
+   ASSERT_EQ(emb_rb_dequeue(&rb, data, 8, NULL), 8);
+   ASSERT_EQ(emb_rb_watermark_high(&rb), 1);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 4, NULL), 4);
+   ASSERT_EQ(_wm_high, 1);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 7), 7);
+   ASSERT_EQ(_wm_low, 0);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 1), 1);
+   ASSERT_EQ(_wm_low, 1);
+   ASSERT_EQ(emb_rb_watermark_high(&rb), 0);
+
+   // And again for the next burst
+   ASSERT_EQ(emb_rb_queue(&rb, data, 8, NULL), 8);
+   ASSERT_EQ(emb_rb_flush(&rb), -1);
+   ASSERT_EQ(_wm_high, 2);
+   ASSERT_EQ(_wm_low, 2);
+
+   // Detached rings stop firing
+   ASSERT_EQ(emb_rb_watermark_init(&rb, NULL, 0, 0, NULL, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_queue(&rb, data, 16, NULL), 16);
+   ASSERT_EQ(_wm_high, 2);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that a batched dequeue waits for min_bytes and gives up at the deadline
+TEST_F(RBTesting, Test_Dequeue_Batch)
+{
+   emb_rb_t rb;
+   uint8_t  buf[32];
+   uint8_t  data[16] = { 0 };
+   uint8_t  rd[32];
+   int      err;
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_dequeue_batch(&rb, rd, 1, 0, 0, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+
+   // Deadline expires with less than min_bytes queued
+   ASSERT_EQ(emb_rb_queue(&rb, data, 3, NULL), 3);
+   auto start = std::chrono::steady_clock::now();
+   ASSERT_EQ(emb_rb_dequeue_batch(&rb, rd, 8, sizeof(rd), 20000000, &err), 3);
+   ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_dequeue_batch(&rb, rd, 8, sizeof(rd), 1000, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+
+   // A trickling producer wakes the consumer once min_bytes are there
+   std::thread producer([&]() {
+      for (int i = 0; i < 4; i++)
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(2));
+         emb_rb_queue(&rb, data, 4, NULL);
+      }
+   });
+   uint64_t n = emb_rb_dequeue_batch(&rb, rd, 12, sizeof(rd), 5000000000ull, &err);
+   producer.join();
+   ASSERT_GE(n, 12);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+
+   // An endless wait saturates the deadline instead of wrapping into the past
+   emb_rb_dequeue(&rb, rd, sizeof(rd), NULL);
+   std::thread late([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      emb_rb_queue(&rb, data, 4, NULL);
+   });
+   ASSERT_EQ(emb_rb_dequeue_batch(&rb, rd, 4, sizeof(rd), UINT64_MAX, &err), 4);
+   late.join();
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that a snapshot copies the readable region and stays consistent under concurrent traffic
+TEST_F(RBTesting, Test_Snapshot)
+{
+   emb_rb_t         rb;
+   emb_rb_elastic_t el;
+   uint8_t          buf[64];
+   uint8_t          snap[4096];
+   static uint8_t   big[4096];
+   uint64_t         start;
+   int              err;
+
+   ASSERT_EQ(emb_rb_elastic_init(&rb, &el, 16, NULL), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_snapshot(&rb, snap, sizeof(snap), &start, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_ILLEGAL_ARGS);
+   emb_rb_destroy(&rb);
+
+   // Across the wrap, nothing is consumed
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_snapshot(&rb, snap, sizeof(snap), &start, &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+   ASSERT_EQ(emb_rb_queue(&rb, buf, 60, NULL), 60);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 60), 60);
+   ASSERT_EQ(emb_rb_queue(&rb, (const uint8_t *)"snapshot", 8, NULL), 8);
+   ASSERT_EQ(emb_rb_snapshot(&rb, snap, sizeof(snap), &start, &err), 8);
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(start, 60);
+   ASSERT_EQ(memcmp(snap, "snapshot", 8), 0);
+   ASSERT_EQ(emb_rb_snapshot(&rb, snap, 4, NULL, NULL), 4);
+   ASSERT_EQ(emb_rb_used_space(&rb), 8);
+   emb_rb_destroy(&rb);
+
+   // Every byte carries its own stream position, so any torn copy shows up as a mismatch
+   std::atomic<bool> done(false);
+   ASSERT_EQ(emb_rb_init(&rb, big, sizeof(big)), EMB_RB_ERR_OK);
+   std::thread producer([&]() {
+      uint64_t pos = 0;
+      while (!done)
+      {
+         uint8_t chunk[701];
+         for (int i = 0; i < 701; i++)
+         {
+            chunk[i] = (uint8_t)(pos + i);
+         }
+         pos += emb_rb_queue(&rb, chunk, sizeof(chunk), NULL);
+         std::this_thread::yield();
+      }
+   });
+   std::thread consumer([&]() {
+      uint8_t rd[509];
+      while (!done)
+      {
+         emb_rb_dequeue(&rb, rd, sizeof(rd), NULL);
+         std::this_thread::yield();
+      }
+   });
+   for (int i = 0; i < 5000; i++)
+   {
+      uint64_t n = emb_rb_snapshot(&rb, snap, sizeof(snap), &start, &err);
+      for (uint64_t j = 0; j < n; j++)
+      {
+         ASSERT_EQ(snap[j], (uint8_t)(start + j));
+      }
+   }
+   done = true;
+   producer.join();
+   consumer.join();
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that optimistic peeks match the locked peek and never see torn data under traffic
+TEST_F(RBTesting, Test_Peek_Optimistic)
+{
+   emb_rb_t          rb;
+   static uint8_t    buf[4096];
+   uint8_t           rd[64];
+   emb_rb_lock_cfg_t cfg = { EMB_RB_LOCK_MUTEX, 0, NULL, NULL, NULL, NULL, 1, 0 };
+
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_peek(&rb, 0, rd, 8), 0);
+   ASSERT_EQ(emb_rb_queue(&rb, buf, 4090, NULL), 4090);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 4090), 4090);
+   ASSERT_EQ(emb_rb_queue(&rb, (const uint8_t *)"optimistic", 10, NULL), 10);
+   ASSERT_EQ(emb_rb_peek(&rb, 2, rd, 64), 8);
+   ASSERT_EQ(memcmp(rd, "timistic", 8), 0);
+   ASSERT_EQ(emb_rb_peek_optimistic(&rb, 9, rd, 4), 1);
+   ASSERT_EQ(rd[0], 'c');
+   ASSERT_EQ(emb_rb_peek_optimistic(&rb, 11, rd, 4), 0);
+   ASSERT_EQ(emb_rb_put_u16le(&rb, 0, 0x504f), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_peek(&rb, 0, rd, 2), 2);
+   ASSERT_EQ(memcmp(rd, "OP", 2), 0);
+   ASSERT_EQ(emb_rb_flush(&rb), -1);
+
+   // Each byte carries its stream position, the first peeked byte must match the tail at some point
+   // during the peek, and the rest must follow on from it
+   std::atomic<bool> done(false);
+   std::thread       producer([&]() {
+      uint64_t pos = 0;
+      while (!done)
+      {
+         uint8_t chunk[701];
+         for (int i = 0; i < 701; i++)
+         {
+            chunk[i] = (uint8_t)(pos + i);
+         }
+         pos += emb_rb_queue(&rb, chunk, sizeof(chunk), NULL);
+         std::this_thread::yield();
+      }
+   });
+   std::thread consumer([&]() {
+      uint8_t drop[509];
+      while (!done)
+      {
+         emb_rb_dequeue(&rb, drop, sizeof(drop), NULL);
+         std::this_thread::yield();
+      }
+   });
+   for (int i = 0; i < 20000; i++)
+   {
+      uint64_t n = emb_rb_peek_optimistic(&rb, 0, rd, sizeof(rd));
+      for (uint64_t j = 1; j < n; j++)
+      {
+         ASSERT_EQ(rd[j], (uint8_t)(rd[0] + j));
+      }
+   }
+   done = true;
+   producer.join();
+   consumer.join();
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that large copies outside the lock keep messages whole and in order with several producers
+TEST_F(RBTesting, Test_Unlocked_Copy)
+{
+   emb_rb_t       rb;
+   static uint8_t buf[EMB_RB_UNLOCKED_COPY_MIN * 8];
+   uint8_t        msg[EMB_RB_UNLOCKED_COPY_MIN];
+   int            err;
+
+   // Only mutex and adaptive rings that asked for it copy outside the lock
+   emb_rb_lock_cfg_t cfg = { EMB_RB_LOCK_SPIN, 0, NULL, NULL, NULL, NULL, 0, 1 };
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(rb.lock.unlocked_copy, 0);
+   emb_rb_destroy(&rb);
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(rb.lock.unlocked_copy, 0);
+   emb_rb_destroy(&rb);
+
+   // Small copies behind a reservation and the other operations see a consistent ring
+   cfg.policy = EMB_RB_LOCK_MUTEX;
+   ASSERT_EQ(emb_rb_init_ex(&rb, buf, sizeof(buf), &cfg), EMB_RB_ERR_OK);
+   ASSERT_EQ(rb.lock.unlocked_copy, 1);
+   memset(msg, 0x11, sizeof(msg));
+   ASSERT_EQ(emb_rb_queue(&rb, msg, sizeof(msg), &err), sizeof(msg));
+   ASSERT_EQ(err, EMB_RB_ERR_OK);
+   ASSERT_EQ(rb.copying, 0);
+   ASSERT_EQ(rb.head_pend, 0);
+   ASSERT_EQ(emb_rb_queue(&rb, (const uint8_t *)"ab", 2, NULL), 2);
+   ASSERT_EQ(emb_rb_used_space(&rb), sizeof(msg) + 2);
+   ASSERT_EQ(emb_rb_dequeue(&rb, msg, sizeof(msg), &err), sizeof(msg));
+   ASSERT_EQ(rb.tail_pend, 0);
+   ASSERT_EQ(msg[sizeof(msg) - 1], 0x11);
+   ASSERT_EQ(emb_rb_dequeue(&rb, msg, sizeof(msg), &err), 2);
+   ASSERT_EQ(memcmp(msg, "ab", 2), 0);
+   ASSERT_EQ(emb_rb_dequeue(&rb, msg, sizeof(msg), &err), 0);
+   ASSERT_EQ(err, EMB_RB_ERR_BUFFER_EMPTY);
+
+   // Every copy is a whole message since the ring only ever moves in message sized steps
+   const int                producers = 3;
+   const int                per       = 2000;
+   std::vector<std::thread> threads;
+   for (int id = 0; id < producers; id++)
+   {
+      threads.emplace_back([&, id]() {
+         uint8_t m[EMB_RB_UNLOCKED_COPY_MIN];
+         for (int seq = 0; seq < per; )
+         {
+            memset(m, id, sizeof(m));
+            memcpy(m + 1, &seq, sizeof(seq));
+            if (emb_rb_queue(&rb, m, sizeof(m), NULL) == sizeof(m))
+            {
+               seq++;
+            }
+            else
+            {
+               std::this_thread::yield();
+            }
+         }
+      });
+   }
+   int next[producers] = { 0 };
+   for (int got = 0; got < producers * per; )
+   {
+      uint64_t n = emb_rb_dequeue(&rb, msg, sizeof(msg), NULL);
+      if (!n)
+      {
+         std::this_thread::yield();
+         continue;
+      }
+      ASSERT_EQ(n, sizeof(msg));
+      int id = msg[0];
+      int seq;
+      memcpy(&seq, msg + 1, sizeof(seq));
+      ASSERT_LT(id, producers);
+      ASSERT_EQ(seq, next[id]);
+      ASSERT_EQ(msg[sizeof(msg) - 1], id);
+      next[id]++;
+      got++;
+   }
+   for (auto &t : threads)
+   {
+      t.join();
+   }
+   ASSERT_EQ(emb_rb_used_space(&rb), 0);
+   ASSERT_EQ(rb.copying, 0);
+   emb_rb_destroy(&rb);
+}
+
+// Ensure that readiness fds fire once per burst, re-arm on ack and work with poll
+TEST_F(RBTesting, Test_Notify)
+{
+   emb_rb_t        rb;
+   emb_rb_notify_t n;
+   uint8_t         buf[16];
+   uint8_t         rd[16];
+   struct pollfd   pfd[2];
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_notify_init(&rb, &n, 0, 0), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_notify_init(&rb, &n, 4, 8), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_notify_init(&rb, &n, 4, 8), EMB_RB_ERR_ILLEGAL_ARGS);
+   pfd[0] = { n.data_fd, POLLIN, 0 };
+   pfd[1] = { n.space_fd, POLLIN, 0 };
+
+   // An empty ring is writable straight away but not readable
+   ASSERT_EQ(poll(pfd, 2, 0), 1);
+   ASSERT_EQ(pfd[1].revents, POLLIN);
+   ASSERT_EQ(emb_rb_notify_ack(&rb, n.space_fd), EMB_RB_ERR_OK);
+   ASSERT_EQ(n.space_signaled, 1);
+
+   // A burst below the threshold stays quiet, reaching it signals exactly once
+   uint64_t cnt;
+   ASSERT_EQ(emb_rb_notify_ack(&rb, -1), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(read(n.space_fd, &cnt, sizeof(cnt)), (ssize_t)sizeof(cnt));
+   ASSERT_EQ(cnt, 1);
+   for (int i = 0; i < 3; i++)
+   {
+      ASSERT_EQ(emb_rb_queue_single(&rb, (uint8_t)i, NULL), 1);
+   }
+   ASSERT_EQ(poll(pfd, 1, 0), 0);
+   for (int i = 0; i < 10; i++)
+   {
+      ASSERT_EQ(emb_rb_queue_single(&rb, (uint8_t)i, NULL), 1);
+   }
+   ASSERT_EQ(read(n.data_fd, &cnt, sizeof(cnt)), (ssize_t)sizeof(cnt));
+   ASSERT_EQ(cnt, 1);
+
+   // Ack with data still above the threshold signals again, after draining it does not
+   ASSERT_EQ(emb_rb_notify_ack(&rb, n.data_fd), EMB_RB_ERR_OK);
+   ASSERT_EQ(poll(pfd, 1, 0), 1);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, sizeof(rd), NULL), 13);
+   ASSERT_EQ(emb_rb_notify_ack(&rb, n.data_fd), EMB_RB_ERR_OK);
+   ASSERT_EQ(poll(pfd, 1, 0), 0);
+
+   // Space comes back once a consumer frees enough of a full ring
+   ASSERT_EQ(emb_rb_queue(&rb, rd, sizeof(rd), NULL), 16);
+   ASSERT_EQ(emb_rb_notify_ack(&rb, n.space_fd), EMB_RB_ERR_OK);
+   ASSERT_EQ(poll(&pfd[1], 1, 0), 0);
+   ASSERT_EQ(emb_rb_dequeue(&rb, rd, 4, NULL), 4);
+   ASSERT_EQ(poll(&pfd[1], 1, 0), 0);
+   ASSERT_EQ(emb_rb_flush_partial(&rb, 4), 4);
+   ASSERT_EQ(poll(&pfd[1], 1, 0), 1);
+   emb_rb_notify_destroy(&rb);
+   ASSERT_EQ(n.data_fd, -1);
+   ASSERT_EQ(emb_rb_queue(&rb, rd, 4, NULL), 4);
+   emb_rb_destroy(&rb);
+}
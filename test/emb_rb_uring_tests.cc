@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "../src/emb_rb_uring.h"
+
+class RBUringTesting : public ::testing::Test
+{
+public:
+   RBUringTesting()
+   {
+      // initialization code here
+   }
+
+   void SetUp()
+   {
+   }
+
+   void TearDown()
+   {
+   }
+
+   ~RBUringTesting()
+   {
+      // cleanup any pending stuff, but no exceptions allowed
+   }
+
+   // Drain a wrapped ring to fd in small chunks, in whatever mode flags select
+   void drain(uint32_t flags, int fd, int64_t off)
+   {
+      emb_rb_t       rb;
+      emb_rb_uring_t u;
+      uint8_t        buf[64];
+      uint8_t        src[200];
+
+      for (uint32_t i = 0; i < sizeof(src); i++)
+      {
+         src[i] = (uint8_t)i;
+      }
+      ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+      ASSERT_EQ(emb_rb_uring_init(&u, &rb, 4, 10, flags), EMB_RB_ERR_OK);
+      if (flags & EMB_RB_URING_NO_URING)
+      {
+         ASSERT_EQ(u.mode, EMB_RB_URING_MODE_FALLBACK);
+      }
+      ASSERT_EQ(emb_rb_uring_set_drain(&u, fd, off), EMB_RB_ERR_OK);
+      uint64_t sent = 0;
+      while (u.dir[0].bytes < sizeof(src))
+      {
+         if (sent < sizeof(src))
+         {
+            sent += emb_rb_queue(&rb, src + sent, (uint32_t)(sizeof(src) - sent), NULL);
+         }
+         ASSERT_GE(emb_rb_uring_submit(&u), 0);
+         ASSERT_GE(emb_rb_uring_reap(&u, 1), 0);
+      }
+      ASSERT_EQ(emb_rb_used_space(&rb), 0);
+      ASSERT_EQ(u.inflight, 0);
+      emb_rb_uring_destroy(&u);
+      emb_rb_destroy(&rb);
+   }
+
+   // Check that fd holds the 200 byte pattern written by drain
+   void check(int fd, int64_t off)
+   {
+      uint8_t rd[256];
+      ssize_t n = off < 0 ? read(fd, rd, sizeof(rd)) : pread(fd, rd, sizeof(rd), off);
+
+      ASSERT_EQ(n, 200);
+      for (uint32_t i = 0; i < 200; i++)
+      {
+         ASSERT_EQ(rd[i], (uint8_t)i);
+      }
+   }
+};
+
+// Ensure that draining to a pipe keeps the bytes in order with io_uring and with the fallback
+TEST_F(RBUringTesting, Test_Drain_Pipe)
+{
+   uint32_t modes[] = { 0, EMB_RB_URING_NO_FIXED, EMB_RB_URING_NO_URING };
+   int      fds[2];
+
+   for (uint32_t flags : modes)
+   {
+      ASSERT_EQ(pipe(fds), 0);
+      drain(flags, fds[1], -1);
+      check(fds[0], -1);
+      close(fds[0]);
+      close(fds[1]);
+   }
+}
+
+// Ensure that pipelined writes at explicit file offsets land in the right place
+TEST_F(RBUringTesting, Test_Drain_File)
+{
+   uint32_t modes[] = { 0, EMB_RB_URING_NO_FIXED, EMB_RB_URING_NO_URING };
+
+   for (uint32_t flags : modes)
+   {
+      FILE *f = tmpfile();
+      ASSERT_NE(f, nullptr);
+      drain(flags, fileno(f), 16);
+      check(fileno(f), 16);
+      fclose(f);
+   }
+}
+
+// Ensure that filling from a pipe publishes the bytes in order and reports end of file
+TEST_F(RBUringTesting, Test_Fill_Pipe)
+{
+   uint32_t modes[] = { 0, EMB_RB_URING_NO_URING };
+   uint8_t  src[100];
+   uint8_t  rd[100];
+   int      fds[2];
+
+   for (uint32_t i = 0; i < sizeof(src); i++)
+   {
+      src[i] = (uint8_t)(i * 7);
+   }
+   for (uint32_t flags : modes)
+   {
+      emb_rb_t       rb;
+      emb_rb_uring_t u;
+      uint8_t        buf[32];
+
+      ASSERT_EQ(pipe(fds), 0);
+      ASSERT_EQ(write(fds[1], src, sizeof(src)), (ssize_t)sizeof(src));
+      close(fds[1]);
+      ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+      ASSERT_EQ(emb_rb_uring_init(&u, &rb, 4, 8, flags), EMB_RB_ERR_OK);
+      ASSERT_EQ(emb_rb_uring_set_fill(&u, fds[0], -1), EMB_RB_ERR_OK);
+      uint32_t got = 0;
+      while (!u.dir[1].eof)
+      {
+         ASSERT_GE(emb_rb_uring_submit(&u), 0);
+         ASSERT_GE(emb_rb_uring_reap(&u, 1), 0);
+         got += emb_rb_dequeue(&rb, rd + got, sizeof(rd) - got, NULL);
+      }
+      got += emb_rb_dequeue(&rb, rd + got, sizeof(rd) - got, NULL);
+      ASSERT_EQ(got, sizeof(src));
+      ASSERT_EQ(memcmp(rd, src, sizeof(src)), 0);
+      ASSERT_EQ(u.dir[1].bytes, sizeof(src));
+      emb_rb_uring_destroy(&u);
+      emb_rb_destroy(&rb);
+      close(fds[0]);
+   }
+}
+
+// Ensure that elastic rings and bad depths are refused and destroy cancels an idle read
+TEST_F(RBUringTesting, Test_Args_And_Cancel)
+{
+   emb_rb_t       rb;
+   emb_rb_uring_t u;
+   uint8_t        buf[32];
+   int            fds[2];
+
+   ASSERT_EQ(emb_rb_init(&rb, buf, sizeof(buf)), EMB_RB_ERR_OK);
+   ASSERT_EQ(emb_rb_uring_init(&u, &rb, 0, 0, 0), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_uring_init(&u, &rb, EMB_RB_URING_MAX_DEPTH + 1, 0, 0), EMB_RB_ERR_ILLEGAL_ARGS);
+   ASSERT_EQ(emb_rb_uring_init(&u, &rb, 2, 0, 0), EMB_RB_ERR_OK);
+   ASSERT_EQ(pipe(fds), 0);
+   ASSERT_EQ(emb_rb_uring_set_fill(&u, fds[0], -1), EMB_RB_ERR_OK);
+   ASSERT_GE(emb_rb_uring_submit(&u), 0);
+   if (u.mode != EMB_RB_URING_MODE_FALLBACK)
+   {
+      ASSERT_GT(u.inflight, 0);
+      ASSERT_EQ(emb_rb_uring_reap(&u, 0), 0);
+   }
+   emb_rb_uring_destroy(&u);
+   ASSERT_EQ(emb_rb_used_space(&rb), 0);
+   close(fds[0]);
+   close(fds[1]);
+   emb_rb_destroy(&rb);
+}